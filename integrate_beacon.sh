@@ -11,10 +11,43 @@ EXAMPLE_DIR="Seeed-Tracker-T1000-E-for-LoRaWAN-dev-board/apps/examples/11_lorawa
 echo "📁 Copying beacon files..."
 cp tracker_with_beacon/app_ble_beacon.c "$TRACKER_SRC/"
 cp tracker_with_beacon/app_ble_beacon.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_radio_coex.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_radio_coex.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_beacon_telemetry.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_beacon_telemetry.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_scan_plan.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_scan_plan.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_scan_topk.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_scan_topk.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_ble_scan_filter.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_ble_scan_filter.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_gnss_fix.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_gnss_fix.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_fix_log.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_fix_log.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_track_codec.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_track_codec.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_uplink_queue.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_uplink_queue.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_uplink_schema.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_uplink_schema.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_motion_policy.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_motion_policy.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_wifi_place.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_wifi_place.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_link_policy.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_link_policy.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_config_batch.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_config_batch.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_report_slot.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_report_slot.h "$TRACKER_INC/"
+cp tracker_with_beacon/app_fds_store.c "$TRACKER_SRC/"
+cp tracker_with_beacon/app_fds_store.h "$TRACKER_INC/"
 
 # Replace main file
 echo "🔄 Updating main tracker file..."
 cp tracker_with_beacon/main_lorawan_tracker.c "$EXAMPLE_DIR/"
+cp tracker_with_beacon/main_lorawan_tracker.h "$EXAMPLE_DIR/"
 
 # Copy documentation
 cp tracker_with_beacon/README_BEACON_INTEGRATION.md "$EXAMPLE_DIR/"
@@ -24,7 +57,7 @@ echo ""
 echo "📋 Next steps:"
 echo "1. Install Segger Embedded Studio (free): https://www.segger.com/downloads/embedded-studio/"
 echo "2. Open: $EXAMPLE_DIR/../../../pca10056/s140/11_ses_lorawan_tracker/t1000_e_dev_kit_pca10056.emProject"
-echo "3. Add app_ble_beacon.c and app_ble_beacon.h to the project"
+echo "3. Add app_ble_beacon.c/.h, app_radio_coex.c/.h, app_beacon_telemetry.c/.h, app_scan_plan.c/.h, app_scan_topk.c/.h, app_ble_scan_filter.c/.h, app_gnss_fix.c/.h, app_fix_log.c/.h, app_track_codec.c/.h, app_uplink_queue.c/.h, app_uplink_schema.c/.h, app_motion_policy.c/.h, app_wifi_place.c/.h, app_link_policy.c/.h, app_config_batch.c/.h, app_report_slot.c/.h and app_fds_store.c/.h to the project"
 echo "4. Build with F7, Flash with F5"
 echo ""
 echo "🎯 Your T1000-E now has iBeacon functionality!" 
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2023 Seeed Studio
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <kernel.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include "history.h"
+
+static struct history_record records[HISTORY_MAX_RECORDS];
+static uint32_t head;   /* next slot to write */
+static uint32_t count;
+static uint32_t next_seq;       /* sequence number of the next record */
+
+/* Records are appended from the system workqueue and read by the transfer thread */
+static K_MUTEX_DEFINE(history_lock);
+
+void history_add(const uint8_t *tlm, uint8_t len)
+{
+	struct history_record *rec;
+
+	if (len > APP_BEACON_TLM_MAX_LEN) {
+		return;
+	}
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+
+	rec = &records[head];
+	rec->timestamp = k_uptime_get() / MSEC_PER_SEC;
+	rec->len = len;
+	memcpy(rec->tlm, tlm, len);
+
+	head = (head + 1) % HISTORY_MAX_RECORDS;
+	if (count < HISTORY_MAX_RECORDS) {
+		count++;
+	}
+	next_seq++;
+
+	k_mutex_unlock(&history_lock);
+}
+
+uint32_t history_count(void)
+{
+	uint32_t n;
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+	n = count;
+	k_mutex_unlock(&history_lock);
+
+	return n;
+}
+
+void history_range(uint32_t *first, uint32_t *end)
+{
+	k_mutex_lock(&history_lock, K_FOREVER);
+	*first = next_seq - count;
+	*end = next_seq;
+	k_mutex_unlock(&history_lock);
+}
+
+bool history_get(uint32_t seq, struct history_record *rec)
+{
+	bool found = false;
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+
+	/* The record of seq sits back from head by its distance to next_seq */
+	if (next_seq - seq - 1 < count) {
+		*rec = records[(head + HISTORY_MAX_RECORDS - (next_seq - seq)) % HISTORY_MAX_RECORDS];
+		found = true;
+	}
+
+	k_mutex_unlock(&history_lock);
+
+	return found;
+}
+
+uint8_t history_record_pack(const struct history_record *rec, uint8_t *buf)
+{
+	sys_put_le32(rec->timestamp, buf);
+	buf[4] = rec->len;
+	memcpy(&buf[5], rec->tlm, rec->len);
+
+	return HISTORY_RECORD_WIRE_LEN(rec);
+}
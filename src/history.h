@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Seeed Studio
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_beacon_telemetry.h"
+
+/* Number of records kept in RAM, the oldest record is overwritten when full */
+#define HISTORY_MAX_RECORDS 512
+
+/* One history entry: uptime and the packed telemetry of app_beacon_telemetry.h */
+struct history_record {
+	uint32_t timestamp;                     /* seconds since boot */
+	uint8_t len;                            /* telemetry length */
+	uint8_t tlm[APP_BEACON_TLM_MAX_LEN];    /* packed telemetry */
+};
+
+/* Size of a record on the wire: timestamp (LE), length, telemetry */
+#define HISTORY_RECORD_WIRE_LEN(rec) (5 + (rec)->len)
+
+/**
+ * @brief Append a record stamped with the current uptime
+ *
+ * @param tlm Packed telemetry
+ * @param len Telemetry length, at most APP_BEACON_TLM_MAX_LEN
+ */
+void history_add(const uint8_t *tlm, uint8_t len);
+
+/**
+ * @brief Get the number of stored records
+ */
+uint32_t history_count(void);
+
+/**
+ * @brief Get the sequence numbers of the stored records
+ *
+ * Every record gets the next sequence number when it is added, so a reader
+ * going through a snapshot of the range is not shifted by records added meanwhile.
+ *
+ * @param first Sequence number of the oldest record
+ * @param end Sequence number the next record will get
+ */
+void history_range(uint32_t *first, uint32_t *end);
+
+/**
+ * @brief Copy a record
+ *
+ * @param seq Sequence number of the record
+ * @param rec Output record
+ *
+ * @return true if the record is still stored
+ */
+bool history_get(uint32_t seq, struct history_record *rec);
+
+/**
+ * @brief Serialise a record for transfer
+ *
+ * @param rec Record to serialise
+ * @param buf Output buffer, at least HISTORY_RECORD_WIRE_LEN(rec) bytes
+ *
+ * @return Number of bytes written
+ */
+uint8_t history_record_pack(const struct history_record *rec, uint8_t *buf);
+
+#endif /* HISTORY_H_ */
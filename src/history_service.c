@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2023 Seeed Studio
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <kernel.h>
+#include <string.h>
+#include <sys/printk.h>
+#include <sys/byteorder.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/uuid.h>
+
+#include "history.h"
+#include "history_service.h"
+
+/* Notifications queued in the stack at once */
+#define HISTORY_TX_CREDITS 8
+
+/* Give up on a download if the link stops draining notifications */
+#define HISTORY_TX_TIMEOUT_MS 2000
+
+#define HISTORY_CTRL_ABORT 0x00
+#define HISTORY_CTRL_START 0x01
+
+enum history_state {
+	HISTORY_STATE_IDLE = 0,
+	HISTORY_STATE_RUNNING = 1,
+	HISTORY_STATE_DONE = 2,
+	HISTORY_STATE_ABORTED = 3,
+};
+
+#define BT_UUID_HISTORY_SVC_VAL \
+	BT_UUID_128_ENCODE(0x7a1e0001, 0x5c2d, 0x4b8e, 0x9f1a, 0x3c6d2e8b1000)
+#define BT_UUID_HISTORY_CTRL_VAL \
+	BT_UUID_128_ENCODE(0x7a1e0002, 0x5c2d, 0x4b8e, 0x9f1a, 0x3c6d2e8b1000)
+#define BT_UUID_HISTORY_DATA_VAL \
+	BT_UUID_128_ENCODE(0x7a1e0003, 0x5c2d, 0x4b8e, 0x9f1a, 0x3c6d2e8b1000)
+#define BT_UUID_HISTORY_STATUS_VAL \
+	BT_UUID_128_ENCODE(0x7a1e0004, 0x5c2d, 0x4b8e, 0x9f1a, 0x3c6d2e8b1000)
+
+static struct bt_uuid_128 history_svc_uuid = BT_UUID_INIT_128(BT_UUID_HISTORY_SVC_VAL);
+static struct bt_uuid_128 history_ctrl_uuid = BT_UUID_INIT_128(BT_UUID_HISTORY_CTRL_VAL);
+static struct bt_uuid_128 history_data_uuid = BT_UUID_INIT_128(BT_UUID_HISTORY_DATA_VAL);
+static struct bt_uuid_128 history_status_uuid = BT_UUID_INIT_128(BT_UUID_HISTORY_STATUS_VAL);
+
+/* Status characteristic value, little endian on the wire */
+struct history_status {
+	uint8_t state;
+	uint16_t mtu;
+	uint32_t records;
+	uint32_t bytes;
+	uint32_t duration_ms;
+	uint32_t throughput_bps;
+} __packed;
+
+static struct history_status status;
+
+static struct bt_conn *current_conn;
+static bool data_notify_enabled;
+static atomic_t transfer_abort;
+
+static K_SEM_DEFINE(transfer_start, 0, 1);
+static K_SEM_DEFINE(tx_credits, HISTORY_TX_CREDITS, HISTORY_TX_CREDITS);
+
+static void link_setup_work_handler(struct k_work *work);
+static K_WORK_DEFINE(link_setup_work, link_setup_work_handler);
+
+static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	uint8_t cmd;
+
+	if (offset != 0 || len != 1) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+	cmd = *(const uint8_t *)buf;
+
+	if (cmd == HISTORY_CTRL_START) {
+		if (!data_notify_enabled) {
+			return BT_GATT_ERR(BT_ATT_ERR_CCC_IMPROPER_CONF);
+		}
+		atomic_clear(&transfer_abort);
+		k_sem_give(&transfer_start);
+	} else if (cmd == HISTORY_CTRL_ABORT) {
+		atomic_set(&transfer_abort, 1);
+	} else {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	return len;
+}
+
+static void data_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	data_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+static void status_to_le(struct history_status *le)
+{
+	le->state = status.state;
+	le->mtu = sys_cpu_to_le16(status.mtu);
+	le->records = sys_cpu_to_le32(status.records);
+	le->bytes = sys_cpu_to_le32(status.bytes);
+	le->duration_ms = sys_cpu_to_le32(status.duration_ms);
+	le->throughput_bps = sys_cpu_to_le32(status.throughput_bps);
+}
+
+static ssize_t status_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			   void *buf, uint16_t len, uint16_t offset)
+{
+	struct history_status le;
+
+	status_to_le(&le);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &le, sizeof(le));
+}
+
+BT_GATT_SERVICE_DEFINE(history_svc,
+	BT_GATT_PRIMARY_SERVICE(&history_svc_uuid),
+	BT_GATT_CHARACTERISTIC(&history_ctrl_uuid.uuid, BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_WRITE, NULL, ctrl_write, NULL),
+	BT_GATT_CHARACTERISTIC(&history_data_uuid.uuid, BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(data_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(&history_status_uuid.uuid, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_READ, status_read, NULL, NULL),
+	BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+#define HISTORY_DATA_ATTR (&history_svc.attrs[4])
+#define HISTORY_STATUS_ATTR (&history_svc.attrs[7])
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	printk("History: ATT MTU %u (err %u)\n", bt_gatt_get_mtu(conn), err);
+}
+
+static struct bt_gatt_exchange_params mtu_params = {
+	.func = mtu_exchanged,
+};
+
+/* HCI procedures are synchronous, so they run from the system workqueue */
+static void link_setup_work_handler(struct k_work *work)
+{
+	struct bt_conn *conn = current_conn;
+	int err;
+
+	if (!conn) {
+		return;
+	}
+
+	err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+	if (err) {
+		printk("History: data length update failed (err %d)\n", err);
+	}
+
+	err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+	if (err) {
+		printk("History: PHY update failed (err %d)\n", err);
+	}
+
+	/* 7.5-15 ms interval, no latency, 4 s supervision timeout */
+	err = bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(6, 12, 0, 400));
+	if (err) {
+		printk("History: connection parameter update failed (err %d)\n", err);
+	}
+
+	err = bt_gatt_exchange_mtu(conn, &mtu_params);
+	if (err) {
+		printk("History: MTU exchange failed (err %d)\n", err);
+	}
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err || current_conn) {
+		return;
+	}
+
+	current_conn = bt_conn_ref(conn);
+	data_notify_enabled = false;
+	k_work_submit(&link_setup_work);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn != current_conn) {
+		return;
+	}
+
+	atomic_set(&transfer_abort, 1);
+	bt_conn_unref(current_conn);
+	current_conn = NULL;
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+static void notify_sent(struct bt_conn *conn, void *user_data)
+{
+	k_sem_give(&tx_credits);
+}
+
+static int notify_chunk(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = HISTORY_DATA_ATTR,
+		.data = data,
+		.len = len,
+		.func = notify_sent,
+	};
+	int err;
+
+	if (k_sem_take(&tx_credits, K_MSEC(HISTORY_TX_TIMEOUT_MS))) {
+		return -ETIMEDOUT;
+	}
+
+	err = bt_gatt_notify_cb(conn, &params);
+	if (err) {
+		k_sem_give(&tx_credits);
+	}
+	return err;
+}
+
+static void transfer_run(struct bt_conn *conn)
+{
+	uint8_t chunk[CONFIG_BT_L2CAP_TX_MTU];
+	struct history_status le;
+	struct history_record rec;
+	uint32_t first, end;
+	uint16_t mtu = bt_gatt_get_mtu(conn);
+	uint16_t max_len = MIN(mtu - 3, sizeof(chunk));
+	uint16_t len = 0;
+	uint32_t chunk_records = 0;	/* records packed in chunk, counted once it is queued */
+	int64_t start = k_uptime_get();
+	int err = 0;
+
+	memset(&status, 0, sizeof(status));
+	status.state = HISTORY_STATE_RUNNING;
+	status.mtu = mtu;
+
+	/* The records stored at the start, by sequence number, records added meanwhile do not shift them */
+	history_range(&first, &end);
+
+	for (uint32_t seq = first; seq != end; seq++) {
+		if (atomic_get(&transfer_abort)) {
+			err = -ECANCELED;
+			break;
+		}
+		if (!history_get(seq, &rec)) {
+			/* Overwritten by the ring since the start of the transfer */
+			continue;
+		}
+
+		if (len + HISTORY_RECORD_WIRE_LEN(&rec) > max_len) {
+			err = notify_chunk(conn, chunk, len);
+			if (err) {
+				break;
+			}
+			status.bytes += len;
+			status.records += chunk_records;
+			len = 0;
+			chunk_records = 0;
+		}
+
+		len += history_record_pack(&rec, &chunk[len]);
+		chunk_records++;
+	}
+
+	if (!err && len) {
+		err = notify_chunk(conn, chunk, len);
+		if (!err) {
+			status.bytes += len;
+			status.records += chunk_records;
+		}
+	}
+
+	/*
+	 * Wait for the last notifications to leave so the duration covers the
+	 * air time. Credits still in flight after a timeout are returned by
+	 * notify_sent(), the semaphore limit keeps the count right.
+	 */
+	for (int i = 0; i < HISTORY_TX_CREDITS; i++) {
+		k_sem_take(&tx_credits, K_MSEC(HISTORY_TX_TIMEOUT_MS));
+	}
+	for (int i = 0; i < HISTORY_TX_CREDITS; i++) {
+		k_sem_give(&tx_credits);
+	}
+
+	status.duration_ms = k_uptime_get() - start;
+	status.throughput_bps = status.duration_ms ?
+		(uint32_t)((uint64_t)status.bytes * 8 * MSEC_PER_SEC / status.duration_ms) : 0;
+	status.state = err ? HISTORY_STATE_ABORTED : HISTORY_STATE_DONE;
+
+	printk("History: %u records, %u bytes in %u ms (%u bit/s, MTU %u)%s\n",
+	       status.records, status.bytes, status.duration_ms,
+	       status.throughput_bps, mtu, err ? ", aborted" : "");
+
+	status_to_le(&le);
+	bt_gatt_notify(conn, HISTORY_STATUS_ATTR, &le, sizeof(le));
+}
+
+static void transfer_thread(void)
+{
+	struct bt_conn *conn;
+
+	while (1) {
+		k_sem_take(&transfer_start, K_FOREVER);
+
+		conn = current_conn ? bt_conn_ref(current_conn) : NULL;
+		if (!conn) {
+			continue;
+		}
+
+		transfer_run(conn);
+		bt_conn_unref(conn);
+	}
+}
+
+K_THREAD_DEFINE(history_tx_thread, 1024, transfer_thread, NULL, NULL, NULL, 7, 0, 0);
+
+void history_service_init(void)
+{
+	bt_conn_cb_register(&conn_callbacks);
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2023 Seeed Studio
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HISTORY_SERVICE_H_
+#define HISTORY_SERVICE_H_
+
+/*
+ * Bulk history download over GATT.
+ *
+ * Service 7a1e0001-5c2d-4b8e-9f1a-3c6d2e8b1000
+ *   Control 7a1e0002 (write): 0x01 starts a download, 0x00 aborts it
+ *   Data    7a1e0003 (notify): history records (see history.h) packed back
+ *                              to back, as many as fit in ATT MTU - 3
+ *   Status  7a1e0004 (read, notify): state, ATT MTU, records, bytes,
+ *                              duration in ms and throughput in bit/s,
+ *                              notified when a download ends
+ *
+ * On connection the link is moved to Data Length Extension, 2M PHY, the
+ * largest ATT MTU and a 7.5-15 ms connection interval.
+ */
+
+/**
+ * @brief Register the connection callbacks of the history service
+ */
+void history_service_init(void);
+
+#endif /* HISTORY_SERVICE_H_ */
@@ -7,17 +7,45 @@
 #include <kernel.h>
 #include <sys/printk.h>
 #include <stdio.h>
+#include <string.h>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
 #include <drivers/gpio.h>
+#include <drivers/sensor.h>
+
+#include "app_beacon_telemetry.h"
+#include "history.h"
+#include "history_service.h"
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
 
+/* Minimum time between two advertising data updates pushed to the controller */
+#define ADV_UPDATE_MIN_INTERVAL_MS 2000
+
 /* Timer for periodic sensor reading */
 static void sensor_read_timer_handler(struct k_timer *dummy);
 K_TIMER_DEFINE(sensor_read_timer, sensor_read_timer_handler, NULL);
 
+/* Sensors are read from the system workqueue, not from the timer ISR */
+static void sensor_read_work_handler(struct k_work *work);
+static K_WORK_DEFINE(sensor_read_work, sensor_read_work_handler);
+
+/* Coalesced, rate-limited scan response update */
+static void adv_update_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(adv_update_work, adv_update_work_handler);
+static int64_t adv_last_update;
+
+/*
+ * Latest sensor snapshot, same units as the nRF5 SDK beacon. Only the
+ * accelerometer has a driver here, so battery, temperature and light are
+ * left out of the payload bitmap rather than advertised as zero.
+ */
+struct beacon_sensor_data {
+	int16_t ax, ay, az; /* mg */
+	bool emergency;
+};
+
 /*
  * Set up iBeacon advertisement data.
  *
@@ -39,12 +67,75 @@ static const struct bt_data ad[] = {
 		      0xc5)      /* Measured Power */
 };
 
+/*
+ * Sensor manufacturer data, identical to the nRF5 SDK beacon scan response:
+ * company ID 0xFFEE followed by the packed telemetry of app_beacon_telemetry.h.
+ */
+static uint8_t mfg_data[2 + APP_BEACON_TLM_MAX_LEN] = { 0xee, 0xff };
+
+/* Payload waiting to be pushed by adv_update_work */
+static uint8_t mfg_pending[APP_BEACON_TLM_MAX_LEN];
+static uint8_t mfg_pending_len;
+
 /* Set up scan response data */
 static uint8_t dev_name[sizeof("t1000-XXXXXX")] = "t1000-";
 static struct bt_data sd[] = {
     BT_DATA(BT_DATA_NAME_COMPLETE, dev_name, sizeof(dev_name) -1),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, mfg_data, 2),
 };
 
+static uint8_t sensor_payload_encode(const struct beacon_sensor_data *data, uint8_t *buf)
+{
+	app_beacon_tlm_t tlm = {
+		.fields = APP_BEACON_TLM_FIELD_ACCEL,
+		.flags = data->emergency ? APP_BEACON_TLM_FLAG_EMERGENCY : 0,
+		.ax = data->ax, .ay = data->ay, .az = data->az,
+	};
+
+	return app_beacon_tlm_encode(&tlm, buf, APP_BEACON_TLM_MAX_LEN);
+}
+
+/*
+ * Publish a new sensor snapshot. Unchanged payloads are dropped and changes
+ * arriving within ADV_UPDATE_MIN_INTERVAL_MS of the last update are merged
+ * into a single bt_le_adv_update_data() call carrying the newest values.
+ *
+ * Must be called from the system workqueue, like adv_update_work.
+ */
+static void beacon_sensor_data_set(const struct beacon_sensor_data *data)
+{
+	uint8_t payload[APP_BEACON_TLM_MAX_LEN];
+	uint8_t len;
+	int64_t wait;
+
+	len = sensor_payload_encode(data, payload);
+	history_add(payload, len);
+
+	if (len == mfg_pending_len && memcmp(payload, mfg_pending, len) == 0) {
+		return;
+	}
+	memcpy(mfg_pending, payload, len);
+	mfg_pending_len = len;
+
+	/* Does nothing if an update is already scheduled, it will pick up mfg_pending */
+	wait = adv_last_update + ADV_UPDATE_MIN_INTERVAL_MS - k_uptime_get();
+	k_work_schedule(&adv_update_work, wait > 0 ? K_MSEC(wait) : K_NO_WAIT);
+}
+
+static void adv_update_work_handler(struct k_work *work)
+{
+	int err;
+
+	memcpy(&mfg_data[2], mfg_pending, mfg_pending_len);
+	sd[1].data_len = 2 + mfg_pending_len;
+	adv_last_update = k_uptime_get();
+
+	err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	if (err) {
+		printk("Advertising data update failed (err %d)\n", err);
+	}
+}
+
 static void bt_ready(void)
 {
 	char addr_s[BT_ADDR_LE_STR_LEN];
@@ -58,8 +149,12 @@ static void bt_ready(void)
 	/* Format the device name to t1000-[last 6 of mac] */
 	snprintf(dev_name + 6, 7, "%02X%02X%02X", addr.a.val[2], addr.a.val[1], addr.a.val[0]);
 
-	/* Use the correct advertising parameter for Zephyr 2.7.1 */
-	err = bt_le_adv_start(BT_LE_ADV_CONN_NAME, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	/*
+	 * Use the correct advertising parameter for Zephyr 2.7.1. The name is
+	 * already in sd[], so BT_LE_ADV_OPT_USE_NAME must not be set or the
+	 * stack rejects the duplicate name.
+	 */
+	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
 		printk("Advertising failed to start (err %d)\n", err);
 		return;
@@ -69,11 +164,39 @@ static void bt_ready(void)
 	printk("Beacon started, advertising as %s with address %s\n", dev_name, addr_s);
 }
 
+static int16_t accel_to_mg(const struct sensor_value *val)
+{
+	int64_t micro_ms2 = (int64_t)val->val1 * 1000000 + val->val2;
+
+	return (int16_t)(micro_ms2 * 1000 / SENSOR_G);
+}
+
+static void sensor_read_work_handler(struct k_work *work)
+{
+	struct beacon_sensor_data data = { 0 };
+
+#if DT_NODE_HAS_STATUS(DT_ALIAS(accel0), okay)
+	const struct device *accel = DEVICE_DT_GET(DT_ALIAS(accel0));
+	struct sensor_value accel_xyz[3];
+
+	if (device_is_ready(accel) && sensor_sample_fetch(accel) == 0 &&
+	    sensor_channel_get(accel, SENSOR_CHAN_ACCEL_XYZ, accel_xyz) == 0) {
+		data.ax = accel_to_mg(&accel_xyz[0]);
+		data.ay = accel_to_mg(&accel_xyz[1]);
+		data.az = accel_to_mg(&accel_xyz[2]);
+	}
+#endif
+
+	printk("\n--- Sensor Readings ---\n");
+	printk("Accel: %d, %d, %d mg\n", data.ax, data.ay, data.az);
+	printk("-----------------------\n");
+
+	beacon_sensor_data_set(&data);
+}
+
 static void sensor_read_timer_handler(struct k_timer *dummy)
 {
-    printk("\n--- Sensor Readings ---\n");
-    printk("TODO: Add ADC and accelerometer readings\n");
-    printk("-----------------------\n");
+	k_work_submit(&sensor_read_work);
 }
 
 void main(void)
@@ -88,6 +211,7 @@ void main(void)
 		printk("Bluetooth init failed (err %d)\n", err);
 		return;
 	}
+	history_service_init();
 	bt_ready();
     printk("Bluetooth initialized\n");
 
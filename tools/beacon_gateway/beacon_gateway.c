@@ -0,0 +1,307 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "beacon_gateway.h"
+
+#define AD_TYPE_MANUFACTURER_DATA   0xFF
+
+#define APPLE_COMPANY_ID            0x004C
+#define IBEACON_TYPE                0x02
+#define IBEACON_LEN                 0x15
+
+// Measured power assumed until an iBeacon frame tells the real one
+#define DEFAULT_MEASURED_POWER      (-59)
+
+// Marks an occupied slot so that key 0 can mean empty
+#define KEY_USED                    (1ULL << 48)
+
+/*
+ * Open addressing table with linear probing. Keys are kept apart from the
+ * tag state so a probe only walks a dense array of 64-bit keys, and the
+ * state of a tag is touched once its slot is found.
+ */
+struct beacon_gw {
+    beacon_gw_config_t config;
+    uint32_t mask;
+    uint8_t hash_shift;
+    uint64_t *keys;
+    beacon_gw_tag_t *tags;
+    beacon_gw_stats_t stats;
+};
+
+static uint64_t addr_key(const uint8_t addr[6])
+{
+    uint64_t key = KEY_USED;
+
+    for (int i = 0; i < 6; i++) {
+        key |= (uint64_t)addr[i] << (8 * i);
+    }
+    return key;
+}
+
+static uint32_t key_slot(const beacon_gw_t *gw, uint64_t key)
+{
+    // Fibonacci hashing, the top bits are well mixed
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> gw->hash_shift);
+}
+
+static int32_t lookup(const beacon_gw_t *gw, uint64_t key)
+{
+    uint32_t slot = key_slot(gw, key);
+
+    while (gw->keys[slot]) {
+        if (gw->keys[slot] == key) {
+            return slot;
+        }
+        slot = (slot + 1) & gw->mask;
+    }
+    return -1;
+}
+
+static beacon_gw_tag_t *lookup_or_insert(beacon_gw_t *gw, const uint8_t addr[6], int8_t rssi)
+{
+    uint64_t key = addr_key(addr);
+    uint32_t slot = key_slot(gw, key);
+
+    while (gw->keys[slot]) {
+        if (gw->keys[slot] == key) {
+            return &gw->tags[slot];
+        }
+        slot = (slot + 1) & gw->mask;
+    }
+
+    // Keep the load factor at or below 3/4 so probes stay short
+    if ((gw->stats.tags + 1) * 4 > (gw->mask + 1) * 3) {
+        gw->stats.table_full++;
+        return NULL;
+    }
+
+    beacon_gw_tag_t *tag = &gw->tags[slot];
+    memset(tag, 0, sizeof(*tag));
+    memcpy(tag->addr, addr, 6);
+    tag->measured_power = DEFAULT_MEASURED_POWER;
+    tag->rssi_q8 = (int32_t)rssi * 256;
+    gw->keys[slot] = key;
+    gw->stats.tags++;
+    return tag;
+}
+
+static void remove_slot(beacon_gw_t *gw, uint32_t slot)
+{
+    // Backward shift deletion keeps every probe chain unbroken without tombstones
+    uint32_t hole = slot;
+    uint32_t next = (slot + 1) & gw->mask;
+
+    while (gw->keys[next]) {
+        uint32_t home = key_slot(gw, gw->keys[next]);
+        if (((next - home) & gw->mask) >= ((next - hole) & gw->mask)) {
+            gw->keys[hole] = gw->keys[next];
+            gw->tags[hole] = gw->tags[next];
+            hole = next;
+        }
+        next = (next + 1) & gw->mask;
+    }
+    gw->keys[hole] = 0;
+    gw->stats.tags--;
+}
+
+static void set_emergency(beacon_gw_t *gw, beacon_gw_tag_t *tag, bool emergency)
+{
+    if (tag->emergency == emergency) {
+        return;
+    }
+    tag->emergency = emergency;
+    if (gw->config.on_emergency) {
+        gw->config.on_emergency(tag, gw->config.context);
+    }
+}
+
+void beacon_gw_config_default(beacon_gw_config_t *config)
+{
+    static const uint8_t fleet_uuid[16] = {
+        0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2,
+        0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0
+    };
+
+    memset(config, 0, sizeof(*config));
+    config->capacity = 1024;
+    memcpy(config->uuid, fleet_uuid, sizeof(fleet_uuid));
+    config->rssi_shift = 2;
+    config->path_loss_exponent = 2.0f;
+}
+
+beacon_gw_t *beacon_gw_create(const beacon_gw_config_t *config)
+{
+    beacon_gw_t *gw = calloc(1, sizeof(*gw));
+    uint32_t size = 16;
+    uint8_t bits = 4;
+
+    if (!gw) {
+        return NULL;
+    }
+
+    // Room for capacity tags at a 3/4 load factor
+    while (size * 3 < config->capacity * 4) {
+        size <<= 1;
+        bits++;
+    }
+
+    gw->config = *config;
+    gw->mask = size - 1;
+    gw->hash_shift = 64 - bits;
+    gw->keys = calloc(size, sizeof(*gw->keys));
+    gw->tags = calloc(size, sizeof(*gw->tags));
+    if (!gw->keys || !gw->tags) {
+        beacon_gw_destroy(gw);
+        return NULL;
+    }
+    return gw;
+}
+
+void beacon_gw_destroy(beacon_gw_t *gw)
+{
+    if (gw) {
+        free(gw->keys);
+        free(gw->tags);
+        free(gw);
+    }
+}
+
+const beacon_gw_tag_t *beacon_gw_process(beacon_gw_t *gw, const uint8_t addr[6], int8_t rssi,
+                                         uint64_t timestamp_us, const uint8_t *data, uint8_t len)
+{
+    const uint8_t *ibeacon = NULL;
+    const uint8_t *tlm = NULL;
+    uint8_t tlm_len = 0;
+    uint8_t pos = 0;
+
+    gw->stats.frames++;
+
+    // Find the fleet fields first, so foreign advertisers never reach the table
+    while (pos < len) {
+        uint8_t field_len = data[pos];
+        if (field_len == 0) {
+            break;
+        }
+        if (pos + 1 + field_len > len) {
+            gw->stats.decode_errors++;
+            return NULL;
+        }
+
+        const uint8_t *field = &data[pos + 1];
+        if (field[0] == AD_TYPE_MANUFACTURER_DATA && field_len >= 3) {
+            uint16_t company = field[1] | (field[2] << 8);
+            if (company == APPLE_COMPANY_ID && field_len == 26 &&
+                field[3] == IBEACON_TYPE && field[4] == IBEACON_LEN &&
+                memcmp(&field[5], gw->config.uuid, 16) == 0) {
+                ibeacon = &field[5];
+            } else if (company == BEACON_GW_COMPANY_ID) {
+                tlm = &field[3];
+                tlm_len = field_len - 3;
+            }
+        }
+        pos += 1 + field_len;
+    }
+
+    if (!ibeacon && !tlm) {
+        return NULL;
+    }
+
+    beacon_gw_tag_t *tag = lookup_or_insert(gw, addr, rssi);
+    if (!tag) {
+        return NULL;
+    }
+
+    gw->stats.accepted++;
+    tag->frames++;
+    tag->last_seen_us = timestamp_us;
+    tag->rssi_q8 += (((int32_t)rssi * 256) - tag->rssi_q8) >> gw->config.rssi_shift;
+
+    if (ibeacon) {
+        tag->has_ibeacon = true;
+        tag->major = (ibeacon[16] << 8) | ibeacon[17];
+        tag->minor = (ibeacon[18] << 8) | ibeacon[19];
+        tag->measured_power = (int8_t)ibeacon[20];
+        set_emergency(gw, tag, tag->major == BEACON_GW_EMERGENCY_MAJOR);
+    }
+
+    if (tlm) {
+        app_beacon_tlm_t decoded;
+        if (app_beacon_tlm_decode(tlm, tlm_len, &decoded)) {
+            tag->tlm = decoded;
+            tag->has_tlm = true;
+            // The tag updates both packets together, either one alone reports the state
+            set_emergency(gw, tag, (tag->tlm.flags & APP_BEACON_TLM_FLAG_EMERGENCY) != 0);
+        } else {
+            gw->stats.decode_errors++;
+        }
+    }
+
+    return tag;
+}
+
+const beacon_gw_tag_t *beacon_gw_find(const beacon_gw_t *gw, const uint8_t addr[6])
+{
+    int32_t slot = lookup(gw, addr_key(addr));
+
+    return slot < 0 ? NULL : &gw->tags[slot];
+}
+
+uint32_t beacon_gw_expire(beacon_gw_t *gw, uint64_t now_us, uint64_t max_age_us)
+{
+    uint32_t removed = 0;
+    uint32_t slot = 0;
+
+    while (slot <= gw->mask) {
+        // A replayed report may be newer than now_us, it has not aged yet
+        if (gw->keys[slot] && now_us > gw->tags[slot].last_seen_us
+            && now_us - gw->tags[slot].last_seen_us > max_age_us) {
+            // Another entry may shift into this slot, check it again
+            remove_slot(gw, slot);
+            removed++;
+        } else {
+            slot++;
+        }
+    }
+    return removed;
+}
+
+void beacon_gw_foreach(const beacon_gw_t *gw, void (*fn)(const beacon_gw_tag_t *tag, void *context),
+                       void *context)
+{
+    for (uint32_t slot = 0; slot <= gw->mask; slot++) {
+        if (gw->keys[slot]) {
+            fn(&gw->tags[slot], context);
+        }
+    }
+}
+
+float beacon_gw_distance_m(const beacon_gw_t *gw, const beacon_gw_tag_t *tag)
+{
+    if (tag->frames == 0) {
+        return -1.0f;
+    }
+
+    float rssi = tag->rssi_q8 / 256.0f;
+    return powf(10.0f, (tag->measured_power - rssi) / (10.0f * gw->config.path_loss_exponent));
+}
+
+beacon_gw_proximity_t beacon_gw_proximity(const beacon_gw_t *gw, const beacon_gw_tag_t *tag)
+{
+    float distance = beacon_gw_distance_m(gw, tag);
+
+    if (distance < 0) {
+        return BEACON_GW_PROXIMITY_UNKNOWN;
+    } else if (distance < 0.5f) {
+        return BEACON_GW_PROXIMITY_IMMEDIATE;
+    } else if (distance < 3.0f) {
+        return BEACON_GW_PROXIMITY_NEAR;
+    }
+    return BEACON_GW_PROXIMITY_FAR;
+}
+
+void beacon_gw_get_stats(const beacon_gw_t *gw, beacon_gw_stats_t *stats)
+{
+    *stats = gw->stats;
+}
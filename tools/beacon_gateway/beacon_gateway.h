@@ -0,0 +1,150 @@
+#ifndef __BEACON_GATEWAY_H__
+#define __BEACON_GATEWAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "app_beacon_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// iBeacon major broadcast by a tag in emergency mode
+#define BEACON_GW_EMERGENCY_MAJOR   0xFF00
+
+// Custom company ID of the telemetry scan response
+#define BEACON_GW_COMPANY_ID        0xFFEE
+
+/**
+ * @brief Proximity class derived from the filtered RSSI
+ */
+typedef enum {
+    BEACON_GW_PROXIMITY_UNKNOWN = 0,
+    BEACON_GW_PROXIMITY_IMMEDIATE,      // below 0.5 m
+    BEACON_GW_PROXIMITY_NEAR,           // below 3 m
+    BEACON_GW_PROXIMITY_FAR,
+} beacon_gw_proximity_t;
+
+/**
+ * @brief State kept per tag
+ */
+typedef struct {
+    uint8_t addr[6];                // Advertiser address, LSB first
+    bool emergency;                 // iBeacon major 0xFF00 or telemetry emergency flag
+    bool has_ibeacon;               // At least one iBeacon frame received
+    bool has_tlm;                   // At least one telemetry frame received
+    int8_t measured_power;          // iBeacon RSSI at 1 m
+    uint16_t major, minor;
+    int32_t rssi_q8;                // Filtered RSSI in 1/256 dBm
+    uint32_t frames;                // Frames accepted for this tag
+    uint64_t last_seen_us;
+    app_beacon_tlm_t tlm;           // Last decoded telemetry
+} beacon_gw_tag_t;
+
+/**
+ * @brief Called when a tag enters or leaves emergency mode
+ */
+typedef void (*beacon_gw_emergency_cb_t)(const beacon_gw_tag_t *tag, void *context);
+
+/**
+ * @brief Ingestion engine configuration
+ */
+typedef struct {
+    uint32_t capacity;              // Maximum number of tags, rounded up to a power of two
+    uint8_t uuid[16];               // iBeacon proximity UUID of the fleet
+    uint8_t rssi_shift;             // Filter weight of a new sample is 1 / 2^rssi_shift
+    float path_loss_exponent;       // Log-distance model exponent, 2.0 in free space
+    beacon_gw_emergency_cb_t on_emergency;
+    void *context;
+} beacon_gw_config_t;
+
+/**
+ * @brief Ingestion statistics
+ */
+typedef struct {
+    uint64_t frames;                // Frames given to beacon_gw_process()
+    uint64_t accepted;              // Frames carrying fleet iBeacon or telemetry data
+    uint64_t decode_errors;         // Malformed AD structures or telemetry
+    uint64_t table_full;            // Frames dropped because the tag table was full
+    uint32_t tags;                  // Tags currently in the table
+} beacon_gw_stats_t;
+
+typedef struct beacon_gw beacon_gw_t;
+
+/**
+ * @brief Fill a configuration with the fleet defaults
+ *
+ * UUID E2C56DB5-DFFB-48D2-B060-D0F5A71096E0, 1024 tags, filter weight 1/4,
+ * path loss exponent 2.0, no emergency callback.
+ */
+void beacon_gw_config_default(beacon_gw_config_t *config);
+
+/**
+ * @brief Create an ingestion engine
+ *
+ * @return Engine, NULL if out of memory
+ */
+beacon_gw_t *beacon_gw_create(const beacon_gw_config_t *config);
+
+/**
+ * @brief Destroy an ingestion engine
+ */
+void beacon_gw_destroy(beacon_gw_t *gw);
+
+/**
+ * @brief Process one advertising or scan response report
+ *
+ * @param gw Engine
+ * @param addr Advertiser address, LSB first
+ * @param rssi Report RSSI in dBm
+ * @param timestamp_us Report time
+ * @param data AD structures of the report
+ * @param len Length of data
+ *
+ * @return Tag updated by the report, NULL if the report was not for the fleet
+ */
+const beacon_gw_tag_t *beacon_gw_process(beacon_gw_t *gw, const uint8_t addr[6], int8_t rssi,
+                                         uint64_t timestamp_us, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Look up a tag
+ *
+ * @return Tag, NULL if unknown
+ */
+const beacon_gw_tag_t *beacon_gw_find(const beacon_gw_t *gw, const uint8_t addr[6]);
+
+/**
+ * @brief Drop tags not seen since before now_us - max_age_us
+ *
+ * @return Number of tags removed
+ */
+uint32_t beacon_gw_expire(beacon_gw_t *gw, uint64_t now_us, uint64_t max_age_us);
+
+/**
+ * @brief Call fn for every tag in the table
+ */
+void beacon_gw_foreach(const beacon_gw_t *gw, void (*fn)(const beacon_gw_tag_t *tag, void *context),
+                       void *context);
+
+/**
+ * @brief Estimated distance to a tag in meters, negative if unknown
+ */
+float beacon_gw_distance_m(const beacon_gw_t *gw, const beacon_gw_tag_t *tag);
+
+/**
+ * @brief Proximity class of a tag
+ */
+beacon_gw_proximity_t beacon_gw_proximity(const beacon_gw_t *gw, const beacon_gw_tag_t *tag);
+
+/**
+ * @brief Get the ingestion statistics
+ */
+void beacon_gw_get_stats(const beacon_gw_t *gw, beacon_gw_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BEACON_GATEWAY_H__ */
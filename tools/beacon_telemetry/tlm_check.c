@@ -0,0 +1,300 @@
+/*
+ * Round trip check of the beacon telemetry format (app_beacon_telemetry.c).
+ *
+ * Every presence bitmap and every flag value is encoded and decoded with
+ * random field values, and each decoded field is compared with an independent
+ * model of its quantisation and clamping. The range edges of every field, the
+ * version check, truncated payloads and short output buffers are checked
+ * separately.
+ *
+ * Usage: tlm_check [value_sets]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_beacon_telemetry.h"
+
+#define FIELD_ALL       0x1F
+#define LAT_RANGE       90000000.0      // 1e-6 deg
+#define LON_RANGE       180000000.0     // 1e-6 deg
+#define POSITION_SCALE  2097152.0       // 2^21
+
+static int failures;
+static unsigned cases;
+
+static int32_t clamp(int64_t value, int32_t min, int32_t max)
+{
+    return value < min ? min : (value > max ? max : (int32_t)value);
+}
+
+// Payload bits of a bitmap, from the table in app_beacon_telemetry.h
+static unsigned model_bits(uint8_t fields)
+{
+    unsigned bits = 3 + 5 + 4;
+
+    if (fields & APP_BEACON_TLM_FIELD_BATTERY)  bits += 7;
+    if (fields & APP_BEACON_TLM_FIELD_TEMP)     bits += 8;
+    if (fields & APP_BEACON_TLM_FIELD_LIGHT)    bits += 8;
+    if (fields & APP_BEACON_TLM_FIELD_ACCEL)    bits += 24;
+    if (fields & APP_BEACON_TLM_FIELD_POSITION) bits += 44;
+    return bits;
+}
+
+// Nearest light level the format can carry, ties to the larger one
+static uint16_t model_light(uint16_t lux)
+{
+    uint32_t best = 0;
+
+    for (unsigned code = 0; code < 256; code++) {
+        uint32_t level = code < 16 ? code : (16UL + (code & 0x0F)) << ((code >> 4) - 1);
+        uint32_t d = level > lux ? level - lux : lux - level;
+        uint32_t d_best = best > lux ? best - lux : lux - best;
+
+        if (d < d_best || (d == d_best && level > best)) {
+            best = level;
+        }
+    }
+    return best > 0xFFFF ? 0xFFFF : (uint16_t)best;
+}
+
+static int32_t model_position(int32_t value, double range)
+{
+    int64_t step = llround((double)value * POSITION_SCALE / range);
+
+    step = clamp(step, -(int32_t)POSITION_SCALE, (int32_t)POSITION_SCALE - 1);
+    return (int32_t)llround((double)step * range / POSITION_SCALE);
+}
+
+// What the decoder must return for a telemetry set
+static void model(const app_beacon_tlm_t *in, app_beacon_tlm_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->fields = in->fields & FIELD_ALL;
+    out->flags = in->flags & 0x0F;
+
+    if (out->fields & APP_BEACON_TLM_FIELD_BATTERY) {
+        out->battery = in->battery > 100 ? 100 : in->battery;
+    }
+    if (out->fields & APP_BEACON_TLM_FIELD_TEMP) {
+        // 0.5 degC steps from -40 degC to 87.5 degC
+        int32_t step = clamp(llround((in->temp + 400) / 5.0), 0, 255);
+        out->temp = (int16_t)(step * 5 - 400);
+    }
+    if (out->fields & APP_BEACON_TLM_FIELD_LIGHT) {
+        out->light = model_light(in->light);
+    }
+    if (out->fields & APP_BEACON_TLM_FIELD_ACCEL) {
+        out->ax = (int16_t)(clamp(llround(in->ax / 64.0), -128, 127) * 64);
+        out->ay = (int16_t)(clamp(llround(in->ay / 64.0), -128, 127) * 64);
+        out->az = (int16_t)(clamp(llround(in->az / 64.0), -128, 127) * 64);
+    }
+    if (out->fields & APP_BEACON_TLM_FIELD_POSITION) {
+        out->lat = model_position(in->lat, LAT_RANGE);
+        out->lon = model_position(in->lon, LON_RANGE);
+    }
+}
+
+static bool tlm_equal(const app_beacon_tlm_t *a, const app_beacon_tlm_t *b)
+{
+    return a->fields == b->fields && a->flags == b->flags && a->battery == b->battery &&
+           a->temp == b->temp && a->light == b->light && a->ax == b->ax && a->ay == b->ay &&
+           a->az == b->az && a->lat == b->lat && a->lon == b->lon;
+}
+
+static void tlm_print(const char *label, const app_beacon_tlm_t *t)
+{
+    printf("  %s: fields %02x flags %x battery %u temp %d light %u accel %d %d %d position %d %d\n",
+           label, t->fields, t->flags, t->battery, t->temp, t->light, t->ax, t->ay, t->az,
+           t->lat, t->lon);
+}
+
+static void round_trip(const char *name, const app_beacon_tlm_t *in)
+{
+    app_beacon_tlm_t expected, decoded;
+    uint8_t buf[APP_BEACON_TLM_MAX_LEN + 1];
+    uint8_t len;
+
+    cases++;
+    model(in, &expected);
+
+    len = app_beacon_tlm_encode(in, buf, APP_BEACON_TLM_MAX_LEN);
+    if (len != (model_bits(expected.fields) + 7) / 8) {
+        printf("%s: encoded to %u bytes, %u expected\n", name, len, (model_bits(expected.fields) + 7) / 8);
+        failures++;
+        return;
+    }
+    if (app_beacon_tlm_encode(in, buf, len - 1) != 0) {
+        printf("%s: encoded into a buffer of %u bytes\n", name, len - 1);
+        failures++;
+    }
+
+    memset(buf, 0xA5, sizeof(buf));
+    app_beacon_tlm_encode(in, buf, len);
+    if (!app_beacon_tlm_decode(buf, len, &decoded) || !tlm_equal(&decoded, &expected)) {
+        printf("%s: round trip mismatch\n", name);
+        tlm_print("in", in);
+        tlm_print("expected", &expected);
+        tlm_print("decoded", &decoded);
+        failures++;
+        return;
+    }
+
+    // Every shorter prefix is refused, trailing bytes are ignored
+    for (uint8_t cut = 0; cut < len; cut++) {
+        if (app_beacon_tlm_decode(buf, cut, &decoded)) {
+            printf("%s: truncated payload of %u bytes accepted\n", name, cut);
+            failures++;
+        }
+    }
+    if (!app_beacon_tlm_decode(buf, len + 1, &decoded) || !tlm_equal(&decoded, &expected)) {
+        printf("%s: payload with a trailing byte refused\n", name);
+        failures++;
+    }
+}
+
+static void check_random(unsigned sets)
+{
+    char name[64];
+
+    srand(1);
+    for (unsigned set = 0; set < sets; set++) {
+        for (uint8_t fields = 0; fields <= FIELD_ALL; fields++) {
+            app_beacon_tlm_t in = {
+                .fields = fields,
+                .flags = rand() & 0x0F,
+                .battery = rand() % 128,
+                .temp = (int16_t)(rand() % 1400 - 450),
+                .light = (uint16_t)rand(),
+                .ax = (int16_t)(rand() % 18000 - 9000),
+                .ay = (int16_t)(rand() % 18000 - 9000),
+                .az = (int16_t)(rand() % 18000 - 9000),
+                .lat = (int32_t)(((int64_t)rand() * 4 + rand() % 4) % 190000000 - 95000000),
+                .lon = (int32_t)(((int64_t)rand() * 4 + rand() % 4) % 370000000 - 185000000),
+            };
+
+            snprintf(name, sizeof(name), "set %u fields %02x", set, fields);
+            round_trip(name, &in);
+        }
+    }
+}
+
+static void check_edges(void)
+{
+    static const uint8_t battery[] = { 0, 1, 99, 100, 101, 127, 128, 255 };
+    static const int16_t temp[] = { INT16_MIN, -1000, -403, -402, -401, -400, -398, -397, 0, 2, 3,
+                                    872, 873, 875, 877, 878, 900, INT16_MAX };
+    static const uint16_t light[] = { 0, 1, 15, 16, 17, 31, 32, 33, 34, 35, 1000, 4095, 4096, 63487,
+                                      63488, 64511, 64512, 65534, 65535 };
+    static const int16_t accel[] = { INT16_MIN, -8224, -8192, -8160, -33, -32, -31, 0, 31, 32, 33,
+                                     8127, 8128, 8159, 8160, INT16_MAX };
+    static const int32_t lat[] = { INT32_MIN, -90000001, -90000000, -89999957, -22, -21, 0, 21, 22,
+                                   89999957, 89999978, 89999979, 90000000, INT32_MAX };
+    static const int32_t lon[] = { INT32_MIN, -180000001, -180000000, -43, -42, 0, 42, 43,
+                                   179999871, 179999914, 179999915, 180000000, INT32_MAX };
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(battery) / sizeof(battery[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_BATTERY, .battery = battery[i] };
+        snprintf(name, sizeof(name), "battery %u", battery[i]);
+        round_trip(name, &in);
+    }
+    for (size_t i = 0; i < sizeof(temp) / sizeof(temp[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_TEMP, .temp = temp[i] };
+        snprintf(name, sizeof(name), "temperature %d", temp[i]);
+        round_trip(name, &in);
+    }
+    for (size_t i = 0; i < sizeof(light) / sizeof(light[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_LIGHT, .light = light[i] };
+        snprintf(name, sizeof(name), "light %u", light[i]);
+        round_trip(name, &in);
+    }
+    for (size_t i = 0; i < sizeof(accel) / sizeof(accel[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_ACCEL, .ax = accel[i],
+                                .ay = (int16_t)-accel[i], .az = accel[i] };
+        snprintf(name, sizeof(name), "acceleration %d", accel[i]);
+        round_trip(name, &in);
+    }
+    for (size_t i = 0; i < sizeof(lat) / sizeof(lat[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_POSITION, .lat = lat[i] };
+        snprintf(name, sizeof(name), "latitude %d", lat[i]);
+        round_trip(name, &in);
+    }
+    for (size_t i = 0; i < sizeof(lon) / sizeof(lon[0]); i++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_POSITION, .lon = lon[i] };
+        snprintf(name, sizeof(name), "longitude %d", lon[i]);
+        round_trip(name, &in);
+    }
+    for (unsigned flags = 0; flags < 256; flags++) {
+        app_beacon_tlm_t in = { .fields = (uint8_t)flags, .flags = (uint8_t)flags };
+        snprintf(name, sizeof(name), "fields and flags %02x", flags);
+        round_trip(name, &in);
+    }
+}
+
+// Light keeps the relative error the header promises
+static void check_light_error(void)
+{
+    double worst = 0;
+
+    for (uint32_t lux = 16; lux <= 0xFFFF; lux++) {
+        app_beacon_tlm_t in = { .fields = APP_BEACON_TLM_FIELD_LIGHT, .light = (uint16_t)lux };
+        app_beacon_tlm_t out;
+        uint8_t buf[APP_BEACON_TLM_MAX_LEN];
+        uint8_t len = app_beacon_tlm_encode(&in, buf, sizeof(buf));
+        double error;
+
+        cases++;
+        if (!app_beacon_tlm_decode(buf, len, &out)) {
+            printf("light %u: decode failed\n", lux);
+            failures++;
+            continue;
+        }
+        error = fabs((double)out.light - lux) / lux;
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    printf("light: worst relative error %.2f %%\n", worst * 100);
+    if (worst > 1.0 / 32) {
+        printf("light: error above 1/32\n");
+        failures++;
+    }
+}
+
+static void check_version(void)
+{
+    app_beacon_tlm_t in = { .fields = FIELD_ALL, .battery = 50 };
+    app_beacon_tlm_t out;
+    uint8_t buf[APP_BEACON_TLM_MAX_LEN];
+    uint8_t len = app_beacon_tlm_encode(&in, buf, sizeof(buf));
+
+    if (len != APP_BEACON_TLM_MAX_LEN) {
+        printf("every field: %u bytes, APP_BEACON_TLM_MAX_LEN is %u\n", len, APP_BEACON_TLM_MAX_LEN);
+        failures++;
+    }
+    for (uint8_t version = 0; version < 8; version++) {
+        cases++;
+        buf[0] = (uint8_t)((buf[0] & 0x1F) | (version << 5));
+        if (app_beacon_tlm_decode(buf, len, &out) != (version == APP_BEACON_TLM_VERSION)) {
+            printf("version %u: %s\n", version, version == APP_BEACON_TLM_VERSION ? "refused" : "accepted");
+            failures++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned sets = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 1000;
+
+    check_random(sets);
+    check_edges();
+    check_light_error();
+    check_version();
+
+    printf("%u cases, %d failures\n", cases, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,593 @@
+/*
+ * Estimate the charge drawn per day and the battery life of tracker
+ * configurations before they go out in a firmware.
+ *
+ * The tracker scan plans (app_scan_plan.c) and uplink queue (app_uplink_queue.c)
+ * run unchanged against a virtual clock. Every scan, uplink, receive window and
+ * beacon advertising event is charged from a current model per radio and state,
+ * on top of the sleep floor.
+ *
+ * A configuration is given by the options, and a sweep file holds one
+ * configuration per line as key=value pairs overriding them. The lines are
+ * simulated in parallel, one process per line, and reported in file order.
+ *
+ * Usage: energy_sim [-t type] [-p period_s] [-g gnss_s] [-w wifi_s] [-b ble_s]
+ *                   [-i beacon_ms] [-r dr] [-a] [-D] [-d days] [-c capacity_mah]
+ *                   [-m key=value] [-f sweep_file] [-j jobs] [-s seed] [-v]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "app_scan_plan.h"
+#include "app_scan_topk.h"
+#include "app_uplink_queue.h"
+#include "main_lorawan_tracker.h"
+
+#define SWEEP_MAX       256
+#define LINE_MAX_LEN    512
+
+// LoRaWAN frame overhead: MHDR, FHDR without options, FPort and MIC
+#define LORAWAN_OVERHEAD    13
+
+// Record sizes of app_uplink_schema.c: data ID, event, battery, temperature and light,
+// then the accelerometer, the position or the scan count and entries
+#define RECORD_SENSOR_LEN   7
+#define RECORD_ACC_LEN      6
+#define RECORD_GPS_LEN      8
+#define RECORD_ENTRY_LEN    7
+
+static const char *const plan_names[] = {
+    "GNSS_ONLY", "WIFI_ONLY", "WIFI_GNSS", "GNSS_WIFI",
+    "BLE_ONLY", "BLE_WIFI", "BLE_GNSS", "BLE_WIFI_GNSS",
+};
+
+static const char *const tech_names[APP_SCAN_TECH_NUM] = { "gnss", "wifi", "ble" };
+
+// EU868 data rates: spreading factor and largest application payload
+static const uint8_t dr_sf[] = { 12, 11, 10, 9, 8, 7 };
+static const uint8_t dr_payload_max[] = { 51, 51, 51, 115, 222, 222 };
+
+typedef struct {
+    // Firmware configuration
+    int type;
+    uint32_t period_s;
+    uint32_t durations[APP_SCAN_TECH_NUM];
+    uint8_t wifi_max;
+    uint8_t ble_max;
+    uint32_t beacon_ms;             // advertising interval, 0 with the beacon off
+    uint8_t dr;
+    bool acc;
+    bool duty_cycle;
+    // Environment
+    double success_prob[APP_SCAN_TECH_NUM];
+    double early_prob;
+    uint32_t days;
+    unsigned int seed;
+    // Current model, in mA unless stated
+    double scan_ma[APP_SCAN_TECH_NUM];
+    double tx_ma;
+    double rx_ma;
+    double sleep_ma;
+    double acc_ma;
+    double adv_uc;                  // charge of one advertising event in uC
+    double capacity_mah;
+} sim_config_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t fixes;
+    uint32_t uplinks;
+    uint32_t dropped;
+    double airtime_s;
+    double scan_mc[APP_SCAN_TECH_NUM];
+    double lora_mc;
+    double beacon_mc;
+    double base_mc;                 // sleep floor and accelerometer
+    uint32_t sim_s;                 // simulated time
+} sim_result_t;
+
+static const sim_config_t config_default = {
+    .type = TRACKER_SCAN_BLE_WIFI_GNSS,
+    .period_s = 300,
+    .durations = { 30, 3, 3 },
+    .wifi_max = 3,
+    .ble_max = 3,
+    .beacon_ms = 100,
+    .dr = 2,
+    .acc = false,
+    .duty_cycle = true,
+    .success_prob = { 0.6, 0.8, 0.5 },
+    .early_prob = 0.5,
+    .days = 7,
+    .seed = 1,
+    .scan_ma = { 11.0, 12.0, 6.5 },
+    .tx_ma = 45.0,
+    .rx_ma = 6.0,
+    .sleep_ma = 0.012,
+    .acc_ma = 0.05,
+    .adv_uc = 15.0,
+    .capacity_mah = 700.0,
+};
+
+static int verbose = 0;
+
+// State of the running simulation, one configuration per process
+static const sim_config_t *cfg;
+static sim_result_t *res;
+static uint32_t now_s = 0;
+static uint32_t alarm_at_s = 0;
+static uint32_t scan_begin_s[APP_SCAN_TECH_NUM];
+static uint32_t scan_ready_s[APP_SCAN_TECH_NUM];
+static bool scan_result[APP_SCAN_TECH_NUM];
+static bool run_result[APP_SCAN_TECH_NUM];
+static app_uplink_queue_t queue;
+static double tx_free_s = 0;        // end of the last uplink and its receive windows
+static double tx_allowed_s = 0;     // duty cycle budget recovered
+
+static bool draw(double prob)
+{
+    return rand() < prob * ((double)RAND_MAX + 1);
+}
+
+/*
+ * LoRa time on air at 125 kHz, coding rate 4/5, 8 symbol preamble, explicit
+ * header and CRC, low data rate optimisation from SF11.
+ */
+static double lora_symbol_s(uint8_t sf)
+{
+    return (double)(1u << sf) / 125000.0;
+}
+
+static double lora_airtime_s(uint8_t sf, uint8_t len)
+{
+    int de = sf >= 11;
+    double n = ceil((8.0 * len - 4.0 * sf + 28 + 16) / (4.0 * (sf - 2 * de)));
+
+    return (12.25 + 8 + (n > 0 ? n * 5 : 0)) * lora_symbol_s(sf);
+}
+
+static void sim_scan_begin(uint8_t tech)
+{
+    scan_result[tech] = draw(cfg->success_prob[tech]);
+    scan_begin_s[tech] = now_s;
+    scan_ready_s[tech] = UINT32_MAX;
+    if (scan_result[tech] && draw(cfg->early_prob)) {
+        scan_ready_s[tech] = now_s + 1 + rand() % cfg->durations[tech];
+    }
+    if (verbose) {
+        printf("%8u s  %s begin\n", now_s, tech_names[tech]);
+    }
+}
+
+static bool sim_scan_ready(uint8_t tech)
+{
+    return now_s >= scan_ready_s[tech];
+}
+
+// Checked like the tracker does: BLE every second, GNSS every 2 s, Wi-Fi only once stopped
+static uint32_t sim_scan_poll_s(uint8_t tech)
+{
+    static const uint32_t poll_s[APP_SCAN_TECH_NUM] = {
+        [APP_SCAN_TECH_GNSS] = 2,
+        [APP_SCAN_TECH_WIFI] = 0,
+        [APP_SCAN_TECH_BLE] = 1,
+    };
+
+    return poll_s[tech];
+}
+
+static bool sim_scan_end(uint8_t tech)
+{
+    res->scan_mc[tech] += (now_s - scan_begin_s[tech]) * cfg->scan_ma[tech];
+    run_result[tech] |= scan_result[tech];
+    if (verbose) {
+        printf("%8u s  %s end, %s\n", now_s, tech_names[tech], scan_result[tech] ? "result" : "nothing");
+    }
+    return scan_result[tech];
+}
+
+static uint32_t sim_scan_duration(uint8_t tech)
+{
+    return cfg->durations[tech];
+}
+
+static void sim_alarm_start(uint32_t delay_s)
+{
+    alarm_at_s = now_s + delay_s;
+}
+
+static uint32_t sim_time_s(void)
+{
+    return now_s;
+}
+
+static const app_scan_plan_ops_t sim_ops = {
+    .scan_begin = sim_scan_begin,
+    .scan_end = sim_scan_end,
+    .scan_ready = sim_scan_ready,
+    .scan_poll_s = sim_scan_poll_s,
+    .scan_duration = sim_scan_duration,
+    .alarm_start = sim_alarm_start,
+    .time_s = sim_time_s,
+};
+
+static void sim_uplink_dropped(void)
+{
+    res->dropped++;
+    if (verbose) {
+        printf("%8u s  uplink dropped\n", now_s);
+    }
+}
+
+/*
+ * Send the queued uplinks due before to_s, as the main loop does once the
+ * previous uplink is done and the duty cycle allows, then move the clock.
+ */
+static void sim_advance(uint32_t to_s)
+{
+    app_uplink_t uplink;
+    uint8_t sf = dr_sf[cfg->dr];
+
+    while (app_uplink_queue_count(&queue)) {
+        double at_s = now_s;
+
+        if (at_s < tx_free_s) at_s = tx_free_s;
+        if (cfg->duty_cycle && at_s < tx_allowed_s) at_s = tx_allowed_s;
+        if (at_s >= to_s) {
+            break;
+        }
+
+        while (app_uplink_queue_expire(&queue, APP_UPLINK_PRIO_PERIODIC, (uint32_t)(at_s * 1000),
+                                       cfg->period_s * 1000, &uplink)) {
+            sim_uplink_dropped();
+        }
+        if (!app_uplink_queue_pop(&queue, &uplink)) {
+            break;
+        }
+
+        // Receive windows stay open for 6 symbols, RX1 at the uplink data rate, RX2 at SF12
+        double airtime_s = lora_airtime_s(sf, uplink.len + LORAWAN_OVERHEAD);
+        double rx_s = 6 * (lora_symbol_s(sf) + lora_symbol_s(12));
+
+        res->uplinks++;
+        res->airtime_s += airtime_s;
+        res->lora_mc += airtime_s * cfg->tx_ma + rx_s * cfg->rx_ma;
+        tx_free_s = at_s + airtime_s + 2 + rx_s;          // RX2 opens 2 s after the uplink
+        tx_allowed_s = at_s + airtime_s * 100;              // 1 % duty cycle
+        if (verbose) {
+            printf("%8u s  uplink %u bytes, %.3f s on air\n", (uint32_t)at_s, uplink.len, airtime_s);
+        }
+    }
+    now_s = to_s;
+}
+
+static void sim_push(uint8_t len)
+{
+    app_uplink_t uplink, dropped;
+
+    memset(&uplink, 0, sizeof(uplink));
+    uplink.prio = APP_UPLINK_PRIO_PERIODIC;
+    uplink.port = LORAWAN_APP_PORT;
+    uplink.queued_ms = now_s * 1000;
+    uplink.len = len;
+    switch (app_uplink_queue_push(&queue, &uplink, &dropped)) {
+    case APP_UPLINK_QUEUED_DROPPED:
+    case APP_UPLINK_REJECTED:
+        sim_uplink_dropped();
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Send the records of a done run as the firmware does: as many as the data
+ * rate carries in one frame, GNSS first, the rest LORWAN_SEND_INTERVAL_MIN later.
+ */
+static void sim_send_results(void)
+{
+    uint8_t sensor_len = RECORD_SENSOR_LEN + (cfg->acc ? RECORD_ACC_LEN : 0);
+    uint8_t records[APP_SCAN_TECH_NUM];
+    uint8_t record_num = 0;
+    uint8_t payload_max = dr_payload_max[cfg->dr];
+
+    if (run_result[APP_SCAN_TECH_GNSS]) records[record_num++] = sensor_len + RECORD_GPS_LEN;
+    if (run_result[APP_SCAN_TECH_WIFI]) records[record_num++] = sensor_len + 1 + RECORD_ENTRY_LEN * cfg->wifi_max;
+    if (run_result[APP_SCAN_TECH_BLE]) records[record_num++] = sensor_len + 1 + RECORD_ENTRY_LEN * cfg->ble_max;
+    if (record_num == 0) {
+        sim_push(sensor_len);
+        return;
+    }
+    res->fixes++;
+
+    for (uint8_t i = 0; i < record_num;) {
+        uint8_t len = records[i++];
+
+        while (i < record_num && len + records[i] <= payload_max) {
+            len += records[i++];
+        }
+        sim_push(len);
+        if (i < record_num) {
+            sim_advance(now_s + LORWAN_SEND_INTERVAL_MIN);
+        }
+    }
+}
+
+static void simulate(const sim_config_t *config, sim_result_t *result)
+{
+    const app_scan_plan_t *plan = app_scan_plan_get(config->type);
+    uint32_t end_s = config->days * 86400;
+    app_scan_plan_ctx_t ctx;
+
+    cfg = config;
+    res = result;
+    memset(res, 0, sizeof(*res));
+    now_s = alarm_at_s = 0;
+    tx_free_s = tx_allowed_s = 0;
+    srand(config->seed);
+    app_scan_plan_init(&ctx, &sim_ops);
+    app_uplink_queue_init(&queue);
+
+    while (now_s < end_s) {
+        memset(run_result, 0, sizeof(run_result));
+        while (!app_scan_plan_step(&ctx, plan)) {
+            sim_advance(alarm_at_s);
+        }
+        res->runs++;
+        sim_send_results();
+        sim_alarm_start(app_scan_plan_finish(&ctx, config->period_s));
+        sim_advance(alarm_at_s);
+    }
+    res->sim_s = now_s;
+
+    if (config->beacon_ms) {
+        res->beacon_mc = (double)now_s * 1000 / config->beacon_ms * config->adv_uc / 1000;
+    }
+    res->base_mc = now_s * (config->sleep_ma + (config->acc ? config->acc_ma : 0));
+}
+
+static int config_set(sim_config_t *config, const char *key, const char *value)
+{
+    double v = atof(value);
+
+    if (!strcmp(key, "type")) config->type = (int)v;
+    else if (!strcmp(key, "period")) config->period_s = (uint32_t)v;
+    else if (!strcmp(key, "gnss")) config->durations[APP_SCAN_TECH_GNSS] = (uint32_t)v;
+    else if (!strcmp(key, "wifi")) config->durations[APP_SCAN_TECH_WIFI] = (uint32_t)v;
+    else if (!strcmp(key, "ble")) config->durations[APP_SCAN_TECH_BLE] = (uint32_t)v;
+    else if (!strcmp(key, "wifi_max")) config->wifi_max = (uint8_t)v;
+    else if (!strcmp(key, "ble_max")) config->ble_max = (uint8_t)v;
+    else if (!strcmp(key, "beacon")) config->beacon_ms = (uint32_t)v;
+    else if (!strcmp(key, "dr")) config->dr = (uint8_t)v;
+    else if (!strcmp(key, "acc")) config->acc = v != 0;
+    else if (!strcmp(key, "duty_cycle")) config->duty_cycle = v != 0;
+    else if (!strcmp(key, "gnss_prob")) config->success_prob[APP_SCAN_TECH_GNSS] = v;
+    else if (!strcmp(key, "wifi_prob")) config->success_prob[APP_SCAN_TECH_WIFI] = v;
+    else if (!strcmp(key, "ble_prob")) config->success_prob[APP_SCAN_TECH_BLE] = v;
+    else if (!strcmp(key, "early_prob")) config->early_prob = v;
+    else if (!strcmp(key, "days")) config->days = (uint32_t)v;
+    else if (!strcmp(key, "seed")) config->seed = (unsigned int)v;
+    else if (!strcmp(key, "gnss_ma")) config->scan_ma[APP_SCAN_TECH_GNSS] = v;
+    else if (!strcmp(key, "wifi_ma")) config->scan_ma[APP_SCAN_TECH_WIFI] = v;
+    else if (!strcmp(key, "ble_ma")) config->scan_ma[APP_SCAN_TECH_BLE] = v;
+    else if (!strcmp(key, "tx_ma")) config->tx_ma = v;
+    else if (!strcmp(key, "rx_ma")) config->rx_ma = v;
+    else if (!strcmp(key, "sleep_ma")) config->sleep_ma = v;
+    else if (!strcmp(key, "acc_ma")) config->acc_ma = v;
+    else if (!strcmp(key, "adv_uc")) config->adv_uc = v;
+    else if (!strcmp(key, "capacity")) config->capacity_mah = v;
+    else return -1;
+    return 0;
+}
+
+static int config_check(const sim_config_t *config)
+{
+    return app_scan_plan_get(config->type) != NULL && config->period_s > 0 && config->days > 0
+           && config->dr < sizeof(dr_sf) && config->wifi_max <= APP_SCAN_TOPK_MAX
+           && config->ble_max <= APP_SCAN_TOPK_MAX && config->durations[APP_SCAN_TECH_GNSS] > 0
+           && config->durations[APP_SCAN_TECH_WIFI] > 0 && config->durations[APP_SCAN_TECH_BLE] > 0;
+}
+
+/*
+ * Parse one sweep line of key=value pairs over the base configuration.
+ * Returns 0 for an empty or comment line, -1 on error.
+ */
+static int config_parse(const sim_config_t *base, char *line, sim_config_t *config)
+{
+    char *save = NULL;
+    int count = 0;
+
+    *config = *base;
+    for (char *tok = strtok_r(line, " \t\r\n", &save); tok && tok[0] != '#';
+         tok = strtok_r(NULL, " \t\r\n", &save)) {
+        char *eq = strchr(tok, '=');
+
+        if (eq == NULL) {
+            return -1;
+        }
+        *eq = '\0';
+        if (config_set(config, tok, eq + 1)) {
+            fprintf(stderr, "unknown key %s\n", tok);
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+static void print_header(void)
+{
+    printf("%-13s %6s %4s %4s %4s %6s %2s %3s | %6s %6s %6s %6s %7s | %7s %7s %7s %7s | %8s %7s\n",
+           "type", "period", "gnss", "wifi", "ble", "beacon", "dr", "acc",
+           "runs", "fix", "uplink", "drop", "air/day",
+           "scan", "lora", "beacon", "base", "mAh/day", "days");
+}
+
+static void print_result(const sim_config_t *config, const sim_result_t *result)
+{
+    double days = result->sim_s / 86400.0;
+    double scan_mc = 0;
+
+    for (int t = 0; t < APP_SCAN_TECH_NUM; t++) {
+        scan_mc += result->scan_mc[t];
+    }
+
+    // Share of the charge per source, then the total per day and the battery life it gives
+    double total_mc = scan_mc + result->lora_mc + result->beacon_mc + result->base_mc;
+    double mah_day = total_mc / 3600 / days;
+
+    printf("%-13s %6u %4u %4u %4u %6u %2u %3s | %6u %5.1f%% %6u %6u %6.1fs | %6.1f%% %6.1f%% %6.1f%% %6.1f%% | %8.2f %7.0f\n",
+           plan_names[config->type], config->period_s, config->durations[APP_SCAN_TECH_GNSS],
+           config->durations[APP_SCAN_TECH_WIFI], config->durations[APP_SCAN_TECH_BLE], config->beacon_ms,
+           config->dr, config->acc ? "on" : "off", result->runs, 100.0 * result->fixes / result->runs,
+           result->uplinks, result->dropped, result->airtime_s / days,
+           100 * scan_mc / total_mc, 100 * result->lora_mc / total_mc, 100 * result->beacon_mc / total_mc,
+           100 * result->base_mc / total_mc, mah_day, config->capacity_mah / mah_day);
+}
+
+/*
+ * Simulate every configuration, up to jobs at a time in child processes that
+ * send their result back through a pipe.
+ */
+static int sweep(const sim_config_t *configs, int count, int jobs)
+{
+    static sim_result_t results[SWEEP_MAX];
+    int fds[SWEEP_MAX];
+    pid_t pids[SWEEP_MAX];
+    int started = 0, done = 0;
+
+    while (done < count) {
+        while (started < count && started - done < jobs) {
+            int p[2];
+
+            if (pipe(p)) {
+                perror("pipe");
+                return 1;
+            }
+            fflush(stdout);
+            pids[started] = fork();
+            if (pids[started] < 0) {
+                perror("fork");
+                return 1;
+            }
+            if (pids[started] == 0) {
+                sim_result_t result;
+
+                close(p[0]);
+                simulate(&configs[started], &result);
+                _exit(write(p[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+            }
+            close(p[1]);
+            fds[started++] = p[0];
+        }
+
+        // Results are taken in file order, a slow line only holds back the ones after it
+        if (read(fds[done], &results[done], sizeof(results[done])) != sizeof(results[done])) {
+            fprintf(stderr, "line %d: simulation failed\n", done + 1);
+            return 1;
+        }
+        close(fds[done]);
+        waitpid(pids[done], NULL, 0);
+        print_result(&configs[done], &results[done]);
+        done++;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static sim_config_t configs[SWEEP_MAX];
+    sim_config_t base = config_default;
+    const char *sweep_file = NULL;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:g:w:b:i:r:aDd:c:m:f:j:s:v")) != -1) {
+        char *eq;
+
+        switch (opt) {
+        case 't': base.type = atoi(optarg); break;
+        case 'p': base.period_s = strtoul(optarg, NULL, 0); break;
+        case 'g': base.durations[APP_SCAN_TECH_GNSS] = strtoul(optarg, NULL, 0); break;
+        case 'w': base.durations[APP_SCAN_TECH_WIFI] = strtoul(optarg, NULL, 0); break;
+        case 'b': base.durations[APP_SCAN_TECH_BLE] = strtoul(optarg, NULL, 0); break;
+        case 'i': base.beacon_ms = strtoul(optarg, NULL, 0); break;
+        case 'r': base.dr = atoi(optarg); break;
+        case 'a': base.acc = true; break;
+        case 'D': base.duty_cycle = false; break;
+        case 'd': base.days = strtoul(optarg, NULL, 0); break;
+        case 'c': base.capacity_mah = atof(optarg); break;
+        case 'm':
+            eq = strchr(optarg, '=');
+            if (eq == NULL || (*eq = '\0', config_set(&base, optarg, eq + 1))) {
+                fprintf(stderr, "invalid -m %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f': sweep_file = optarg; break;
+        case 'j': jobs = atoi(optarg); break;
+        case 's': base.seed = strtoul(optarg, NULL, 0); break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-t type] [-p period_s] [-g gnss_s] [-w wifi_s] [-b ble_s]\n"
+                            "       [-i beacon_ms] [-r dr] [-a] [-D] [-d days] [-c capacity_mah]\n"
+                            "       [-m key=value] [-f sweep_file] [-j jobs] [-s seed] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (sweep_file) {
+        FILE *f = fopen(sweep_file, "r");
+        char line[LINE_MAX_LEN];
+        int line_num = 0;
+
+        if (f == NULL) {
+            perror(sweep_file);
+            return 1;
+        }
+        while (fgets(line, sizeof(line), f)) {
+            int n;
+
+            line_num++;
+            n = config_parse(&base, line, &configs[count]);
+            if (n < 0 || (n > 0 && !config_check(&configs[count]))) {
+                fprintf(stderr, "%s:%d: invalid configuration\n", sweep_file, line_num);
+                fclose(f);
+                return 1;
+            }
+            if (n > 0 && ++count == SWEEP_MAX) {
+                break;
+            }
+        }
+        fclose(f);
+    } else {
+        configs[count++] = base;
+        if (!config_check(&base)) {
+            fprintf(stderr, "invalid configuration\n");
+            return 1;
+        }
+    }
+
+    printf("%u days, tx %.0f mA, rx %.1f mA, sleep %.3f mA, gnss %.1f mA, wifi %.1f mA, ble %.1f mA, "
+           "advertising %.0f uC, battery %.0f mAh\n\n",
+           base.days, base.tx_ma, base.rx_ma, base.sleep_ma, base.scan_ma[APP_SCAN_TECH_GNSS],
+           base.scan_ma[APP_SCAN_TECH_WIFI], base.scan_ma[APP_SCAN_TECH_BLE], base.adv_uc, base.capacity_mah);
+    print_header();
+
+    if (verbose || count == 1) {
+        for (int i = 0; i < count; i++) {
+            sim_result_t result;
+
+            simulate(&configs[i], &result);
+            print_result(&configs[i], &result);
+        }
+        return 0;
+    }
+    return sweep(configs, count, jobs > 0 ? jobs : 1);
+}
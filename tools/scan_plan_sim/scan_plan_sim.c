@@ -0,0 +1,223 @@
+/*
+ * Run the tracker scan plans against a virtual clock and report how long each
+ * run takes and how regular the reporting period stays.
+ *
+ * Every scan succeeds with its configured probability, and ending a scan may
+ * take a few extra seconds to model the handler latency seen on the device.
+ * A successful scan has enough good results early with the -E probability, at
+ * a uniformly drawn time within its duration.
+ *
+ * Usage: scan_plan_sim [-t type] [-p period_s] [-g gnss_s] [-w wifi_s] [-b ble_s]
+ *                      [-G gnss_prob] [-W wifi_prob] [-B ble_prob] [-E early_prob]
+ *                      [-l latency_s] [-n runs] [-s seed] [-C] [-F] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "app_scan_plan.h"
+#include "main_lorawan_tracker.h"
+
+static const char *const plan_names[] = {
+    "GNSS_ONLY", "WIFI_ONLY", "WIFI_GNSS", "GNSS_WIFI",
+    "BLE_ONLY", "BLE_WIFI", "BLE_GNSS", "BLE_WIFI_GNSS",
+};
+
+static const char *const tech_names[APP_SCAN_TECH_NUM] = { "gnss", "wifi", "ble" };
+
+static uint32_t durations[APP_SCAN_TECH_NUM] = { 30, 3, 3 };
+static double success_prob[APP_SCAN_TECH_NUM] = { 0.6, 0.8, 0.5 };
+static double early_prob = 0.5;
+static uint32_t end_latency_s = 0;
+static int verbose = 0;
+
+// Virtual clock, advanced to the alarm on every step
+static uint32_t now_s = 0;
+static uint32_t alarm_at_s = 0;
+
+static uint32_t run_scans = 0;
+static uint32_t run_scan_s = 0;
+static bool run_success = false;
+
+// Outcome of the running scans, drawn when they begin
+static bool scan_result[APP_SCAN_TECH_NUM];
+static uint32_t scan_begin_s[APP_SCAN_TECH_NUM];
+static uint32_t scan_ready_s[APP_SCAN_TECH_NUM];
+
+static bool draw(double prob)
+{
+    return rand() < prob * ((double)RAND_MAX + 1);
+}
+
+static void sim_scan_begin(uint8_t tech)
+{
+    scan_result[tech] = draw(success_prob[tech]);
+    scan_begin_s[tech] = now_s;
+    scan_ready_s[tech] = UINT32_MAX;
+    if (scan_result[tech] && draw(early_prob)) {
+        scan_ready_s[tech] = now_s + 1 + rand() % durations[tech];
+    }
+
+    run_scans++;
+    if (verbose) {
+        printf("%8u s  %s begin\n", now_s, tech_names[tech]);
+    }
+}
+
+static bool sim_scan_ready(uint8_t tech)
+{
+    return now_s >= scan_ready_s[tech];
+}
+
+// Checked like the tracker does: BLE every second, GNSS every 2 s, Wi-Fi only once stopped
+static uint32_t sim_scan_poll_s(uint8_t tech)
+{
+    static const uint32_t poll_s[APP_SCAN_TECH_NUM] = {
+        [APP_SCAN_TECH_GNSS] = 2,
+        [APP_SCAN_TECH_WIFI] = 0,
+        [APP_SCAN_TECH_BLE] = 1,
+    };
+
+    return poll_s[tech];
+}
+
+static bool sim_scan_end(uint8_t tech)
+{
+    bool result = scan_result[tech];
+
+    run_scan_s += now_s - scan_begin_s[tech];
+    now_s += end_latency_s;
+    run_success |= result;
+    if (verbose) {
+        printf("%8u s  %s end, %s\n", now_s, tech_names[tech], result ? "result" : "nothing");
+    }
+    return result;
+}
+
+static uint32_t sim_scan_duration(uint8_t tech)
+{
+    return durations[tech];
+}
+
+static void sim_alarm_start(uint32_t delay_s)
+{
+    alarm_at_s = now_s + delay_s;
+}
+
+static uint32_t sim_time_s(void)
+{
+    return now_s;
+}
+
+static app_scan_plan_ops_t sim_ops = {
+    .scan_begin = sim_scan_begin,
+    .scan_end = sim_scan_end,
+    .scan_ready = sim_scan_ready,
+    .scan_poll_s = sim_scan_poll_s,
+    .scan_duration = sim_scan_duration,
+    .alarm_start = sim_alarm_start,
+    .time_s = sim_time_s,
+};
+
+static void simulate(uint8_t type, uint32_t period_s, uint32_t runs)
+{
+    const app_scan_plan_t *plan = app_scan_plan_get(type);
+    app_scan_plan_ctx_t ctx;
+    uint64_t total_run_s = 0, total_scans = 0, total_scan_s = 0;
+    uint32_t successes = 0, max_run_s = 0;
+    uint32_t max_gap_s = 0, min_gap_s = UINT32_MAX;
+    uint32_t last_begin_s = 0;
+
+    app_scan_plan_init(&ctx, &sim_ops);
+    now_s = alarm_at_s = 0;
+
+    for (uint32_t run = 0; run < runs; run++) {
+        run_scans = 0;
+        run_scan_s = 0;
+        run_success = false;
+
+        while (!app_scan_plan_step(&ctx, plan)) {
+            now_s = alarm_at_s;
+        }
+
+        uint32_t run_s = now_s - ctx.begin_s;
+        total_run_s += run_s;
+        total_scans += run_scans;
+        total_scan_s += run_scan_s;
+        successes += run_success;
+        if (run_s > max_run_s) {
+            max_run_s = run_s;
+        }
+        if (run > 0) {
+            uint32_t gap = ctx.begin_s - last_begin_s;
+            if (gap > max_gap_s) max_gap_s = gap;
+            if (gap < min_gap_s) min_gap_s = gap;
+        }
+        last_begin_s = ctx.begin_s;
+
+        // Results are sent at once, the next run starts when the period is over
+        sim_alarm_start(app_scan_plan_finish(&ctx, period_s));
+        now_s = alarm_at_s;
+    }
+
+    uint32_t worst_s = app_scan_plan_worst_case_s(&ctx, plan);
+    printf("%-14s worst %4u s  mean %6.1f s  max %4u s  scans %.2f  on-time %6.1f s  fix %5.1f %%  period %u..%u s  %s\n",
+           plan_names[type], worst_s, (double)total_run_s / runs, max_run_s,
+           (double)total_scans / runs, (double)total_scan_s / runs, 100.0 * successes / runs,
+           runs > 1 ? min_gap_s : period_s, runs > 1 ? max_gap_s : period_s,
+           worst_s < period_s ? "ok" : "OVER BUDGET");
+}
+
+int main(int argc, char **argv)
+{
+    int type = -1;
+    uint32_t period_s = 60;
+    uint32_t runs = 10000;
+    unsigned int seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:g:w:b:G:W:B:E:l:n:s:CFv")) != -1) {
+        switch (opt) {
+        case 't': type = atoi(optarg); break;
+        case 'p': period_s = strtoul(optarg, NULL, 0); break;
+        case 'g': durations[APP_SCAN_TECH_GNSS] = strtoul(optarg, NULL, 0); break;
+        case 'w': durations[APP_SCAN_TECH_WIFI] = strtoul(optarg, NULL, 0); break;
+        case 'b': durations[APP_SCAN_TECH_BLE] = strtoul(optarg, NULL, 0); break;
+        case 'G': success_prob[APP_SCAN_TECH_GNSS] = atof(optarg); break;
+        case 'W': success_prob[APP_SCAN_TECH_WIFI] = atof(optarg); break;
+        case 'B': success_prob[APP_SCAN_TECH_BLE] = atof(optarg); break;
+        case 'l': end_latency_s = strtoul(optarg, NULL, 0); break;
+        case 'n': runs = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'E': early_prob = atof(optarg); break;
+        case 'C': app_scan_plan_set_concurrent(true); break;
+        case 'F': sim_ops.scan_ready = NULL; break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-t type] [-p period_s] [-g gnss_s] [-w wifi_s] [-b ble_s]\n"
+                            "       [-G gnss_prob] [-W wifi_prob] [-B ble_prob] [-E early_prob]\n"
+                            "       [-l latency_s] [-n runs] [-s seed] [-C] [-F] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (runs == 0 || (type >= 0 && app_scan_plan_get(type) == NULL)) {
+        fprintf(stderr, "invalid plan type or run count\n");
+        return 1;
+    }
+
+    printf("period %u s, gnss %u s p=%.2f, wifi %u s p=%.2f, ble %u s p=%.2f, early p=%.2f%s, end latency %u s, %u runs\n\n",
+           period_s, durations[APP_SCAN_TECH_GNSS], success_prob[APP_SCAN_TECH_GNSS],
+           durations[APP_SCAN_TECH_WIFI], success_prob[APP_SCAN_TECH_WIFI],
+           durations[APP_SCAN_TECH_BLE], success_prob[APP_SCAN_TECH_BLE], early_prob,
+           sim_ops.scan_ready ? "" : " (off)", end_latency_s, runs);
+
+    for (int t = 0; t < (int)(sizeof(plan_names) / sizeof(plan_names[0])); t++) {
+        if (type < 0 || type == t) {
+            srand(seed);
+            simulate(t, period_s, runs);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Encode recorded GNSS tracks with the tracker track codec and report the
+ * bytes per fix and the position error for a set of quantisation steps.
+ *
+ * Track format, one fix per line, '#' starts a comment:
+ *
+ *   <timestamp_s> <latitude_deg> <longitude_deg>
+ *
+ * Usage: track_bench [-k key_interval] [-q quant_udeg]... [-S fixes] [track...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "app_track_codec.h"
+
+#define QUANT_MAX       16
+#define METERS_PER_UDEG 0.111195
+
+typedef struct {
+    int32_t lat;
+    int32_t lon;
+} fix_t;
+
+typedef struct {
+    fix_t *fixes;
+    size_t count;
+    size_t capacity;
+} track_t;
+
+static void track_add(track_t *track, int32_t lat, int32_t lon)
+{
+    if (track->count == track->capacity) {
+        size_t capacity = track->capacity ? track->capacity * 2 : 1024;
+        fix_t *grown = realloc(track->fixes, capacity * sizeof(*grown));
+        if (!grown) {
+            return;
+        }
+        track->fixes = grown;
+        track->capacity = capacity;
+    }
+    track->fixes[track->count].lat = lat;
+    track->fixes[track->count].lon = lon;
+    track->count++;
+}
+
+static int load_track(const char *path, track_t *track)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    double t, lat, lon;
+
+    if (!file) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%lf %lf %lf", &t, &lat, &lon) == 3) {
+            track_add(track, (int32_t)lround(lat * 1e6), (int32_t)lround(lon * 1e6));
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/*
+ * Walk at about 1.4 m/s with a fix every 60 s, stopping now and then, with
+ * a few meters of GNSS noise on every fix.
+ */
+static void synth_track(track_t *track, size_t fixes)
+{
+    double lat = 46.5197e6, lon = 6.6323e6;
+    double heading = 0;
+    int stopped = 0;
+
+    srand(1);
+    for (size_t i = 0; i < fixes; i++) {
+        if (stopped > 0) {
+            stopped--;
+        } else if (rand() % 20 == 0) {
+            stopped = 5 + rand() % 30;
+        } else {
+            heading += ((double)rand() / RAND_MAX - 0.5) * 0.8;
+            double step_udeg = 84.0 / METERS_PER_UDEG;
+            lat += step_udeg * cos(heading);
+            lon += step_udeg * sin(heading) / cos(lat * 1e-6 * M_PI / 180);
+        }
+        double noise_udeg = 3.0 / METERS_PER_UDEG;
+        track_add(track, (int32_t)(lat + ((double)rand() / RAND_MAX - 0.5) * noise_udeg),
+                  (int32_t)(lon + ((double)rand() / RAND_MAX - 0.5) * noise_udeg));
+    }
+}
+
+static double error_m(const fix_t *fix, int32_t lat, int32_t lon)
+{
+    double dy = (lat - fix->lat) * METERS_PER_UDEG;
+    double dx = (lon - fix->lon) * METERS_PER_UDEG * cos(fix->lat * 1e-6 * M_PI / 180);
+
+    return sqrt(dx * dx + dy * dy);
+}
+
+static int run(const track_t *track, uint32_t quant, uint8_t key_interval)
+{
+    app_track_codec_t codec;
+    app_track_decoder_t decoder;
+    uint8_t buf[APP_TRACK_FIX_MAX];
+    uint64_t bytes = 0;
+    uint32_t keys = 0;
+    double err_sum = 0, err_max = 0;
+
+    app_track_codec_init(&codec, quant, key_interval);
+    app_track_decoder_init(&decoder);
+
+    for (size_t i = 0; i < track->count; i++) {
+        int32_t lat, lon;
+        uint8_t len = app_track_encode(&codec, track->fixes[i].lat, track->fixes[i].lon, buf, sizeof(buf));
+
+        if (len == 0 || app_track_decode(&decoder, buf, len, &lat, &lon) != len) {
+            fprintf(stderr, "fix %zu: codec mismatch\n", i);
+            return -1;
+        }
+        keys += buf[0] == 0x01;
+        bytes += len;
+
+        double err = error_m(&track->fixes[i], lat, lon);
+        err_sum += err;
+        if (err > err_max) {
+            err_max = err;
+        }
+    }
+
+    double per_fix = (double)bytes / track->count;
+    printf("%8u %10.2f %7.1f%% %6u %9.2f %8.2f %8.0f %8.0f %8.0f\n", quant, per_fix, 100 * per_fix / 8, keys,
+           err_sum / track->count, err_max, floor(51 / per_fix), floor(115 / per_fix), floor(242 / per_fix));
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t quant_default[] = { 1, 10, 20, 50, 100 };
+    uint32_t quants[QUANT_MAX];
+    size_t quant_num = 0;
+    size_t synth = 0;
+    int key_interval = APP_TRACK_KEY_INTERVAL_DEFAULT;
+    track_t track = { 0 };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:q:S:")) != -1) {
+        switch (opt) {
+        case 'k':
+            key_interval = atoi(optarg);
+            break;
+        case 'q':
+            if (quant_num < QUANT_MAX) {
+                quants[quant_num++] = (uint32_t)strtoul(optarg, NULL, 0);
+            }
+            break;
+        case 'S':
+            synth = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-k key_interval] [-q quant_udeg]... [-S fixes] [track...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (load_track(argv[i], &track) < 0) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (synth) {
+        synth_track(&track, synth);
+    }
+    if (track.count == 0) {
+        fprintf(stderr, "no fixes, give a track file or -S fixes\n");
+        return 1;
+    }
+    if (quant_num == 0) {
+        memcpy(quants, quant_default, sizeof(quant_default));
+        quant_num = sizeof(quant_default) / sizeof(quant_default[0]);
+    }
+
+    if (key_interval > 0) {
+        printf("fixes: %zu, keyframe every %d fixes", track.count, key_interval + 1);
+    } else {
+        printf("fixes: %zu, first fix only as keyframe", track.count);
+    }
+    printf(", absolute encoding 8 bytes/fix\n\n");
+    printf("   quant  bytes/fix    ratio   keys  mean err  max err  fix/51B fix/115B fix/242B\n");
+    printf("  (1e-6)                                   (m)      (m)\n");
+    for (size_t i = 0; i < quant_num; i++) {
+        if (run(&track, quants[i], (uint8_t)key_interval) < 0) {
+            return 1;
+        }
+    }
+
+    free(track.fixes);
+    return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Host side of the tracker uplink schema (tracker_with_beacon/app_uplink_schema.c).
+ *
+ *   uplink_schema_tool js              print the backend payload decoder
+ *   uplink_schema_tool check           golden round trip of every record type
+ *   uplink_schema_tool bench [count]   encode and decode rate
+ *
+ * The decoder is generated from the same table the firmware encodes with, so
+ * the two cannot drift apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_uplink_schema.h"
+#include "app_lora_packet.h"
+#include "main_lorawan_tracker.h"
+
+static void print_js(void)
+{
+    const app_uplink_schema_t *schema;
+
+    printf("// Generated by uplink_schema_tool js from app_uplink_schema.c, do not edit\n");
+    printf("var RECORDS = {\n");
+    for (uint8_t i = 0; (schema = app_uplink_schema_at(i)) != NULL; i++) {
+        printf("  %u: { name: \"%s\", fields: [", schema->id, schema->name);
+        for (uint8_t f = 0; f < schema->field_num; f++) {
+            printf("%s\"%s\"", f ? ", " : "", app_uplink_schema_field_name(schema->fields[f]));
+        }
+        printf("] },\n");
+    }
+    printf("};\n\n");
+
+    printf(
+        "function u16(b, i) { return (b[i] << 8) | b[i + 1]; }\n"
+        "function s16(b, i) { var v = u16(b, i); return v > 0x7fff ? v - 0x10000 : v; }\n"
+        "function s32(b, i) { return (b[i] << 24) | (b[i + 1] << 16) | (b[i + 2] << 8) | b[i + 3]; }\n"
+        "function varint(b, i) {\n"
+        "  var v = 0, n = 0;\n"
+        "  do { if (i + n >= b.length) return null; v += (b[i + n] & 0x7f) * Math.pow(2, 7 * n); } while (b[i + n++] & 0x80);\n"
+        "  return { value: v, len: n };\n"
+        "}\n"
+        "function mac(b, i) {\n"
+        "  var s = [];\n"
+        "  for (var k = 0; k < 6; k++) s.push(('0' + b[i + k].toString(16)).slice(-2));\n"
+        "  return s.join(':');\n"
+        "}\n\n"
+        "function decodeRecord(b, pos) {\n"
+        "  var schema = RECORDS[b[pos]];\n"
+        "  if (!schema) return null;\n"
+        "  var r = { type: schema.name };\n"
+        "  var i = pos + 1;\n"
+        "  for (var f = 0; f < schema.fields.length; f++) {\n"
+        "    switch (schema.fields[f]) {\n"
+        "    case \"event\": r.event = b[i]; i += 1; break;\n"
+        "    case \"battery\": r.battery = b[i] > 0x7f ? b[i] - 0x100 : b[i]; i += 1; break;\n"
+        "    case \"temperature\": r.temperature = s16(b, i); i += 2; break;\n"
+        "    case \"light\": r.light = u16(b, i); i += 2; break;\n"
+        "    case \"acc\": r.acc = { x: s16(b, i), y: s16(b, i + 2), z: s16(b, i + 4) }; i += 6; break;\n"
+        "    case \"position\": r.longitude = s32(b, i) / 1e6; r.latitude = s32(b, i + 4) / 1e6; i += 8; break;\n"
+        "    case \"track\":\n"
+        "      // Kept raw, the track decoder needs the previous fixes of the device\n"
+        "      var start = i, n = b[i] === 1 ? 1 : 2;\n"
+        "      if (b[i] === 1) i += 1;\n"
+        "      while (n--) { var v = varint(b, i); if (!v) return null; i += v.len; }\n"
+        "      if (b[start] === 1) i += 8;\n"
+        "      r.track = b.slice(start, i);\n"
+        "      break;\n"
+        "    case \"time\":\n"
+        "      // GPS time of the fix, 0 if the device clock was not synced yet\n"
+        "      var t = ((b[i] << 24) | (b[i + 1] << 16) | (b[i + 2] << 8) | b[i + 3]) >>> 0;\n"
+        "      if (t) r.gpsTime = t;\n"
+        "      i += 4;\n"
+        "      break;\n"
+        "    case \"scan\":\n"
+        "      var count = b[i] & 0x7f;\n"
+        "      // A place ID stands for a Wi-Fi fingerprint the device sent before, alone or with the scan defining it\n"
+        "      if (b[i++] & 0x80) r.place = b[i++];\n"
+        "      if (i + 7 * count > b.length) return null;\n"
+        "      r.scan = [];\n"
+        "      for (var k = 0; k < count; k++, i += 7) r.scan.push({ mac: mac(b, i), rssi: b[i + 6] - 0x100 * (b[i + 6] >> 7) });\n"
+        "      break;\n"
+        "    }\n"
+        "  }\n"
+        "  if (i > b.length) return null;\n"
+        "  r.length = i - pos;\n"
+        "  return r;\n"
+        "}\n\n"
+        "function decodeUplink(input) {\n"
+        "  var b = input.bytes, records = [], pos = 0;\n"
+        "  var backfill = input.fPort === %d;\n"
+        "  while (pos < b.length) {\n"
+        "    var time = null;\n"
+        "    if (backfill) {\n"
+        "      time = ((b[pos] << 24) | (b[pos + 1] << 16) | (b[pos + 2] << 8) | b[pos + 3]) >>> 0;\n"
+        "      pos += 4;\n"
+        "    }\n"
+        "    var r = decodeRecord(b, pos);\n"
+        "    if (!r) return { data: { records: records }, errors: [\"bad record at byte \" + pos] };\n"
+        "    if (time !== null) r.gpsTime = time;\n"
+        "    pos += r.length;\n"
+        "    delete r.length;\n"
+        "    records.push(r);\n"
+        "  }\n"
+        "  return { data: { records: records } };\n"
+        "}\n",
+        LORAWAN_BACKFILL_PORT);
+}
+
+static void sample_values(const app_uplink_schema_t *schema, uint32_t seed, app_uplink_values_t *values,
+                          uint8_t *location)
+{
+    srand(seed);
+    memset(values, 0, sizeof(*values));
+    values->event = rand();
+    values->battery = rand();
+    values->temperature = rand() - RAND_MAX / 2;
+    values->light = rand();
+    values->time = (uint32_t)rand() << 16 ^ rand();
+    for (int i = 0; i < 3; i++) {
+        values->acc[i] = rand() - RAND_MAX / 2;
+    }
+    for (int i = 0; i < 64; i++) {
+        location[i] = rand();
+    }
+    values->location = location;
+
+    for (uint8_t f = 0; f < schema->field_num; f++) {
+        if (schema->fields[f] == APP_UPLINK_FIELD_POSITION) {
+            values->location_len = 8;
+        } else if (schema->fields[f] == APP_UPLINK_FIELD_SCAN) {
+            values->location_len = 7 * (1 + rand() % 9);
+        } else if (schema->fields[f] == APP_UPLINK_FIELD_TRACK) {
+            // Delta fix of two one-byte varints
+            location[0] = 0x02;
+            location[1] = 0x04;
+            values->location_len = 2;
+        }
+    }
+}
+
+static bool has_scan(const app_uplink_schema_t *schema)
+{
+    for (uint8_t f = 0; f < schema->field_num; f++) {
+        if (schema->fields[f] == APP_UPLINK_FIELD_SCAN) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Layout written by the hand-rolled builders the schema replaced: data ID,
+ * event, battery, temperature, light, acceleration if any, entry count for
+ * scans, then the location bytes. GPS records have since gained the GPS time
+ * of the fix after them, with TRACKER_GPS_FIX_TIME.
+ */
+static uint8_t legacy_encode(const app_uplink_schema_t *schema, const app_uplink_values_t *v, uint8_t *buf)
+{
+    uint8_t len = 0;
+    bool acc = false, scan = false, time = false;
+
+    for (uint8_t f = 0; f < schema->field_num; f++) {
+        acc |= schema->fields[f] == APP_UPLINK_FIELD_ACC;
+        scan |= schema->fields[f] == APP_UPLINK_FIELD_SCAN;
+        time |= schema->fields[f] == APP_UPLINK_FIELD_TIME;
+    }
+
+    buf[len++] = schema->id;
+    buf[len++] = v->event;
+    buf[len++] = v->battery;
+    buf[len++] = (uint16_t)v->temperature >> 8;
+    buf[len++] = (uint16_t)v->temperature;
+    buf[len++] = v->light >> 8;
+    buf[len++] = v->light;
+    if (acc) {
+        for (int i = 0; i < 3; i++) {
+            buf[len++] = (uint16_t)v->acc[i] >> 8;
+            buf[len++] = (uint16_t)v->acc[i];
+        }
+    }
+    if (scan) {
+        buf[len++] = v->location_len / 7;
+    }
+    memcpy(buf + len, v->location, v->location_len);
+    len += v->location_len;
+    if (time) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            buf[len++] = v->time >> shift;
+        }
+    }
+    return len;
+}
+
+static int check(void)
+{
+    const app_uplink_schema_t *schema;
+    int failures = 0;
+    uint32_t cases = 0;
+
+    for (uint8_t i = 0; (schema = app_uplink_schema_at(i)) != NULL; i++) {
+        for (uint32_t seed = 1; seed <= 1000; seed++) {
+            app_uplink_values_t values, decoded;
+            const app_uplink_schema_t *decoded_schema;
+            uint8_t location[64], golden[128], buf[128];
+
+            sample_values(schema, seed, &values, location);
+            uint8_t golden_len = legacy_encode(schema, &values, golden);
+            uint8_t len = app_uplink_schema_encode(schema, &values, buf, sizeof(buf));
+            cases++;
+
+            if (len != golden_len || memcmp(buf, golden, len) != 0) {
+                printf("%s seed %u: encoding differs from the legacy layout\n", schema->name, seed);
+                failures++;
+                continue;
+            }
+            if (app_uplink_schema_encode(schema, &values, buf, len - 1) != 0) {
+                printf("%s seed %u: encoded into a buffer too small\n", schema->name, seed);
+                failures++;
+            }
+            if (app_uplink_schema_decode(buf, len, &decoded_schema, &decoded) != len || decoded_schema != schema
+                || decoded.event != values.event || decoded.battery != values.battery
+                || decoded.temperature != values.temperature || decoded.light != values.light
+                || decoded.location_len != values.location_len
+                || memcmp(decoded.location, values.location, values.location_len) != 0
+                || (schema->fields[schema->field_num - 1] == APP_UPLINK_FIELD_TIME && decoded.time != values.time)) {
+                printf("%s seed %u: round trip mismatch\n", schema->name, seed);
+                failures++;
+                continue;
+            }
+            for (uint8_t cut = 0; cut < len; cut++) {
+                if (app_uplink_schema_decode(buf, cut, &decoded_schema, &decoded) != 0) {
+                    printf("%s seed %u: truncated record to %u bytes accepted\n", schema->name, seed, cut);
+                    failures++;
+                    break;
+                }
+            }
+
+            // Wi-Fi place ID, with the scan defining it or alone, has no legacy layout to compare with
+            if (!has_scan(schema)) {
+                continue;
+            }
+            values.place = 1 + seed % 255;
+            if (seed % 2) {
+                values.location_len = 0;
+            }
+            len = app_uplink_schema_encode(schema, &values, buf, sizeof(buf));
+            cases++;
+            if (len != app_uplink_schema_size(schema, &values)
+                || app_uplink_schema_decode(buf, len, &decoded_schema, &decoded) != len
+                || decoded.place != values.place || decoded.location_len != values.location_len
+                || memcmp(decoded.location, values.location, values.location_len) != 0) {
+                printf("%s seed %u: place round trip mismatch\n", schema->name, seed);
+                failures++;
+                continue;
+            }
+            for (uint8_t cut = 0; cut < len; cut++) {
+                if (app_uplink_schema_decode(buf, cut, &decoded_schema, &decoded) != 0) {
+                    printf("%s seed %u: truncated place record to %u bytes accepted\n", schema->name, seed, cut);
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+
+    printf("%u cases, %d failures\n", cases, failures);
+    return failures ? 1 : 0;
+}
+
+static int bench(uint32_t count)
+{
+    const app_uplink_schema_t *schema = app_uplink_schema_find(DATA_ID_UP_PACKET_WIFI_SEN_ACC_BAT);
+    app_uplink_values_t values, decoded;
+    const app_uplink_schema_t *decoded_schema;
+    uint8_t location[64], buf[128];
+    uint64_t bytes = 0;
+    struct timespec t0, t1;
+
+    sample_values(schema, 1, &values, location);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < count; i++) {
+        values.event = i;
+        bytes += app_uplink_schema_encode(schema, &values, buf, sizeof(buf));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double encode_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < count; i++) {
+        buf[1] = i;
+        bytes += app_uplink_schema_decode(buf, sizeof(buf), &decoded_schema, &decoded);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double decode_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("record:  %s, %u bytes\n", schema->name, app_uplink_schema_size(schema, &values));
+    printf("encode:  %.1f ns/record\n", encode_s * 1e9 / count);
+    printf("decode:  %.1f ns/record\n", decode_s * 1e9 / count);
+    return bytes ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "js") == 0) {
+        print_js();
+        return 0;
+    }
+    if (argc >= 2 && strcmp(argv[1], "check") == 0) {
+        return check();
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return bench(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 10000000);
+    }
+    fprintf(stderr, "usage: %s js | check | bench [count]\n", argv[0]);
+    return 1;
+}
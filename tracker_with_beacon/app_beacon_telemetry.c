@@ -0,0 +1,204 @@
+#include <string.h>
+
+#include "app_beacon_telemetry.h"
+
+#define TLM_VERSION_BITS    3
+#define TLM_FIELDS_BITS     5
+#define TLM_FLAGS_BITS      4
+#define TLM_BATTERY_BITS    7
+#define TLM_TEMP_BITS       8
+#define TLM_LIGHT_BITS      8
+#define TLM_ACCEL_BITS      8
+#define TLM_POSITION_BITS   22
+
+#define TLM_TEMP_OFFSET     400     // -40 degC in 0.1 degC
+#define TLM_TEMP_STEP       5       // 0.5 degC in 0.1 degC
+#define TLM_ACCEL_STEP      64      // mg
+
+#define TLM_LAT_RANGE       90000000LL      // 1e-6 deg
+#define TLM_LON_RANGE       180000000LL     // 1e-6 deg
+#define TLM_POSITION_SCALE  (1LL << (TLM_POSITION_BITS - 1))
+
+typedef struct {
+    uint8_t *buf;
+    uint16_t pos;
+} tlm_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    uint16_t pos;
+} tlm_reader_t;
+
+static void tlm_put(tlm_writer_t *w, uint32_t value, uint8_t width)
+{
+    while (width--) {
+        if (value & (1UL << width)) {
+            w->buf[w->pos >> 3] |= 0x80 >> (w->pos & 7);
+        }
+        w->pos++;
+    }
+}
+
+static uint32_t tlm_get(tlm_reader_t *r, uint8_t width)
+{
+    uint32_t value = 0;
+
+    while (width--) {
+        value = (value << 1) | ((r->buf[r->pos >> 3] >> (7 - (r->pos & 7))) & 1);
+        r->pos++;
+    }
+    return value;
+}
+
+static int32_t tlm_get_signed(tlm_reader_t *r, uint8_t width)
+{
+    uint32_t value = tlm_get(r, width);
+
+    if (value & (1UL << (width - 1))) {
+        value |= ~((1UL << width) - 1);
+    }
+    return (int32_t)value;
+}
+
+static int32_t tlm_clamp(int64_t value, int32_t min, int32_t max)
+{
+    return value < min ? min : (value > max ? max : (int32_t)value);
+}
+
+static int64_t tlm_div_round(int64_t num, int64_t den)
+{
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+static uint8_t tlm_light_encode(uint16_t lux)
+{
+    uint8_t msb = 15;
+    uint8_t exp;
+    uint32_t mant;
+
+    if (lux < 16) {
+        return lux;
+    }
+
+    while (!(lux & (1U << msb))) {
+        msb--;
+    }
+    exp = msb - 3;
+
+    // Round to the nearest representable value, carrying into the exponent
+    mant = ((uint32_t)lux + ((1UL << (exp - 1)) >> 1)) >> (exp - 1);
+    if (mant >= 32) {
+        mant >>= 1;
+        exp++;
+    }
+    return (exp << 4) | (mant - 16);
+}
+
+static uint16_t tlm_light_decode(uint8_t code)
+{
+    uint8_t exp = code >> 4;
+    uint32_t lux;
+
+    if (exp == 0) {
+        return code;
+    }
+
+    lux = (16UL + (code & 0x0F)) << (exp - 1);
+    return lux > 0xFFFF ? 0xFFFF : (uint16_t)lux;
+}
+
+static uint16_t tlm_encoded_bits(uint8_t fields)
+{
+    uint16_t bits = TLM_VERSION_BITS + TLM_FIELDS_BITS + TLM_FLAGS_BITS;
+
+    if (fields & APP_BEACON_TLM_FIELD_BATTERY)  bits += TLM_BATTERY_BITS;
+    if (fields & APP_BEACON_TLM_FIELD_TEMP)     bits += TLM_TEMP_BITS;
+    if (fields & APP_BEACON_TLM_FIELD_LIGHT)    bits += TLM_LIGHT_BITS;
+    if (fields & APP_BEACON_TLM_FIELD_ACCEL)    bits += 3 * TLM_ACCEL_BITS;
+    if (fields & APP_BEACON_TLM_FIELD_POSITION) bits += 2 * TLM_POSITION_BITS;
+
+    return bits;
+}
+
+uint8_t app_beacon_tlm_encode(const app_beacon_tlm_t *tlm, uint8_t *buf, uint8_t size)
+{
+    uint8_t fields = tlm->fields & ((1 << TLM_FIELDS_BITS) - 1);
+    uint8_t len = (tlm_encoded_bits(fields) + 7) / 8;
+    tlm_writer_t w = { buf, 0 };
+
+    if (len > size) {
+        return 0;
+    }
+    memset(buf, 0, len);
+
+    tlm_put(&w, APP_BEACON_TLM_VERSION, TLM_VERSION_BITS);
+    tlm_put(&w, fields, TLM_FIELDS_BITS);
+    tlm_put(&w, tlm->flags, TLM_FLAGS_BITS);
+
+    if (fields & APP_BEACON_TLM_FIELD_BATTERY) {
+        tlm_put(&w, tlm_clamp(tlm->battery, 0, 100), TLM_BATTERY_BITS);
+    }
+    if (fields & APP_BEACON_TLM_FIELD_TEMP) {
+        int32_t temp = tlm_clamp((int32_t)tlm->temp + TLM_TEMP_OFFSET, 0, INT16_MAX);
+        tlm_put(&w, tlm_clamp(tlm_div_round(temp, TLM_TEMP_STEP), 0, 255), TLM_TEMP_BITS);
+    }
+    if (fields & APP_BEACON_TLM_FIELD_LIGHT) {
+        tlm_put(&w, tlm_light_encode(tlm->light), TLM_LIGHT_BITS);
+    }
+    if (fields & APP_BEACON_TLM_FIELD_ACCEL) {
+        tlm_put(&w, (uint8_t)tlm_clamp(tlm_div_round(tlm->ax, TLM_ACCEL_STEP), -128, 127), TLM_ACCEL_BITS);
+        tlm_put(&w, (uint8_t)tlm_clamp(tlm_div_round(tlm->ay, TLM_ACCEL_STEP), -128, 127), TLM_ACCEL_BITS);
+        tlm_put(&w, (uint8_t)tlm_clamp(tlm_div_round(tlm->az, TLM_ACCEL_STEP), -128, 127), TLM_ACCEL_BITS);
+    }
+    if (fields & APP_BEACON_TLM_FIELD_POSITION) {
+        int32_t lat = tlm_clamp(tlm_div_round((int64_t)tlm->lat * TLM_POSITION_SCALE, TLM_LAT_RANGE),
+                                -TLM_POSITION_SCALE, TLM_POSITION_SCALE - 1);
+        int32_t lon = tlm_clamp(tlm_div_round((int64_t)tlm->lon * TLM_POSITION_SCALE, TLM_LON_RANGE),
+                                -TLM_POSITION_SCALE, TLM_POSITION_SCALE - 1);
+        tlm_put(&w, (uint32_t)lat & ((1UL << TLM_POSITION_BITS) - 1), TLM_POSITION_BITS);
+        tlm_put(&w, (uint32_t)lon & ((1UL << TLM_POSITION_BITS) - 1), TLM_POSITION_BITS);
+    }
+
+    return len;
+}
+
+bool app_beacon_tlm_decode(const uint8_t *buf, uint8_t len, app_beacon_tlm_t *tlm)
+{
+    tlm_reader_t r = { buf, 0 };
+
+    memset(tlm, 0, sizeof(*tlm));
+
+    if (len < 2 || (buf[0] >> (8 - TLM_VERSION_BITS)) != APP_BEACON_TLM_VERSION) {
+        return false;
+    }
+
+    tlm_get(&r, TLM_VERSION_BITS);
+    tlm->fields = tlm_get(&r, TLM_FIELDS_BITS);
+    if ((tlm_encoded_bits(tlm->fields) + 7) / 8 > len) {
+        return false;
+    }
+    tlm->flags = tlm_get(&r, TLM_FLAGS_BITS);
+
+    if (tlm->fields & APP_BEACON_TLM_FIELD_BATTERY) {
+        tlm->battery = tlm_get(&r, TLM_BATTERY_BITS);
+    }
+    if (tlm->fields & APP_BEACON_TLM_FIELD_TEMP) {
+        tlm->temp = (int16_t)(tlm_get(&r, TLM_TEMP_BITS) * TLM_TEMP_STEP - TLM_TEMP_OFFSET);
+    }
+    if (tlm->fields & APP_BEACON_TLM_FIELD_LIGHT) {
+        tlm->light = tlm_light_decode(tlm_get(&r, TLM_LIGHT_BITS));
+    }
+    if (tlm->fields & APP_BEACON_TLM_FIELD_ACCEL) {
+        tlm->ax = (int16_t)(tlm_get_signed(&r, TLM_ACCEL_BITS) * TLM_ACCEL_STEP);
+        tlm->ay = (int16_t)(tlm_get_signed(&r, TLM_ACCEL_BITS) * TLM_ACCEL_STEP);
+        tlm->az = (int16_t)(tlm_get_signed(&r, TLM_ACCEL_BITS) * TLM_ACCEL_STEP);
+    }
+    if (tlm->fields & APP_BEACON_TLM_FIELD_POSITION) {
+        tlm->lat = (int32_t)tlm_div_round((int64_t)tlm_get_signed(&r, TLM_POSITION_BITS) * TLM_LAT_RANGE,
+                                          TLM_POSITION_SCALE);
+        tlm->lon = (int32_t)tlm_div_round((int64_t)tlm_get_signed(&r, TLM_POSITION_BITS) * TLM_LON_RANGE,
+                                          TLM_POSITION_SCALE);
+    }
+
+    return true;
+}
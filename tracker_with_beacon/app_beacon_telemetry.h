@@ -0,0 +1,84 @@
+#ifndef __APP_BEACON_TELEMETRY_H__
+#define __APP_BEACON_TELEMETRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bit-packed telemetry carried in the 0xFFEE manufacturer data of the scan
+ * response. Bits are written MSB first:
+ *
+ *   version      3 bits   APP_BEACON_TLM_VERSION
+ *   fields       5 bits   presence bitmap, APP_BEACON_TLM_FIELD_*
+ *   flags        4 bits   APP_BEACON_TLM_FLAG_*, always present
+ *   battery      7 bits   0-100 %
+ *   temperature  8 bits   0.5 degC steps from -40 degC
+ *   light        8 bits   4-bit exponent / 4-bit mantissa, about 3 % error
+ *   accel      3x8 bits   signed, 64 mg steps
+ *   position  2x22 bits   signed, lat * 2^21 / 90 deg, lon * 2^21 / 180 deg
+ *
+ * Fields appear in bitmap order and absent fields take no space, the payload
+ * is padded to a whole byte. A future version may append fields, decoders
+ * reject versions they do not know.
+ */
+#define APP_BEACON_TLM_VERSION          1
+
+// Payload size with every field present
+#define APP_BEACON_TLM_MAX_LEN          13
+
+#define APP_BEACON_TLM_FIELD_BATTERY    (1 << 0)
+#define APP_BEACON_TLM_FIELD_TEMP       (1 << 1)
+#define APP_BEACON_TLM_FIELD_LIGHT      (1 << 2)
+#define APP_BEACON_TLM_FIELD_ACCEL      (1 << 3)
+#define APP_BEACON_TLM_FIELD_POSITION   (1 << 4)
+
+#define APP_BEACON_TLM_FLAG_EMERGENCY   (1 << 0)
+
+/**
+ * @brief Telemetry values in application units
+ */
+typedef struct {
+    uint8_t fields;         // Presence bitmap
+    uint8_t flags;          // Status flags
+    uint8_t battery;        // Battery level in %
+    int16_t temp;           // Temperature in 0.1 degC
+    uint16_t light;         // Light level in lux
+    int16_t ax, ay, az;     // Acceleration in mg
+    int32_t lat, lon;       // Position in 1e-6 deg
+} app_beacon_tlm_t;
+
+/**
+ * @brief Encode telemetry into its packed form
+ *
+ * Values outside the range of a field are clamped.
+ *
+ * @param tlm Telemetry to encode
+ * @param buf Output buffer
+ * @param size Output buffer size
+ *
+ * @return Encoded length, 0 if the buffer is too small
+ */
+uint8_t app_beacon_tlm_encode(const app_beacon_tlm_t *tlm, uint8_t *buf, uint8_t size);
+
+/**
+ * @brief Decode packed telemetry
+ *
+ * Fields not present in the payload are left at zero.
+ *
+ * @param buf Encoded payload
+ * @param len Encoded payload length
+ * @param tlm Decoded telemetry, quantised to the field resolution
+ *
+ * @return true on success, false on an unknown version or a truncated payload
+ */
+bool app_beacon_tlm_decode(const uint8_t *buf, uint8_t len, app_beacon_tlm_t *tlm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __APP_BEACON_TELEMETRY_H__ */
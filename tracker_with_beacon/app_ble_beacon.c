@@ -1,4 +1,5 @@
 #include "app_ble_beacon.h"
+#include "app_beacon_telemetry.h"
 #include "nordic_common.h"
 #include "app_error.h"
 #include "ble.h"
@@ -34,14 +35,38 @@ static uint8_t scan_response_data[31];
 static uint8_t scan_response_len = 0;
 static bool emergency_mode = false;
 
+// Buffers handed to the SoftDevice. It keeps reading the active pair while
+// advertising, so an update fills the other pair and then swaps them.
+static uint8_t sd_adv_data[2][sizeof(ibeacon_adv_data)];
+static uint8_t sd_scan_rsp_data[2][sizeof(scan_response_data)];
+static uint8_t sd_buf_idx = 0;
+static uint8_t adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+
+// Lazy scan response: sensor updates only mark it dirty, it is rebuilt when a scan request arrives
+static const bool lazy_scan_rsp = APP_BLE_BEACON_LAZY_SCAN_RSP;
+static bool scan_rsp_dirty = false;
+static uint32_t scan_rsp_refresh_ms = 0;
+
+// Advertising state: enabled by start/stop, suspended by the radio coexistence scheduler
+static bool beacon_enabled = false;
+static bool beacon_suspended = false;
+
 // Current sensor values
 static uint8_t current_battery = 0;
 static int16_t current_temp = 0;
 static uint16_t current_light = 0;
 static int16_t current_ax = 0, current_ay = 0, current_az = 0;
 
+// Last known position, only broadcast once a fix has been set
+static bool position_valid = false;
+static int32_t current_lat = 0, current_lon = 0;
+
 static void build_scan_response_data(void);
 static void update_ibeacon_advertising(void);
+static uint32_t configure_ibeacon_advertising(ble_gap_adv_params_t const *adv_params);
+static void beacon_on_ble_evt(ble_evt_t const *p_ble_evt, void *p_context);
+
+NRF_SDH_BLE_OBSERVER(m_beacon_ble_observer, APP_BLE_BEACON_OBSERVER_PRIO, beacon_on_ble_evt, NULL);
 
 void app_ble_beacon_init(void)
 {
@@ -58,7 +83,6 @@ void app_ble_beacon_start(void)
 {
     ret_code_t err_code;
     ble_gap_adv_params_t adv_params;
-    ble_gap_adv_data_t adv_data;
     
     // Set advertising parameters for iBeacon
     memset(&adv_params, 0, sizeof(adv_params));
@@ -67,33 +91,37 @@ void app_ble_beacon_start(void)
     adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED;
     adv_params.p_peer_addr     = NULL;
     adv_params.filter_policy   = BLE_GAP_ADV_FP_ANY;
-    adv_params.interval        = 160; // 100ms (160 * 0.625ms)
-    
-    // Set advertising data
-    memset(&adv_data, 0, sizeof(adv_data));
-    adv_data.adv_data.p_data = ibeacon_adv_data;
-    adv_data.adv_data.len    = sizeof(ibeacon_adv_data);
-    adv_data.scan_rsp_data.p_data = scan_response_data;
-    adv_data.scan_rsp_data.len    = scan_response_len;
+    adv_params.interval        = APP_BLE_BEACON_ADV_INTERVAL;
+    adv_params.scan_req_notification = lazy_scan_rsp ? 1 : 0;
     
-    err_code = sd_ble_gap_adv_set_configure(&adv_params, &adv_data, NULL);
+    // Start from fresh data, a lazy scan response may be stale
+    if (scan_rsp_dirty) {
+        build_scan_response_data();
+    }
+
+    err_code = configure_ibeacon_advertising(&adv_params);
     if (err_code != NRF_SUCCESS) {
         HAL_DBG_TRACE_ERROR("Failed to configure iBeacon advertising: %d\n", err_code);
         return;
     }
     
-    err_code = sd_ble_gap_adv_start(BLE_GAP_ADV_SET_HANDLE_DEFAULT, BLE_CONN_CFG_TAG_DEFAULT);
+    err_code = sd_ble_gap_adv_start(adv_handle, BLE_CONN_CFG_TAG_DEFAULT);
     if (err_code != NRF_SUCCESS) {
         HAL_DBG_TRACE_ERROR("Failed to start iBeacon advertising: %d\n", err_code);
         return;
     }
     
+    beacon_enabled = true;
+    beacon_suspended = false;
     HAL_DBG_TRACE_INFO("iBeacon advertising started\n");
 }
 
 void app_ble_beacon_stop(void)
 {
-    ret_code_t err_code = sd_ble_gap_adv_stop(BLE_GAP_ADV_SET_HANDLE_DEFAULT);
+    beacon_enabled = false;
+    beacon_suspended = false;
+
+    ret_code_t err_code = sd_ble_gap_adv_stop(adv_handle);
     if (err_code != NRF_SUCCESS) {
         HAL_DBG_TRACE_WARNING("Failed to stop iBeacon advertising: %d\n", err_code);
     } else {
@@ -101,6 +129,35 @@ void app_ble_beacon_stop(void)
     }
 }
 
+void app_ble_beacon_suspend(void)
+{
+    if (!beacon_enabled || beacon_suspended) {
+        return;
+    }
+
+    ret_code_t err_code = sd_ble_gap_adv_stop(adv_handle);
+    if (err_code != NRF_SUCCESS && err_code != NRF_ERROR_INVALID_STATE) {
+        HAL_DBG_TRACE_WARNING("Failed to suspend iBeacon advertising: %d\n", err_code);
+        return;
+    }
+    beacon_suspended = true;
+}
+
+void app_ble_beacon_resume(void)
+{
+    if (!beacon_enabled || !beacon_suspended) {
+        return;
+    }
+
+    // The advertising set keeps its parameters and data while stopped
+    ret_code_t err_code = sd_ble_gap_adv_start(adv_handle, BLE_CONN_CFG_TAG_DEFAULT);
+    if (err_code != NRF_SUCCESS && err_code != NRF_ERROR_INVALID_STATE) {
+        HAL_DBG_TRACE_WARNING("Failed to resume iBeacon advertising: %d\n", err_code);
+        return;
+    }
+    beacon_suspended = false;
+}
+
 void app_ble_beacon_update_sensor_data(uint8_t battery, int16_t temp, uint16_t light, 
                                        int16_t ax, int16_t ay, int16_t az, bool emergency)
 {
@@ -110,6 +167,9 @@ void app_ble_beacon_update_sensor_data(uint8_t battery, int16_t temp, uint16_t l
     current_ax = ax;
     current_ay = ay;
     current_az = az;
+
+    // The advertising packet only changes with the emergency state
+    bool adv_changed = (emergency != emergency_mode) || (emergency && battery != ibeacon_adv_data[28]);
     emergency_mode = emergency;
     
     // Update major/minor values based on emergency state
@@ -125,6 +185,13 @@ void app_ble_beacon_update_sensor_data(uint8_t battery, int16_t temp, uint16_t l
         ibeacon_adv_data[28] = 0x01;
     }
     
+    // In lazy mode the scan response waits for the next scan request,
+    // unless the advertising packet has to be pushed anyway
+    if (lazy_scan_rsp && !adv_changed) {
+        scan_rsp_dirty = true;
+        return;
+    }
+
     // Rebuild scan response data
     build_scan_response_data();
     
@@ -138,6 +205,21 @@ void app_ble_beacon_set_emergency(bool emergency)
                                      current_ax, current_ay, current_az, emergency);
 }
 
+void app_ble_beacon_update_position(int32_t lat, int32_t lon)
+{
+    position_valid = true;
+    current_lat = lat;
+    current_lon = lon;
+
+    if (lazy_scan_rsp) {
+        scan_rsp_dirty = true;
+        return;
+    }
+
+    build_scan_response_data();
+    update_ibeacon_advertising();
+}
+
 static void build_scan_response_data(void)
 {
     uint8_t pos = 0;
@@ -154,43 +236,87 @@ static void build_scan_response_data(void)
     memcpy(&scan_response_data[pos], device_name, name_len);
     pos += name_len;
     
-    // Custom manufacturer data with sensor readings
-    scan_response_data[pos++] = 15;  // Length (1 + 2 + 12 sensor bytes)
+    // Custom manufacturer data with packed telemetry, see app_beacon_telemetry.h
+    app_beacon_tlm_t tlm = {
+        .fields  = APP_BEACON_TLM_FIELD_BATTERY | APP_BEACON_TLM_FIELD_TEMP |
+                   APP_BEACON_TLM_FIELD_LIGHT | APP_BEACON_TLM_FIELD_ACCEL,
+        .flags   = emergency_mode ? APP_BEACON_TLM_FLAG_EMERGENCY : 0,
+        .battery = current_battery,
+        .temp    = current_temp,
+        .light   = current_light,
+        .ax = current_ax, .ay = current_ay, .az = current_az,
+    };
+    if (position_valid) {
+        tlm.fields |= APP_BEACON_TLM_FIELD_POSITION;
+        tlm.lat = current_lat;
+        tlm.lon = current_lon;
+    }
+
+    uint8_t tlm_len = app_beacon_tlm_encode(&tlm, &scan_response_data[pos + 4],
+                                            sizeof(scan_response_data) - pos - 4);
+    scan_response_data[pos++] = 3 + tlm_len;  // Length (type + company ID + telemetry)
     scan_response_data[pos++] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;  // Type
     scan_response_data[pos++] = 0xEE;  // Custom company ID LSB
     scan_response_data[pos++] = 0xFF;  // Custom company ID MSB
-    
-    // Sensor data payload (12 bytes)
-    scan_response_data[pos++] = current_battery;  // Battery (1 byte)
-    scan_response_data[pos++] = current_temp & 0xFF;      // Temp LSB
-    scan_response_data[pos++] = (current_temp >> 8) & 0xFF;  // Temp MSB
-    scan_response_data[pos++] = current_light & 0xFF;     // Light LSB
-    scan_response_data[pos++] = (current_light >> 8) & 0xFF; // Light MSB
-    scan_response_data[pos++] = current_ax & 0xFF;        // Accel X LSB
-    scan_response_data[pos++] = (current_ax >> 8) & 0xFF;    // Accel X MSB
-    scan_response_data[pos++] = current_ay & 0xFF;        // Accel Y LSB
-    scan_response_data[pos++] = (current_ay >> 8) & 0xFF;    // Accel Y MSB
-    scan_response_data[pos++] = current_az & 0xFF;        // Accel Z LSB
-    scan_response_data[pos++] = (current_az >> 8) & 0xFF;    // Accel Z MSB
-    scan_response_data[pos++] = emergency_mode ? 0xFF : 0x00; // Emergency flag
+    pos += tlm_len;
     
     scan_response_len = pos;
+    scan_rsp_dirty = false;
 }
 
-static void update_ibeacon_advertising(void)
+static uint32_t configure_ibeacon_advertising(ble_gap_adv_params_t const *adv_params)
 {
-    ret_code_t err_code;
+    uint32_t err_code;
+    uint8_t idx = sd_buf_idx ^ 1;
     ble_gap_adv_data_t adv_data;
-    
-    // Update advertising data
+
+    memcpy(sd_adv_data[idx], ibeacon_adv_data, sizeof(ibeacon_adv_data));
+    memcpy(sd_scan_rsp_data[idx], scan_response_data, scan_response_len);
+
     memset(&adv_data, 0, sizeof(adv_data));
-    adv_data.adv_data.p_data = ibeacon_adv_data;
+    adv_data.adv_data.p_data = sd_adv_data[idx];
     adv_data.adv_data.len    = sizeof(ibeacon_adv_data);
-    adv_data.scan_rsp_data.p_data = scan_response_data;
+    adv_data.scan_rsp_data.p_data = sd_scan_rsp_data[idx];
     adv_data.scan_rsp_data.len    = scan_response_len;
-    
-    err_code = sd_ble_gap_adv_set_configure(NULL, &adv_data, NULL);
+
+    err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, adv_params);
+    if (err_code == NRF_SUCCESS) {
+        sd_buf_idx = idx;
+    }
+    return err_code;
+}
+
+static void update_ibeacon_advertising(void)
+{
+    // Nothing to update before the advertising set exists
+    if (adv_handle == BLE_GAP_ADV_SET_HANDLE_NOT_SET) {
+        return;
+    }
+
+    ret_code_t err_code = configure_ibeacon_advertising(NULL);
     if (err_code != NRF_SUCCESS) {
         HAL_DBG_TRACE_WARNING("Failed to update iBeacon advertising data: %d\n", err_code);
     }
+}
+
+static void beacon_on_ble_evt(ble_evt_t const *p_ble_evt, void *p_context)
+{
+    if (p_ble_evt->header.evt_id != BLE_GAP_EVT_SCAN_REQ_REPORT ||
+        p_ble_evt->evt.gap_evt.params.scan_req_report.adv_handle != adv_handle) {
+        return;
+    }
+
+    if (!lazy_scan_rsp || !scan_rsp_dirty) {
+        return;
+    }
+
+    // The SoftDevice has already answered this request, the refresh serves the next scanner
+    uint32_t now_ms = hal_rtc_get_time_ms();
+    if (now_ms - scan_rsp_refresh_ms < APP_BLE_BEACON_SCAN_RSP_MIN_REFRESH_MS) {
+        return;
+    }
+    scan_rsp_refresh_ms = now_ms;
+
+    build_scan_response_data();
+    update_ibeacon_advertising();
 } 
\ No newline at end of file
@@ -8,6 +8,30 @@
 extern "C" {
 #endif
 
+// iBeacon advertising interval in 0.625 ms units (100 ms)
+#define APP_BLE_BEACON_ADV_INTERVAL     160
+#define APP_BLE_BEACON_ADV_INTERVAL_MS  ((APP_BLE_BEACON_ADV_INTERVAL * 5) / 8)
+
+/*
+ * Build the scan response only when a scan request arrives, false (the
+ * default) to rebuild it on every sensor or position update.
+ *
+ * The SoftDevice answers a scan request before reporting it, so the scanner
+ * that triggers a refresh still gets the previous scan response and only the
+ * next scan request sees the new values: the scan response lags by one scan,
+ * and by up to APP_BLE_BEACON_SCAN_RSP_MIN_REFRESH_MS more between refreshes.
+ * The first scanner after a quiet period may then get values hours old, so
+ * only set it where scan response freshness does not matter.
+ * Emergency changes are not delayed, they update the advertising packet at once.
+ */
+#define APP_BLE_BEACON_LAZY_SCAN_RSP            false
+
+// Minimum time between two scan response refreshes in lazy mode
+#define APP_BLE_BEACON_SCAN_RSP_MIN_REFRESH_MS  1000
+
+// Priority of the beacon SoftDevice BLE event observer
+#define APP_BLE_BEACON_OBSERVER_PRIO            3
+
 /**
  * @brief Initialize iBeacon advertising
  */
@@ -23,20 +47,46 @@ void app_ble_beacon_start(void);
  */
 void app_ble_beacon_stop(void);
 
+/**
+ * @brief Pause iBeacon advertising without dropping its configuration
+ *
+ * Does nothing if the beacon has not been started or is already paused.
+ */
+void app_ble_beacon_suspend(void);
+
+/**
+ * @brief Resume iBeacon advertising paused by app_ble_beacon_suspend()
+ *
+ * Restarts the advertising set that is already configured, no parameters
+ * or data are pushed to the SoftDevice again.
+ */
+void app_ble_beacon_resume(void);
+
 /**
  * @brief Update iBeacon scan response with sensor data
+ *
+ * With APP_BLE_BEACON_LAZY_SCAN_RSP the values reach the scan response after
+ * the next scan request, see there.
  * 
  * @param battery Battery level (0-100)
  * @param temp Temperature in 0.1°C
  * @param light Light level in lux
- * @param ax Accelerometer X axis
- * @param ay Accelerometer Y axis  
- * @param az Accelerometer Z axis
+ * @param ax Accelerometer X axis in mg
+ * @param ay Accelerometer Y axis in mg
+ * @param az Accelerometer Z axis in mg
  * @param emergency Emergency status flag
  */
 void app_ble_beacon_update_sensor_data(uint8_t battery, int16_t temp, uint16_t light, 
                                        int16_t ax, int16_t ay, int16_t az, bool emergency);
 
+/**
+ * @brief Update the position broadcast in the scan response
+ * 
+ * @param lat Latitude in 1e-6 degree
+ * @param lon Longitude in 1e-6 degree
+ */
+void app_ble_beacon_update_position(int32_t lat, int32_t lon);
+
 /**
  * @brief Set emergency mode (changes beacon data)
  * 
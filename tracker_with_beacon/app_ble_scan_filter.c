@@ -0,0 +1,236 @@
+#include <string.h>
+
+#include "app_ble_scan_filter.h"
+#include "app_scan_topk.h"
+#include "app_util_platform.h"
+#include "ble.h"
+#include "nrf_sdh_ble.h"
+
+#define AD_TYPE_MANUFACTURER_DATA   0xFF
+
+#define APPLE_COMPANY_ID            0x004C
+#define IBEACON_TYPE                0x02
+#define IBEACON_LEN                 0x15
+
+// Filter configuration
+static int8_t rssi_floor = APP_BLE_SCAN_FILTER_RSSI_FLOOR_DEFAULT;
+static bool dedupe_enabled = true;
+static uint8_t allow_uuid[APP_BLE_SCAN_FILTER_UUID_MAX][16];
+static uint8_t allow_uuid_num = 0;
+static uint16_t allow_company[APP_BLE_SCAN_FILTER_COMPANY_MAX];
+static uint8_t allow_company_num = 0;
+
+// Scan window state, written from the SoftDevice event handler
+static volatile bool window_open = false;
+static app_scan_topk_t selection;
+static app_ble_scan_filter_stats_t filter_stats;
+
+// Duplicate table: advertiser address hash and best RSSI, replaced round robin when full
+static uint32_t dedupe_hash[APP_BLE_SCAN_FILTER_DEDUPE_SIZE];
+static int8_t dedupe_rssi[APP_BLE_SCAN_FILTER_DEDUPE_SIZE];
+static uint8_t dedupe_num = 0;
+static uint8_t dedupe_next = 0;
+
+static void scan_filter_on_ble_evt(ble_evt_t const *p_ble_evt, void *p_context);
+
+NRF_SDH_BLE_OBSERVER(m_scan_filter_ble_observer, APP_BLE_SCAN_FILTER_OBSERVER_PRIO, scan_filter_on_ble_evt, NULL);
+
+static uint32_t addr_hash(const uint8_t *addr)
+{
+    // FNV-1a, addresses are random enough that collisions only cost a missed update
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < BLE_GAP_ADDR_LEN; i++) {
+        hash = (hash ^ addr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Returns true if the report adds nothing to what the window already has
+static bool dedupe_check(const uint8_t *addr, int8_t rssi)
+{
+    uint32_t hash = addr_hash(addr);
+
+    for (uint8_t i = 0; i < dedupe_num; i++) {
+        if (dedupe_hash[i] == hash) {
+            if (rssi <= dedupe_rssi[i]) {
+                return true;
+            }
+            dedupe_rssi[i] = rssi;
+            return false;
+        }
+    }
+
+    dedupe_hash[dedupe_next] = hash;
+    dedupe_rssi[dedupe_next] = rssi;
+    dedupe_next = (dedupe_next + 1) % APP_BLE_SCAN_FILTER_DEDUPE_SIZE;
+    if (dedupe_num < APP_BLE_SCAN_FILTER_DEDUPE_SIZE) {
+        dedupe_num++;
+    }
+    return false;
+}
+
+static bool allowlist_match(const uint8_t *data, uint16_t len)
+{
+    uint16_t pos = 0;
+
+    if (allow_uuid_num == 0 && allow_company_num == 0) {
+        return true;
+    }
+
+    while (pos + 1 < len) {
+        uint8_t field_len = data[pos];
+        if (field_len == 0 || pos + 1 + field_len > len) {
+            break;
+        }
+
+        const uint8_t *field = &data[pos + 1];
+        if (field[0] == AD_TYPE_MANUFACTURER_DATA && field_len >= 3) {
+            uint16_t company = field[1] | (field[2] << 8);
+
+            for (uint8_t i = 0; i < allow_company_num; i++) {
+                if (allow_company[i] == company) {
+                    return true;
+                }
+            }
+
+            if (company == APPLE_COMPANY_ID && field_len >= 21 &&
+                field[3] == IBEACON_TYPE && field[4] == IBEACON_LEN) {
+                for (uint8_t i = 0; i < allow_uuid_num; i++) {
+                    if (memcmp(&field[5], allow_uuid[i], 16) == 0) {
+                        return true;
+                    }
+                }
+            }
+        }
+        pos += 1 + field_len;
+    }
+    return false;
+}
+
+static void scan_filter_on_adv_report(ble_gap_evt_adv_report_t const *report)
+{
+    uint8_t entry[APP_SCAN_ENTRY_LEN];
+
+    filter_stats.seen++;
+
+    if (report->rssi < rssi_floor) {
+        filter_stats.rssi_dropped++;
+        return;
+    }
+    // Before dedupe: an advertiser rotating frames from one address is only recorded once a frame is allowed
+    if (!allowlist_match(report->data.p_data, report->data.len)) {
+        filter_stats.allowlist_dropped++;
+        return;
+    }
+    if (dedupe_enabled && dedupe_check(report->peer_addr.addr, report->rssi)) {
+        filter_stats.dup_dropped++;
+        return;
+    }
+
+    for (int i = 0; i < BLE_GAP_ADDR_LEN; i++) {
+        entry[i] = report->peer_addr.addr[BLE_GAP_ADDR_LEN - 1 - i];
+    }
+    entry[APP_SCAN_ENTRY_RSSI] = (uint8_t)report->rssi;
+
+    filter_stats.accepted++;
+    app_scan_topk_add(&selection, entry);
+}
+
+static void scan_filter_on_ble_evt(ble_evt_t const *p_ble_evt, void *p_context)
+{
+    (void)p_context;
+
+    // The scanner owning the scan resumes it, this observer only looks at the reports
+    if (window_open && p_ble_evt->header.evt_id == BLE_GAP_EVT_ADV_REPORT) {
+        scan_filter_on_adv_report(&p_ble_evt->evt.gap_evt.params.adv_report);
+    }
+}
+
+void app_ble_scan_filter_init(void)
+{
+    rssi_floor = APP_BLE_SCAN_FILTER_RSSI_FLOOR_DEFAULT;
+    dedupe_enabled = true;
+    allow_uuid_num = 0;
+    allow_company_num = 0;
+    window_open = false;
+    app_scan_topk_init(&selection, 0);
+    memset(&filter_stats, 0, sizeof(filter_stats));
+}
+
+void app_ble_scan_filter_set_rssi_floor(int8_t rssi)
+{
+    rssi_floor = rssi;
+}
+
+void app_ble_scan_filter_set_dedupe(bool enable)
+{
+    dedupe_enabled = enable;
+}
+
+bool app_ble_scan_filter_add_uuid(const uint8_t *uuid)
+{
+    if (allow_uuid_num >= APP_BLE_SCAN_FILTER_UUID_MAX) {
+        return false;
+    }
+    memcpy(allow_uuid[allow_uuid_num++], uuid, 16);
+    return true;
+}
+
+bool app_ble_scan_filter_add_company(uint16_t company_id)
+{
+    if (allow_company_num >= APP_BLE_SCAN_FILTER_COMPANY_MAX) {
+        return false;
+    }
+    allow_company[allow_company_num++] = company_id;
+    return true;
+}
+
+void app_ble_scan_filter_clear_allowlist(void)
+{
+    allow_uuid_num = 0;
+    allow_company_num = 0;
+}
+
+void app_ble_scan_filter_start(uint8_t k)
+{
+    CRITICAL_REGION_ENTER();
+    app_scan_topk_init(&selection, k);
+    memset(&filter_stats, 0, sizeof(filter_stats));
+    dedupe_num = 0;
+    dedupe_next = 0;
+    window_open = true;
+    CRITICAL_REGION_EXIT();
+}
+
+void app_ble_scan_filter_stop(void)
+{
+    window_open = false;
+}
+
+uint8_t app_ble_scan_filter_count_above(int8_t rssi_min)
+{
+    uint8_t count;
+
+    CRITICAL_REGION_ENTER();
+    count = app_scan_topk_count_above(&selection, rssi_min);
+    CRITICAL_REGION_EXIT();
+    return count;
+}
+
+uint8_t app_ble_scan_filter_get_results(uint8_t *buffer)
+{
+    uint8_t len;
+
+    CRITICAL_REGION_ENTER();
+    len = app_scan_topk_get(&selection, buffer);
+    CRITICAL_REGION_EXIT();
+    return len;
+}
+
+void app_ble_scan_filter_get_stats(app_ble_scan_filter_stats_t *stats)
+{
+    CRITICAL_REGION_ENTER();
+    *stats = filter_stats;
+    CRITICAL_REGION_EXIT();
+}
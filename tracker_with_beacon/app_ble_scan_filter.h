@@ -0,0 +1,114 @@
+#ifndef __APP_BLE_SCAN_FILTER_H__
+#define __APP_BLE_SCAN_FILTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Allowlist sizes
+#define APP_BLE_SCAN_FILTER_UUID_MAX        4
+#define APP_BLE_SCAN_FILTER_COMPANY_MAX     4
+
+// Advertisers remembered per scan window for duplicate filtering
+#define APP_BLE_SCAN_FILTER_DEDUPE_SIZE     32
+
+// Default RSSI floor in dBm, reports below it are dropped first
+#define APP_BLE_SCAN_FILTER_RSSI_FLOOR_DEFAULT  (-100)
+
+// Priority of the scan filter SoftDevice BLE event observer, ahead of the beacon
+#define APP_BLE_SCAN_FILTER_OBSERVER_PRIO   1
+
+/**
+ * @brief Scan filter counters, cleared by app_ble_scan_filter_start()
+ */
+typedef struct {
+    uint32_t seen;                  // Advertising reports received
+    uint32_t accepted;              // Reports passed to the strongest-N selection
+    uint32_t rssi_dropped;          // Below the RSSI floor
+    uint32_t dup_dropped;           // Advertiser already seen with an equal or better RSSI
+    uint32_t allowlist_dropped;     // No allowlisted iBeacon UUID or company ID
+} app_ble_scan_filter_stats_t;
+
+/**
+ * @brief Reset the filters: floor at the default, duplicate filtering on, empty allowlist
+ */
+void app_ble_scan_filter_init(void);
+
+/**
+ * @brief Set the RSSI floor in dBm
+ */
+void app_ble_scan_filter_set_rssi_floor(int8_t rssi);
+
+/**
+ * @brief Enable or disable duplicate filtering
+ *
+ * A report from an advertiser already seen in the window is dropped unless
+ * its RSSI is better than the best one seen so far.
+ */
+void app_ble_scan_filter_set_dedupe(bool enable);
+
+/**
+ * @brief Allow iBeacons with a proximity UUID
+ *
+ * @param uuid Proximity UUID, 16 bytes as broadcast
+ *
+ * @return false if the UUID allowlist is full
+ */
+bool app_ble_scan_filter_add_uuid(const uint8_t *uuid);
+
+/**
+ * @brief Allow advertisers whose manufacturer data carries a company ID
+ *
+ * @return false if the company allowlist is full
+ */
+bool app_ble_scan_filter_add_company(uint16_t company_id);
+
+/**
+ * @brief Empty both allowlists, every advertiser is then allowed
+ */
+void app_ble_scan_filter_clear_allowlist(void);
+
+/**
+ * @brief Open a scan window
+ *
+ * Clears the counters, the duplicate table and the selection, then keeps the
+ * k strongest advertisers passing the filters until app_ble_scan_filter_stop().
+ *
+ * @param k Number of advertisers to keep
+ */
+void app_ble_scan_filter_start(uint8_t k);
+
+/**
+ * @brief Close the scan window, reports are ignored again
+ */
+void app_ble_scan_filter_stop(void);
+
+/**
+ * @brief Count the advertisers kept at or above an RSSI
+ */
+uint8_t app_ble_scan_filter_count_above(int8_t rssi_min);
+
+/**
+ * @brief Copy the advertisers kept, strongest first
+ *
+ * Each entry is the MAC address (MSB first) then the RSSI, see app_scan_topk.h.
+ *
+ * @param buffer Output, at least k * APP_SCAN_ENTRY_LEN bytes
+ *
+ * @return Number of bytes written
+ */
+uint8_t app_ble_scan_filter_get_results(uint8_t *buffer);
+
+/**
+ * @brief Get the filter counters of the current or last scan window
+ */
+void app_ble_scan_filter_get_stats(app_ble_scan_filter_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __APP_BLE_SCAN_FILTER_H__
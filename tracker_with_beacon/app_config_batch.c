@@ -0,0 +1,440 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_config_batch.h"
+#include "app_fds_store.h"
+#include "fds.h"
+#include "smtc_hal.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Stored configuration, every value of the table in order
+ *
+ * base holds the values the parameter store will load at the next boot, as
+ * far as this module knows: a loaded value that differs from it was saved by
+ * the parameter store after the record was written, and wins over the batch
+ * value. A parameter store save seen while running rewrites the record.
+ */
+typedef struct
+{
+    uint16_t layout;                            // CRC-16 of the tags and sizes of the table
+    uint8_t len;
+    uint8_t data[APP_CONFIG_BATCH_DATA_MAX];
+    uint8_t base[APP_CONFIG_BATCH_DATA_MAX];
+} config_store_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define CONFIG_STORE_WORDS      (( sizeof( config_store_t ) + 3 ) / 4 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+// FDS reads the data of a write until it completes, a batch arriving meanwhile is written after it
+static config_store_t store;
+static app_fds_store_write_t store_write;
+static const app_config_table_t* store_table = NULL;
+static bool store_pending = false;
+
+// Values the parameter store loads at the next boot, and the values in force as last seen
+static uint8_t base[APP_CONFIG_BATCH_DATA_MAX];
+static uint8_t base_len = 0;
+static uint8_t seen[APP_CONFIG_BATCH_DATA_MAX];
+static bool stored_valid = false;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint16_t config_crc16( uint16_t crc, const uint8_t* data, uint8_t len )
+{
+    while( len-- )
+    {
+        crc ^= ( uint16_t )( *data++ ) << 8;
+        for( uint8_t i = 0; i < 8; i++ )
+        {
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t config_layout( const app_config_table_t* table )
+{
+    uint16_t crc = 0xffff;
+
+    for( uint8_t i = 0; i < table->param_num; i++ )
+    {
+        uint8_t id[2] = { table->params[i].tag, table->params[i].size };
+        crc = config_crc16( crc, id, sizeof( id ));
+    }
+    return crc;
+}
+
+static int32_t config_param_get( const app_config_param_t* param )
+{
+    switch( param->size )
+    {
+        case 1:
+        {
+            uint8_t v;
+            memcpy( &v, param->value, 1 );
+            return param->is_signed ? ( int8_t )v : v;
+        }
+        case 2:
+        {
+            uint16_t v;
+            memcpy( &v, param->value, 2 );
+            return param->is_signed ? ( int16_t )v : v;
+        }
+        default:
+        {
+            uint32_t v;
+            memcpy( &v, param->value, 4 );
+            return ( int32_t )v;
+        }
+    }
+}
+
+static void config_param_set( const app_config_param_t* param, int32_t value )
+{
+    uint8_t v8 = value;
+    uint16_t v16 = value;
+    uint32_t v32 = value;
+
+    switch( param->size )
+    {
+        case 1: memcpy( param->value, &v8, 1 ); break;
+        case 2: memcpy( param->value, &v16, 2 ); break;
+        default: memcpy( param->value, &v32, 4 ); break;
+    }
+}
+
+/*!
+ * @brief Value on the air, MSB first, sign extended for a signed parameter
+ */
+static int32_t config_wire_get( const app_config_param_t* param, const uint8_t* buf )
+{
+    uint32_t v = 0;
+
+    for( uint8_t i = 0; i < param->size; i++ )
+    {
+        v = ( v << 8 ) | buf[i];
+    }
+    if( param->is_signed && param->size < 4 && ( buf[0] & 0x80 ))
+    {
+        v |= UINT32_MAX << ( 8 * param->size );
+    }
+    return ( int32_t )v;
+}
+
+static const app_config_param_t* config_find( const app_config_table_t* table, uint8_t tag )
+{
+    for( uint8_t i = 0; i < table->param_num; i++ )
+    {
+        if( table->params[i].tag == tag )
+        {
+            return &table->params[i];
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Copy every value of the table, in order, native byte order
+ */
+static uint8_t config_snapshot( const app_config_table_t* table, uint8_t* data )
+{
+    uint8_t len = 0;
+
+    for( uint8_t i = 0; i < table->param_num && len + table->params[i].size <= APP_CONFIG_BATCH_DATA_MAX; i++ )
+    {
+        memcpy( data + len, table->params[i].value, table->params[i].size );
+        len += table->params[i].size;
+    }
+    return len;
+}
+
+static void config_restore_snapshot( const app_config_table_t* table, const uint8_t* data, uint8_t len )
+{
+    uint8_t pos = 0;
+
+    for( uint8_t i = 0; i < table->param_num && pos + table->params[i].size <= len; i++ )
+    {
+        memcpy( table->params[i].value, data + pos, table->params[i].size );
+        pos += table->params[i].size;
+    }
+}
+
+static void config_store_write( void );
+
+/*!
+ * @brief Write the record, or once more after the write in progress
+ */
+static void config_store_request( const app_config_table_t* table )
+{
+    store_table = table;
+    if( app_fds_store_is_pending( &store_write ))
+    {
+        store_pending = true;
+    }
+    else
+    {
+        config_store_write( );
+    }
+}
+
+static void config_store_done( app_fds_store_write_t* write, bool ok )
+{
+    ( void )write;
+    if( !ok )
+    {
+        HAL_DBG_TRACE_ERROR( "config write failed\n" );
+    }
+    if( store_pending )
+    {
+        store_pending = false;
+        config_store_write( );
+    }
+}
+
+static void config_store_write( void )
+{
+    stored_valid = true;
+    memset( &store, 0, sizeof( store ));
+    store.layout = config_layout( store_table );
+    store.len = config_snapshot( store_table, store.data );
+    memcpy( store.base, base, base_len );
+
+    store_write.file_id = APP_CONFIG_BATCH_FILE_ID;
+    store_write.key = APP_CONFIG_BATCH_KEY;
+    store_write.data = &store;
+    store_write.length_words = CONFIG_STORE_WORDS;
+    store_write.done = config_store_done;
+    app_fds_store_write( &store_write );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+bool app_config_batch_restore( const app_config_table_t* table )
+{
+    fds_record_desc_t desc;
+    fds_find_token_t token;
+    fds_flash_record_t flash_record;
+    config_store_t stored;
+    bool ok = false;
+    uint8_t pos = 0;
+    uint8_t kept = 0;
+
+    base_len = config_snapshot( table, base );
+    memcpy( seen, base, base_len );
+
+    memset( &token, 0, sizeof( token ));
+    if( fds_record_find( APP_CONFIG_BATCH_FILE_ID, APP_CONFIG_BATCH_KEY, &desc, &token ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( fds_record_open( &desc, &flash_record ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( flash_record.p_header->length_words == CONFIG_STORE_WORDS )
+    {
+        memcpy( &stored, flash_record.p_data, sizeof( stored ));
+        ok = stored.layout == config_layout( table ) && stored.len == base_len;
+    }
+    fds_record_close( &desc );
+
+    if( !ok )
+    {
+        return false;
+    }
+
+    // The batch value, unless the parameter store saved another one since the batch
+    for( uint8_t i = 0; i < table->param_num && pos + table->params[i].size <= stored.len; i++ )
+    {
+        uint8_t size = table->params[i].size;
+
+        if( memcmp( base + pos, stored.base + pos, size ) == 0 )
+        {
+            memcpy( table->params[i].value, stored.data + pos, size );
+        }
+        else
+        {
+            kept++;
+        }
+        pos += size;
+    }
+    config_snapshot( table, seen );
+    stored_valid = true;
+    HAL_DBG_TRACE_INFO( "config: restored, %d parameter(s) kept from the parameter store, digest %04x\n", kept,
+                        app_config_batch_digest( table ));
+    return true;
+}
+
+bool app_config_batch_apply( const app_config_table_t* table, const uint8_t* frame, uint8_t len,
+                             app_config_batch_result_t* result )
+{
+    const app_config_param_t* staged[APP_CONFIG_BATCH_PARAM_MAX];
+    int32_t values[APP_CONFIG_BATCH_PARAM_MAX];
+    uint8_t staged_num = 0;
+    uint8_t pos = 1;
+
+    memset( result, 0, sizeof( *result ));
+    result->status = APP_CONFIG_BATCH_BAD_FRAME;
+    if( len > 0 )
+    {
+        result->batch_id = frame[0];
+    }
+
+    // Every triplet is checked before any value is touched
+    while( len > 1 && pos < len )
+    {
+        const app_config_param_t* param;
+        uint8_t tag = frame[pos];
+
+        result->detail = tag;
+        if( pos + 2 > len || pos + 2 + frame[pos + 1] > len )
+        {
+            result->status = APP_CONFIG_BATCH_BAD_FRAME;
+            break;
+        }
+        if(( param = config_find( table, tag )) == NULL )
+        {
+            result->status = APP_CONFIG_BATCH_UNKNOWN_TAG;
+            break;
+        }
+        if( frame[pos + 1] != param->size )
+        {
+            result->status = APP_CONFIG_BATCH_BAD_LENGTH;
+            break;
+        }
+        for( uint8_t i = 0; i < staged_num; i++ )
+        {
+            if( staged[i] == param ) result->status = APP_CONFIG_BATCH_DUPLICATE;
+        }
+        if( result->status == APP_CONFIG_BATCH_DUPLICATE )
+        {
+            break;
+        }
+
+        int32_t value = config_wire_get( param, frame + pos + 2 );
+        if( value < param->min || value > param->max )
+        {
+            result->status = APP_CONFIG_BATCH_OUT_OF_RANGE;
+            break;
+        }
+
+        staged[staged_num] = param;
+        values[staged_num++] = value;
+        pos += 2 + param->size;
+        result->status = APP_CONFIG_BATCH_APPLIED;
+    }
+
+    if( result->status == APP_CONFIG_BATCH_APPLIED )
+    {
+        uint8_t backup[APP_CONFIG_BATCH_DATA_MAX];
+        uint8_t backup_len = config_snapshot( table, backup );
+
+        for( uint8_t i = 0; i < staged_num; i++ )
+        {
+            config_param_set( staged[i], values[i] );
+        }
+        if( table->check != NULL && !table->check( ))
+        {
+            config_restore_snapshot( table, backup, backup_len );
+            result->status = APP_CONFIG_BATCH_INCONSISTENT;
+            result->detail = 0;
+        }
+        else
+        {
+            result->detail = staged_num;
+            config_snapshot( table, seen );
+
+            // One write for the whole batch
+            config_store_request( table );
+        }
+    }
+
+    result->digest = app_config_batch_digest( table );
+    return result->status == APP_CONFIG_BATCH_APPLIED;
+}
+
+void app_config_batch_sync( const app_config_table_t* table )
+{
+    uint8_t now[APP_CONFIG_BATCH_DATA_MAX];
+    uint8_t len = config_snapshot( table, now );
+    uint8_t pos = 0;
+    uint8_t saved = 0;
+
+    if( len != base_len || memcmp( now, seen, len ) == 0 )
+    {
+        return;
+    }
+
+    // Set outside a batch, so saved by the parameter store: the next boot loads it
+    for( uint8_t i = 0; i < table->param_num && pos + table->params[i].size <= len; i++ )
+    {
+        uint8_t size = table->params[i].size;
+
+        if( memcmp( now + pos, seen + pos, size ) != 0 )
+        {
+            memcpy( base + pos, now + pos, size );
+            saved++;
+        }
+        pos += size;
+    }
+    memcpy( seen, now, len );
+
+    if( stored_valid )
+    {
+        HAL_DBG_TRACE_INFO( "config: %d parameter(s) saved by the parameter store, batch record rewritten\n", saved );
+        config_store_request( table );
+    }
+}
+
+uint16_t app_config_batch_digest( const app_config_table_t* table )
+{
+    uint16_t crc = 0xffff;
+
+    for( uint8_t i = 0; i < table->param_num; i++ )
+    {
+        const app_config_param_t* param = &table->params[i];
+        uint32_t value = config_param_get( param );
+        uint8_t buf[5] = { param->tag };
+
+        for( uint8_t j = 0; j < param->size; j++ )
+        {
+            buf[1 + j] = value >> ( 8 * ( param->size - 1 - j ));
+        }
+        crc = config_crc16( crc, buf, 1 + param->size );
+    }
+    return crc;
+}
+
+void app_config_batch_ack( const app_config_batch_result_t* result, uint8_t* buf )
+{
+    buf[0] = result->batch_id;
+    buf[1] = result->status;
+    buf[2] = result->detail;
+    buf[3] = result->digest >> 8;
+    buf[4] = result->digest;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,169 @@
+#ifndef APP_CONFIG_BATCH_H
+#define APP_CONFIG_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief FDS file and key of the stored configuration
+ */
+#define APP_CONFIG_BATCH_FILE_ID    0x4643
+#define APP_CONFIG_BATCH_KEY        0x0001
+
+/*!
+ * @brief Most parameters in a table, and bytes of all their values together
+ */
+#define APP_CONFIG_BATCH_PARAM_MAX  24
+#define APP_CONFIG_BATCH_DATA_MAX   64
+
+/*!
+ * @brief Length of the acknowledgement
+ */
+#define APP_CONFIG_BATCH_ACK_LEN    5
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Outcome of a batch, sent back in the acknowledgement
+ */
+typedef enum
+{
+    APP_CONFIG_BATCH_APPLIED = 0,
+    APP_CONFIG_BATCH_BAD_FRAME,                 // truncated TLV or empty batch
+    APP_CONFIG_BATCH_UNKNOWN_TAG,
+    APP_CONFIG_BATCH_BAD_LENGTH,                // value length is not the parameter size
+    APP_CONFIG_BATCH_OUT_OF_RANGE,
+    APP_CONFIG_BATCH_DUPLICATE,                 // a tag given twice
+    APP_CONFIG_BATCH_INCONSISTENT,              // every value valid, the set refused by the check
+} app_config_batch_status_t;
+
+/*!
+ * @brief One configurable parameter
+ *
+ * The value goes on the air on size bytes, MSB first, size being the size of the variable.
+ */
+typedef struct
+{
+    uint8_t tag;
+    uint8_t size;                               // 1, 2 or 4
+    bool is_signed;
+    void* value;
+    int32_t min;
+    int32_t max;
+} app_config_param_t;
+
+/*!
+ * @brief Table of the configurable parameters
+ */
+typedef struct
+{
+    const app_config_param_t* params;
+    uint8_t param_num;
+    bool ( *check )( void );                    // consistency of the whole set once applied, NULL for none
+} app_config_table_t;
+
+/*!
+ * @brief Result of a batch
+ */
+typedef struct
+{
+    uint8_t batch_id;                           // first byte of the frame, echoed back
+    uint8_t status;                             // @ref app_config_batch_status_t
+    uint8_t detail;                             // parameters applied, or the tag at fault
+    uint16_t digest;                            // CRC-16 of the configuration in force
+} app_config_batch_result_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Load the configuration stored by the last batch, to be called once the parameter store is loaded
+ *
+ * A parameter keeps the value just loaded if the parameter store saved it
+ * after the record was last written, the batch value is loaded otherwise. Nothing is loaded if the table changed since the
+ * configuration was stored. Must be called before any batch is applied.
+ *
+ * @param [in] table Parameter table
+ *
+ * @returns true if a stored configuration was loaded
+ */
+bool app_config_batch_restore( const app_config_table_t* table );
+
+/*!
+ * @brief Follow the parameters set outside a batch, to be called from the main loop
+ *
+ * Only the existing paths (port 5 commands, the BLE configuration) set a
+ * parameter outside a batch, and they save it to the parameter store. Such a
+ * value is written into the batch record as both the batch value and the value
+ * the parameter store loads, so the next boot keeps it even when it is the
+ * value the batch replaced.
+ *
+ * @param [in] table Parameter table
+ */
+void app_config_batch_sync( const app_config_table_t* table );
+
+/*!
+ * @brief Apply a batch of parameters, all of them or none
+ *
+ * The frame is a batch ID byte, then one or more tag, length, value triplets.
+ * Every triplet is checked against the table, then the values are set together
+ * and the table check runs; on any failure every parameter keeps its value.
+ * An applied batch is stored to flash in a single write.
+ *
+ * @param [in] table Parameter table
+ * @param [in] frame Downlink payload
+ * @param [in] len Payload length
+ * @param [out] result Outcome, digest of the configuration in force either way
+ *
+ * @returns true if the batch was applied
+ */
+bool app_config_batch_apply( const app_config_table_t* table, const uint8_t* frame, uint8_t len,
+                             app_config_batch_result_t* result );
+
+/*!
+ * @brief CRC-16 of the configuration in force
+ *
+ * CRC-16/CCITT-FALSE over every parameter in table order as tag, then value
+ * on its size MSB first, so the server can check it against the intended set.
+ *
+ * @param [in] table Parameter table
+ *
+ * @returns Digest
+ */
+uint16_t app_config_batch_digest( const app_config_table_t* table );
+
+/*!
+ * @brief Encode the acknowledgement of a batch
+ *
+ * Batch ID, status, detail, then the digest MSB first.
+ *
+ * @param [in] result Outcome of the batch
+ * @param [out] buf APP_CONFIG_BATCH_ACK_LEN bytes
+ */
+void app_config_batch_ack( const app_config_batch_result_t* result, uint8_t* buf );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_CONFIG_BATCH_H
+
+/* --- EOF ------------------------------------------------------------------ */
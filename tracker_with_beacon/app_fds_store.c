@@ -0,0 +1,162 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_fds_store.h"
+#include "fds.h"
+#include "smtc_hal.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+// Writes in order, the head is the one FDS is working on
+static app_fds_store_write_t* queue_head = NULL;
+static app_fds_store_write_t* queue_tail = NULL;
+
+// A write refused for lack of space is made again once garbage collection is over
+static bool gc_running = false;
+static bool retry_pending = false;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void fds_store_start( void );
+
+static void fds_store_complete( bool ok )
+{
+    app_fds_store_write_t* write = queue_head;
+
+    queue_head = write->next;
+    if( queue_head == NULL ) queue_tail = NULL;
+    write->next = NULL;
+
+    // The callback may queue the next write of its owner
+    if( write->done != NULL )
+    {
+        write->done( write, ok );
+    }
+    if( queue_head != NULL && !retry_pending )
+    {
+        fds_store_start( );
+    }
+}
+
+static void fds_store_start( void )
+{
+    app_fds_store_write_t* write = queue_head;
+    fds_record_t fds_record = {
+        .file_id = write->file_id,
+        .key = write->key,
+        .data.p_data = write->data,
+        .data.length_words = write->length_words,
+    };
+    fds_record_desc_t desc;
+    fds_find_token_t token;
+    ret_code_t err;
+
+    memset( &token, 0, sizeof( token ));
+    if( fds_record_find( write->file_id, write->key, &desc, &token ) == NRF_SUCCESS )
+    {
+        err = fds_record_update( &desc, &fds_record );
+    }
+    else
+    {
+        err = fds_record_write( NULL, &fds_record );
+    }
+
+    if( err == FDS_ERR_NO_SPACE_IN_FLASH )
+    {
+        retry_pending = true;
+        if( !gc_running && fds_gc( ) == NRF_SUCCESS )
+        {
+            gc_running = true;
+        }
+    }
+    else if( err != NRF_SUCCESS )
+    {
+        HAL_DBG_TRACE_ERROR( "fds write %04x/%04x failed: %d\n", write->file_id, write->key, err );
+        fds_store_complete( false );
+    }
+}
+
+static void fds_store_evt_handler( fds_evt_t const* p_evt )
+{
+    switch( p_evt->id )
+    {
+        case FDS_EVT_WRITE:
+        case FDS_EVT_UPDATE:
+            if( queue_head == NULL || retry_pending || p_evt->write.file_id != queue_head->file_id
+                || p_evt->write.record_key != queue_head->key )
+            {
+                break;
+            }
+            fds_store_complete( p_evt->result == NRF_SUCCESS );
+            break;
+
+        case FDS_EVT_GC:
+            gc_running = false;
+            if( retry_pending )
+            {
+                retry_pending = false;
+                if( queue_head != NULL )
+                {
+                    fds_store_start( );
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_fds_store_register( void )
+{
+    fds_register( fds_store_evt_handler );
+}
+
+bool app_fds_store_write( app_fds_store_write_t* write )
+{
+    if( app_fds_store_is_pending( write ))
+    {
+        return false;
+    }
+
+    write->next = NULL;
+    if( queue_tail != NULL )
+    {
+        queue_tail->next = write;
+        queue_tail = write;
+        return true;
+    }
+
+    queue_head = write;
+    queue_tail = write;
+    if( !retry_pending )
+    {
+        fds_store_start( );
+    }
+    return true;
+}
+
+bool app_fds_store_is_pending( const app_fds_store_write_t* write )
+{
+    for( const app_fds_store_write_t* w = queue_head; w != NULL; w = w->next )
+    {
+        if( w == write ) return true;
+    }
+    return false;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
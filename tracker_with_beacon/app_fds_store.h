@@ -0,0 +1,74 @@
+#ifndef APP_FDS_STORE_H
+#define APP_FDS_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+typedef struct app_fds_store_write_s app_fds_store_write_t;
+
+/*!
+ * @brief One record write, owned by the caller until its done callback
+ */
+struct app_fds_store_write_s
+{
+    uint16_t file_id;
+    uint16_t key;
+    const void* data;                           // read by FDS until the write completes
+    uint16_t length_words;
+    void ( *done )( app_fds_store_write_t* write, bool ok ); // called from the FDS event handler, NULL for none
+    app_fds_store_write_t* next;                // queue link, set by the store
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Register the store with FDS, to be called before FDS is initialised
+ */
+void app_fds_store_register( void );
+
+/*!
+ * @brief Write a record, or update it if the file already holds its key
+ *
+ * Writes go to FDS one at a time in the order they are queued. A write refused
+ * for lack of space starts garbage collection and is made again once it is
+ * over; any other failure ends the write, done may then be called before this
+ * function returns.
+ *
+ * @param [in] write Write, its data must stay valid until done is called
+ *
+ * @returns false if this write is already queued
+ */
+bool app_fds_store_write( app_fds_store_write_t* write );
+
+/*!
+ * @brief Tell whether a write is queued or in progress
+ *
+ * @param [in] write Write
+ *
+ * @returns true until its done callback
+ */
+bool app_fds_store_is_pending( const app_fds_store_write_t* write );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_FDS_STORE_H
+
+/* --- EOF ------------------------------------------------------------------ */
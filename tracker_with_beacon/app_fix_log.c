@@ -0,0 +1,245 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_fix_log.h"
+#include "app_fds_store.h"
+#include "fds.h"
+#include "smtc_hal.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define FIX_LOG_RECORD_WORDS    (( sizeof( app_fix_log_record_t ) + 3 ) / 4 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*!
+ * @brief Sequence number stored in each ring slot, 0 when the slot is empty
+ *
+ * FDS keeps the data and levels the wear: an update writes a new copy and
+ * garbage collection reclaims the old ones.
+ */
+static uint32_t slot_seq[APP_FIX_LOG_CAPACITY];
+static uint32_t next_seq = 1;
+
+// FDS reads the data of a write until it completes, so queued writes keep their own copy
+static app_fix_log_record_t write_queue[APP_FIX_LOG_WRITE_QUEUE];
+static app_fds_store_write_t write_req[APP_FIX_LOG_WRITE_QUEUE];
+static bool write_removed[APP_FIX_LOG_WRITE_QUEUE];  // removed while queued, deleted once written
+static uint8_t write_head = 0;
+static uint8_t write_count = 0;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint16_t fix_log_key( uint32_t seq )
+{
+    return APP_FIX_LOG_KEY_BASE + ( seq % APP_FIX_LOG_CAPACITY );
+}
+
+/*!
+ * @brief Delete the flash record of a sequence number, not the one of another record in its slot
+ */
+static void fix_log_delete( uint32_t seq )
+{
+    fds_record_desc_t desc;
+    fds_find_token_t token;
+    fds_flash_record_t flash_record;
+    bool match = false;
+
+    memset( &token, 0, sizeof( token ));
+    if( fds_record_find( APP_FIX_LOG_FILE_ID, fix_log_key( seq ), &desc, &token ) != NRF_SUCCESS )
+    {
+        return;
+    }
+    if( fds_record_open( &desc, &flash_record ) != NRF_SUCCESS )
+    {
+        return;
+    }
+    match = flash_record.p_header->length_words == FIX_LOG_RECORD_WORDS
+            && (( const app_fix_log_record_t* )flash_record.p_data )->seq == seq;
+    fds_record_close( &desc );
+    if( match )
+    {
+        fds_record_delete( &desc );
+    }
+}
+
+static void fix_log_write_done( app_fds_store_write_t* write, bool ok )
+{
+    // Writes complete in the order they are queued, the one completing is the head
+    ( void )write;
+    if( !ok )
+    {
+        HAL_DBG_TRACE_ERROR( "fix log write failed, seq %u\n", write_queue[write_head].seq );
+    }
+    else if( write_removed[write_head] )
+    {
+        // Sent while its write was queued, it must not come back at the next boot
+        fix_log_delete( write_queue[write_head].seq );
+    }
+    write_removed[write_head] = false;
+    write_head = ( write_head + 1 ) % APP_FIX_LOG_WRITE_QUEUE;
+    write_count--;
+}
+
+static bool fix_log_read_slot( uint8_t slot, app_fix_log_record_t* record )
+{
+    fds_record_desc_t desc;
+    fds_find_token_t token;
+    fds_flash_record_t flash_record;
+    bool ok = false;
+
+    memset( &token, 0, sizeof( token ));
+    if( fds_record_find( APP_FIX_LOG_FILE_ID, APP_FIX_LOG_KEY_BASE + slot, &desc, &token ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( fds_record_open( &desc, &flash_record ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( flash_record.p_header->length_words == FIX_LOG_RECORD_WORDS )
+    {
+        memcpy( record, flash_record.p_data, sizeof( *record ));
+        ok = true;
+    }
+    fds_record_close( &desc );
+    return ok;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_fix_log_init( void )
+{
+    app_fix_log_record_t record;
+    uint8_t count = 0;
+
+    memset( slot_seq, 0, sizeof( slot_seq ));
+    next_seq = 1;
+
+    for( uint8_t slot = 0; slot < APP_FIX_LOG_CAPACITY; slot++ )
+    {
+        if( fix_log_read_slot( slot, &record ) && record.seq != 0 && fix_log_key( record.seq ) == APP_FIX_LOG_KEY_BASE + slot )
+        {
+            slot_seq[slot] = record.seq;
+            if( record.seq >= next_seq ) next_seq = record.seq + 1;
+            count++;
+        }
+    }
+
+    HAL_DBG_TRACE_INFO( "fix log: %d record(s) to backfill\n", count );
+}
+
+bool app_fix_log_append( uint32_t timestamp_s, const uint8_t* data, uint8_t len )
+{
+    if( len > APP_FIX_LOG_DATA_MAX || write_count >= APP_FIX_LOG_WRITE_QUEUE )
+    {
+        return false;
+    }
+
+    uint8_t index = ( write_head + write_count ) % APP_FIX_LOG_WRITE_QUEUE;
+    app_fix_log_record_t* record = &write_queue[index];
+    app_fds_store_write_t* write = &write_req[index];
+    memset( record, 0, sizeof( *record ));
+    record->seq = next_seq++;
+    write_removed[index] = false;
+    record->timestamp_s = timestamp_s;
+    record->len = len;
+    memcpy( record->data, data, len );
+
+    // The slot of the oldest record is reused once the ring is full
+    slot_seq[record->seq % APP_FIX_LOG_CAPACITY] = record->seq;
+
+    write->file_id = APP_FIX_LOG_FILE_ID;
+    write->key = fix_log_key( record->seq );
+    write->data = record;
+    write->length_words = FIX_LOG_RECORD_WORDS;
+    write->done = fix_log_write_done;
+    write_count++;
+    app_fds_store_write( write );
+    return true;
+}
+
+uint8_t app_fix_log_count( void )
+{
+    uint8_t count = 0;
+
+    for( uint8_t slot = 0; slot < APP_FIX_LOG_CAPACITY; slot++ )
+    {
+        if( slot_seq[slot] ) count++;
+    }
+    return count;
+}
+
+bool app_fix_log_peek( uint8_t policy, uint8_t n, app_fix_log_record_t* record )
+{
+    // Sequence numbers are consecutive in the ring, walk them from either end
+    uint32_t newest = next_seq - 1;
+    uint32_t oldest = next_seq > APP_FIX_LOG_CAPACITY ? next_seq - APP_FIX_LOG_CAPACITY : 1;
+
+    for( uint32_t i = 0; oldest + i <= newest; i++ )
+    {
+        uint32_t seq = ( policy == APP_FIX_LOG_OLDEST_FIRST ) ? oldest + i : newest - i;
+
+        if( slot_seq[seq % APP_FIX_LOG_CAPACITY] != seq )
+        {
+            continue;
+        }
+        if( n-- > 0 )
+        {
+            continue;
+        }
+
+        // Still queued for writing, take it from RAM
+        for( uint8_t q = 0; q < write_count; q++ )
+        {
+            const app_fix_log_record_t* queued = &write_queue[( write_head + q ) % APP_FIX_LOG_WRITE_QUEUE];
+            if( queued->seq == seq )
+            {
+                *record = *queued;
+                return true;
+            }
+        }
+        return fix_log_read_slot( seq % APP_FIX_LOG_CAPACITY, record ) && record->seq == seq;
+    }
+    return false;
+}
+
+void app_fix_log_remove( uint32_t seq )
+{
+    uint8_t slot = seq % APP_FIX_LOG_CAPACITY;
+
+    if( slot_seq[slot] != seq )
+    {
+        return;
+    }
+    slot_seq[slot] = 0;
+
+    // Flash still holds the previous record of the slot until the queued write lands
+    for( uint8_t q = 0; q < write_count; q++ )
+    {
+        uint8_t index = ( write_head + q ) % APP_FIX_LOG_WRITE_QUEUE;
+        if( write_queue[index].seq == seq )
+        {
+            write_removed[index] = true;
+            return;
+        }
+    }
+    fix_log_delete( seq );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
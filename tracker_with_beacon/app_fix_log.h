@@ -0,0 +1,115 @@
+#ifndef APP_FIX_LOG_H
+#define APP_FIX_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief FDS file of the log, record keys are APP_FIX_LOG_KEY_BASE + ring slot
+ */
+#define APP_FIX_LOG_FILE_ID     0x4658
+#define APP_FIX_LOG_KEY_BASE    0x0001
+
+/*!
+ * @brief Records kept, the oldest one is overwritten when full
+ */
+#define APP_FIX_LOG_CAPACITY    32
+
+/*!
+ * @brief Largest uplink record stored: packet id, sensor block, entry count, 64 bytes of results
+ */
+#define APP_FIX_LOG_DATA_MAX    80
+
+/*!
+ * @brief Writes queued to FDS at once, their data must stay valid until FDS is done
+ */
+#define APP_FIX_LOG_WRITE_QUEUE 4
+
+/*!
+ * @brief Backfill order
+ */
+#define APP_FIX_LOG_NEWEST_FIRST    0
+#define APP_FIX_LOG_OLDEST_FIRST    1
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief One logged uplink record
+ */
+typedef struct
+{
+    uint32_t seq;                               // write order, never 0
+    uint32_t timestamp_s;                       // GPS time of the record, 0 if unknown
+    uint8_t len;
+    uint8_t data[APP_FIX_LOG_DATA_MAX];         // uplink record as built for the frame
+} app_fix_log_record_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Rebuild the index of the records in flash, to be called once FDS is initialised
+ */
+void app_fix_log_init( void );
+
+/*!
+ * @brief Append a record, overwriting the oldest one when the log is full
+ *
+ * @param [in] timestamp_s GPS time of the record, 0 if unknown
+ * @param [in] data Uplink record
+ * @param [in] len Length of data, at most APP_FIX_LOG_DATA_MAX
+ *
+ * @returns true if the write was queued
+ */
+bool app_fix_log_append( uint32_t timestamp_s, const uint8_t* data, uint8_t len );
+
+/*!
+ * @brief Number of records in the log
+ */
+uint8_t app_fix_log_count( void );
+
+/*!
+ * @brief Read the n-th record in backfill order
+ *
+ * @param [in] policy APP_FIX_LOG_NEWEST_FIRST or APP_FIX_LOG_OLDEST_FIRST
+ * @param [in] n Position in that order, 0 first
+ * @param [out] record Record
+ *
+ * @returns false if there is no such record
+ */
+bool app_fix_log_peek( uint8_t policy, uint8_t n, app_fix_log_record_t* record );
+
+/*!
+ * @brief Delete a record once it has been sent
+ *
+ * A record still queued for writing is deleted once its write completes.
+ *
+ * @param [in] seq Sequence number of the record
+ */
+void app_fix_log_remove( uint32_t seq );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_FIX_LOG_H
+
+/* --- EOF ------------------------------------------------------------------ */
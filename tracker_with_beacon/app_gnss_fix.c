@@ -0,0 +1,233 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "app_gnss_fix.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+// Retained block tag, changed whenever its layout changes
+#define GNSS_RETAINED_MAGIC 0x474E5301
+
+// Meters per 1e-6 degree of latitude
+#define GNSS_M_PER_UDEG     0.111195f
+#define GNSS_RAD_PER_UDEG   1.7453293e-8f
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static uint8_t stable_count_min = APP_GNSS_FIX_STABLE_COUNT_DEFAULT;
+static uint16_t stable_radius_m = APP_GNSS_FIX_STABLE_RADIUS_DEFAULT;
+
+/*!
+ * @brief State kept over resets, so warm reboots keep the last fix and the learned window
+ */
+typedef struct
+{
+    uint32_t magic;
+    app_gnss_aiding_t aiding;
+    app_gnss_fix_stats_t stats;
+    bool last_timeout;
+    uint32_t checksum;
+} gnss_retained_t;
+
+static gnss_retained_t retained __attribute__(( section( APP_GNSS_RETAINED_SECTION )));
+
+#define gnss_stats ( retained.stats )
+
+// Current scan
+static bool scan_running = false;
+static bool scan_fixed = false;
+static uint32_t scan_begin_ms = 0;
+static uint8_t stable_count = 0;
+static int32_t last_lat = 0, last_lon = 0;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint32_t gnss_retained_checksum( void )
+{
+    const uint8_t* data = ( const uint8_t* )&retained;
+    uint32_t sum1 = 0xffff, sum2 = 0xffff;
+
+    // Fletcher-32 over everything but the checksum itself
+    for( uint32_t i = 0; i < offsetof( gnss_retained_t, checksum ); i++ )
+    {
+        sum1 = ( sum1 + data[i] ) % 65535;
+        sum2 = ( sum2 + sum1 ) % 65535;
+    }
+    return ( sum2 << 16 ) | sum1;
+}
+
+static void gnss_retained_commit( void )
+{
+    retained.checksum = gnss_retained_checksum( );
+}
+
+static void gnss_record_ttf( uint32_t ttf_ms )
+{
+    uint32_t bucket = ttf_ms / APP_GNSS_TTF_BUCKET_MS;
+
+    gnss_stats.fixes++;
+    gnss_stats.ttf_last_ms = ttf_ms;
+    gnss_stats.ttf_sum_ms += ttf_ms;
+    if( ttf_ms < gnss_stats.ttf_min_ms ) gnss_stats.ttf_min_ms = ttf_ms;
+    if( ttf_ms > gnss_stats.ttf_max_ms ) gnss_stats.ttf_max_ms = ttf_ms;
+    if( bucket >= APP_GNSS_TTF_BUCKETS ) bucket = APP_GNSS_TTF_BUCKETS - 1;
+    if( gnss_stats.ttf_histogram[bucket] < UINT16_MAX ) gnss_stats.ttf_histogram[bucket]++;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+float app_gnss_distance_m( int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2 )
+{
+    // Equirectangular approximation, fine over the distances between two fixes
+    float lat_rad = lat1 * GNSS_RAD_PER_UDEG;
+    float dy = ( lat2 - lat1 ) * GNSS_M_PER_UDEG;
+    float dx = ( lon2 - lon1 ) * GNSS_M_PER_UDEG * cosf( lat_rad );
+
+    return sqrtf( dx * dx + dy * dy );
+}
+
+bool app_gnss_fix_init( void )
+{
+    if( retained.magic == GNSS_RETAINED_MAGIC && retained.checksum == gnss_retained_checksum( ))
+    {
+        return true;
+    }
+
+    memset( &retained, 0, sizeof( retained ));
+    retained.magic = GNSS_RETAINED_MAGIC;
+    retained.stats.ttf_min_ms = UINT32_MAX;
+    gnss_retained_commit( );
+    return false;
+}
+
+void app_gnss_fix_set_quality( uint8_t stable_count, uint16_t radius_m )
+{
+    stable_count_min = stable_count > 0 ? stable_count : 1;
+    stable_radius_m = radius_m;
+}
+
+void app_gnss_fix_begin( uint32_t now_ms )
+{
+    scan_running = true;
+    scan_fixed = false;
+    scan_begin_ms = now_ms;
+    stable_count = 0;
+    gnss_stats.attempts++;
+    gnss_retained_commit( );
+}
+
+bool app_gnss_fix_update( uint32_t now_ms, bool fix, int32_t lat, int32_t lon )
+{
+    if( !scan_running || scan_fixed )
+    {
+        return scan_fixed;
+    }
+
+    if( !fix )
+    {
+        stable_count = 0;
+        return false;
+    }
+
+    // A jump restarts the count from this fix
+    if( stable_count > 0 && app_gnss_distance_m( last_lat, last_lon, lat, lon ) > stable_radius_m )
+    {
+        stable_count = 0;
+    }
+    stable_count++;
+    last_lat = lat;
+    last_lon = lon;
+
+    if( stable_count >= stable_count_min )
+    {
+        scan_fixed = true;
+        gnss_record_ttf( now_ms - scan_begin_ms );
+        gnss_retained_commit( );
+    }
+    return scan_fixed;
+}
+
+void app_gnss_fix_end( void )
+{
+    if( scan_running )
+    {
+        if( !scan_fixed ) gnss_stats.timeouts++;
+        retained.last_timeout = !scan_fixed;
+        gnss_retained_commit( );
+    }
+    scan_running = false;
+}
+
+void app_gnss_fix_abort( void )
+{
+    if( scan_running && !scan_fixed )
+    {
+        // Says nothing about the time to fix, the window learning ignores it
+        gnss_stats.attempts--;
+        gnss_retained_commit( );
+    }
+    scan_running = false;
+}
+
+void app_gnss_fix_set_position( int32_t lat, int32_t lon, uint32_t gps_time_s )
+{
+    retained.aiding.valid = true;
+    retained.aiding.lat = lat;
+    retained.aiding.lon = lon;
+    retained.aiding.gps_time_s = gps_time_s;
+    gnss_retained_commit( );
+}
+
+void app_gnss_fix_get_aiding( app_gnss_aiding_t* aiding )
+{
+    *aiding = retained.aiding;
+}
+
+uint32_t app_gnss_fix_window_s( uint32_t max_s )
+{
+    uint32_t samples = gnss_stats.fixes + gnss_stats.timeouts;
+    uint32_t needed, count = 0;
+
+    if( samples < APP_GNSS_WINDOW_MIN_SAMPLES || retained.last_timeout )
+    {
+        return max_s;
+    }
+
+    // Smallest bucket bound covering the percentile, timeouts sort after every bucket
+    needed = ( samples * APP_GNSS_WINDOW_PERCENTILE + 99 ) / 100;
+    for( uint32_t i = 0; i < APP_GNSS_TTF_BUCKETS - 1; i++ )
+    {
+        count += gnss_stats.ttf_histogram[i];
+        if( count >= needed )
+        {
+            uint32_t window_s = (( i + 1 ) * APP_GNSS_TTF_BUCKET_MS + APP_GNSS_WINDOW_MARGIN_MS + 999 ) / 1000;
+            if( window_s < APP_GNSS_WINDOW_MIN_S ) window_s = APP_GNSS_WINDOW_MIN_S;
+            return window_s < max_s ? window_s : max_s;
+        }
+    }
+    return max_s;
+}
+
+void app_gnss_fix_get_stats( app_gnss_fix_stats_t* stats )
+{
+    *stats = gnss_stats;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
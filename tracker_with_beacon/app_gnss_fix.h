@@ -0,0 +1,185 @@
+#ifndef APP_GNSS_FIX_H
+#define APP_GNSS_FIX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Default fix quality: consecutive fixes within a radius
+ */
+#define APP_GNSS_FIX_STABLE_COUNT_DEFAULT   3
+#define APP_GNSS_FIX_STABLE_RADIUS_DEFAULT  25      // in m
+
+/*!
+ * @brief Time-to-fix histogram, APP_GNSS_TTF_BUCKET_MS wide buckets, the last one open ended
+ */
+#define APP_GNSS_TTF_BUCKET_MS  2000
+#define APP_GNSS_TTF_BUCKETS    32
+
+/*!
+ * @brief Adaptive scan window: the APP_GNSS_WINDOW_PERCENTILE time to fix plus a margin,
+ * once APP_GNSS_WINDOW_MIN_SAMPLES scans are known
+ */
+#define APP_GNSS_WINDOW_PERCENTILE      90
+#define APP_GNSS_WINDOW_MIN_SAMPLES     8
+#define APP_GNSS_WINDOW_MARGIN_MS       2000
+#define APP_GNSS_WINDOW_MIN_S           6
+
+/*!
+ * @brief Linker section kept over resets, not initialised at boot
+ */
+#define APP_GNSS_RETAINED_SECTION       ".non_init"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Time-to-fix statistics since boot
+ */
+typedef struct
+{
+    uint32_t attempts;                          // GNSS scans run
+    uint32_t fixes;                             // scans reaching a quality fix
+    uint32_t timeouts;                          // scans ended by the scan duration
+    uint32_t ttf_last_ms;                       // time to fix of the last quality fix
+    uint32_t ttf_min_ms;
+    uint32_t ttf_max_ms;
+    uint64_t ttf_sum_ms;
+    uint16_t ttf_histogram[APP_GNSS_TTF_BUCKETS];
+} app_gnss_fix_stats_t;
+
+/*!
+ * @brief Last fix, kept over warm resets
+ */
+typedef struct
+{
+    bool valid;
+    int32_t lat;                                // in 1e-6 degree
+    int32_t lon;                                // in 1e-6 degree
+    uint32_t gps_time_s;                        // GPS time of the fix, 0 if the clock was not synced
+} app_gnss_aiding_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Restore the last fix and the statistics kept in retained RAM
+ *
+ * Starts from scratch after a power loss, when the retained block is invalid.
+ *
+ * @returns true if the retained block was valid
+ */
+bool app_gnss_fix_init( void );
+
+/*!
+ * @brief Set the fix quality threshold
+ *
+ * A fix is good enough once stable_count consecutive polls report a fix, all
+ * within stable_radius_m of the previous one.
+ *
+ * @param [in] stable_count Consecutive fixes, 1 takes the first fix
+ * @param [in] stable_radius_m Largest move between two of them in m
+ */
+void app_gnss_fix_set_quality( uint8_t stable_count, uint16_t stable_radius_m );
+
+/*!
+ * @brief Start tracking a GNSS scan
+ *
+ * @param [in] now_ms Scan start time
+ */
+void app_gnss_fix_begin( uint32_t now_ms );
+
+/*!
+ * @brief Feed one poll of the receiver
+ *
+ * @param [in] now_ms Poll time
+ * @param [in] fix true if the receiver reports a fix
+ * @param [in] lat Latitude in 1e-6 degree, ignored without fix
+ * @param [in] lon Longitude in 1e-6 degree, ignored without fix
+ *
+ * @returns true once the fix meets the quality threshold
+ */
+bool app_gnss_fix_update( uint32_t now_ms, bool fix, int32_t lat, int32_t lon );
+
+/*!
+ * @brief Finish tracking a GNSS scan, counting a timeout if no quality fix was reached
+ */
+void app_gnss_fix_end( void );
+
+/*!
+ * @brief Stop tracking a GNSS scan cut short, counted as an attempt only if it reached a quality fix
+ */
+void app_gnss_fix_abort( void );
+
+/*!
+ * @brief Remember the last position, used to aid the next scans
+ *
+ * @param [in] lat Latitude in 1e-6 degree
+ * @param [in] lon Longitude in 1e-6 degree
+ * @param [in] gps_time_s GPS time of the fix, 0 if unknown
+ */
+void app_gnss_fix_set_position( int32_t lat, int32_t lon, uint32_t gps_time_s );
+
+/*!
+ * @brief Get the last fix
+ *
+ * @param [out] aiding Last fix, valid is false before the first fix
+ */
+void app_gnss_fix_get_aiding( app_gnss_aiding_t* aiding );
+
+/*!
+ * @brief Scan window learned from the time-to-fix distribution
+ *
+ * Covers APP_GNSS_WINDOW_PERCENTILE % of the past scans, timeouts counting as
+ * longer than any fix. The full max_s is used until enough scans are known and
+ * after a timeout, so a cold start always gets the whole window.
+ *
+ * @param [in] max_s Configured scan duration in s, the upper bound
+ *
+ * @returns Scan window in s
+ */
+uint32_t app_gnss_fix_window_s( uint32_t max_s );
+
+/*!
+ * @brief Distance between two positions
+ *
+ * @param [in] lat1 Latitude of the first position in 1e-6 degree
+ * @param [in] lon1 Longitude of the first position in 1e-6 degree
+ * @param [in] lat2 Latitude of the second position in 1e-6 degree
+ * @param [in] lon2 Longitude of the second position in 1e-6 degree
+ *
+ * @returns Distance in m
+ */
+float app_gnss_distance_m( int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2 );
+
+/*!
+ * @brief Get the time-to-fix statistics
+ *
+ * @param [out] stats Statistics
+ */
+void app_gnss_fix_get_stats( app_gnss_fix_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_GNSS_FIX_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,157 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_link_policy.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+// Demodulation floor in 0.25 dB: -20 dB at SF12, 2.5 dB more per lower spreading factor
+#define LINK_SNR_FLOOR_SF12     ( -80 )
+#define LINK_SNR_FLOOR_STEP     10
+#define LINK_SF_MIN             7
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static int16_t link_snr_floor( const app_link_policy_t* policy, uint8_t dr )
+{
+    int8_t sf = policy->sf_dr0 - dr;
+
+    if( sf < LINK_SF_MIN ) sf = LINK_SF_MIN;
+    return LINK_SNR_FLOOR_SF12 + LINK_SNR_FLOOR_STEP * ( 12 - sf );
+}
+
+/*!
+ * @brief Work out the list from the filtered SNR and the losses
+ *
+ * @returns true if the list or nb_trans changed
+ */
+static bool link_policy_update( app_link_policy_t* policy )
+{
+    uint8_t dr_low = policy->snr_valid ? policy->dr_min : policy->dr_start;
+    uint8_t steps = policy->losses / APP_LINK_LOSS_STEP;
+    uint8_t nb_trans = 1;
+
+    // Highest data rate keeping the margin, the join list as it is without a measure
+    for( uint8_t dr = policy->dr_min; policy->snr_valid && dr <= policy->dr_max; dr++ )
+    {
+        if( policy->snr >= link_snr_floor( policy, dr ) + APP_LINK_MARGIN_DB * 4 )
+        {
+            dr_low = dr;
+        }
+    }
+
+    // Lost frames step the data rate down first, then repeat the uplinks
+    while( steps > 0 && dr_low > policy->dr_min )
+    {
+        dr_low--;
+        steps--;
+    }
+    nb_trans += steps;
+    if( nb_trans > APP_LINK_NB_TRANS_MAX ) nb_trans = APP_LINK_NB_TRANS_MAX;
+
+    bool changed = ( policy->snr_valid && !policy->adapted ) || dr_low != policy->dr_low || nb_trans != policy->nb_trans;
+
+    // Only a measured SNR narrows the list, losses alone step the join list down
+    policy->adapted = policy->snr_valid;
+    policy->dr_low = dr_low;
+    policy->nb_trans = nb_trans;
+    return changed;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_link_adr_list( uint8_t dr_min, uint8_t dr_max, uint8_t* list )
+{
+    uint8_t dr_num = dr_max - dr_min + 1;
+    uint8_t num = APP_LINK_ADR_LIST_LEN / dr_num;
+    uint8_t remain = APP_LINK_ADR_LIST_LEN % dr_num;
+    uint8_t offset = 0;
+
+    // The lowest data rates take one entry more each when the range does not divide the list
+    for( uint8_t i = 0; i < dr_num; i++ )
+    {
+        for( uint8_t j = 0; j < num; j++ )
+        {
+            list[i * num + j + offset] = dr_min + i;
+        }
+
+        if( i < remain )
+        {
+            list[( i + 1 ) * num + offset] = dr_min + i;
+            offset += 1;
+        }
+    }
+}
+
+void app_link_policy_init( app_link_policy_t* policy, uint8_t dr_min, uint8_t dr_max, uint8_t sf_dr0,
+                           const uint8_t* list )
+{
+    memset( policy, 0, sizeof( *policy ));
+    policy->dr_min = dr_min;
+    policy->dr_max = dr_max;
+    policy->sf_dr0 = sf_dr0;
+    policy->dr_start = list[0];
+    policy->dr_top = list[APP_LINK_ADR_LIST_LEN - 1];
+    if( policy->dr_start < dr_min ) policy->dr_start = dr_min;
+    policy->dr_low = policy->dr_start;
+    policy->nb_trans = 1;
+}
+
+bool app_link_policy_downlink( app_link_policy_t* policy, int8_t snr )
+{
+    if( !policy->snr_valid )
+    {
+        policy->snr = snr;
+        policy->snr_valid = true;
+    }
+    else
+    {
+        // Filter weight 1/4, one faded downlink does not move the list
+        policy->snr += ( snr - policy->snr ) / 4;
+    }
+    return link_policy_update( policy );
+}
+
+bool app_link_policy_confirmed( app_link_policy_t* policy, bool acked )
+{
+    if( acked )
+    {
+        policy->losses = 0;
+    }
+    else if( policy->losses < UINT8_MAX )
+    {
+        policy->losses++;
+    }
+    return link_policy_update( policy );
+}
+
+bool app_link_policy_get_list( const app_link_policy_t* policy, uint8_t* list )
+{
+    if( policy->adapted )
+    {
+        uint8_t dr_high = policy->dr_low + APP_LINK_DR_SPREAD;
+        app_link_adr_list( policy->dr_low, dr_high < policy->dr_max ? dr_high : policy->dr_max, list );
+        return true;
+    }
+    if( policy->dr_low != policy->dr_start )
+    {
+        // Losses without a measure, the join list spread down to the lowest data rate reached
+        app_link_adr_list( policy->dr_low, policy->dr_top > policy->dr_low ? policy->dr_top : policy->dr_low, list );
+        return true;
+    }
+    return false;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
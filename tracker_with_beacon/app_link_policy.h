@@ -0,0 +1,136 @@
+#ifndef APP_LINK_POLICY_H
+#define APP_LINK_POLICY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Entries of a custom ADR list, the modem picks one at random per uplink
+ */
+#define APP_LINK_ADR_LIST_LEN       16
+
+/*!
+ * @brief SNR kept above the demodulation floor of the lowest data rate used
+ */
+#define APP_LINK_MARGIN_DB          10
+
+/*!
+ * @brief Data rates above the lowest one in the adapted list
+ */
+#define APP_LINK_DR_SPREAD          1
+
+/*!
+ * @brief Confirmed uplinks lost in a row that take the lowest data rate one step down
+ */
+#define APP_LINK_LOSS_STEP          2
+
+/*!
+ * @brief Most transmissions of an unconfirmed uplink
+ */
+#define APP_LINK_NB_TRANS_MAX       3
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Link policy state
+ */
+typedef struct
+{
+    uint8_t dr_min;                 // allowed data rates
+    uint8_t dr_max;
+    uint8_t sf_dr0;                 // spreading factor of DR0 in the region
+    uint8_t dr_start;               // lowest and highest data rates of the join list
+    uint8_t dr_top;
+    bool snr_valid;
+    int16_t snr;                    // filtered downlink SNR in 0.25 dB
+    uint8_t losses;                 // confirmed uplinks in a row without ack
+    bool adapted;                   // the SNR has been measured, the list follows it
+    uint8_t dr_low;                 // lowest data rate of the list
+    uint8_t nb_trans;
+} app_link_policy_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Spread a data rate range evenly over a custom ADR list, lowest first
+ *
+ * @param [in] dr_min Lowest data rate
+ * @param [in] dr_max Highest data rate, at least dr_min
+ * @param [out] list APP_LINK_ADR_LIST_LEN entries
+ */
+void app_link_adr_list( uint8_t dr_min, uint8_t dr_max, uint8_t* list );
+
+/*!
+ * @brief Initialise a link policy
+ *
+ * Until the first downlink SNR the list is the join list the caller keeps;
+ * lost confirmed uplinks only step its lowest data rate down, then raise
+ * nb_trans, which starts at 1.
+ *
+ * @param [out] policy Link policy
+ * @param [in] dr_min Lowest data rate allowed
+ * @param [in] dr_max Highest data rate allowed
+ * @param [in] sf_dr0 Spreading factor of DR0 in the region, DR n uses SF sf_dr0 - n down to SF7
+ * @param [in] list Join list, APP_LINK_ADR_LIST_LEN entries, lowest first
+ */
+void app_link_policy_init( app_link_policy_t* policy, uint8_t dr_min, uint8_t dr_max, uint8_t sf_dr0,
+                           const uint8_t* list );
+
+/*!
+ * @brief Feed the SNR of a received downlink
+ *
+ * @param [in,out] policy Link policy
+ * @param [in] snr SNR in 0.25 dB, as given by the modem
+ *
+ * @returns true if the list or nb_trans changed
+ */
+bool app_link_policy_downlink( app_link_policy_t* policy, int8_t snr );
+
+/*!
+ * @brief Feed the outcome of a confirmed uplink
+ *
+ * Unconfirmed uplinks tell nothing about the link and are not fed.
+ *
+ * @param [in,out] policy Link policy
+ * @param [in] acked true if the network acknowledged it
+ *
+ * @returns true if the list or nb_trans changed
+ */
+bool app_link_policy_confirmed( app_link_policy_t* policy, bool acked );
+
+/*!
+ * @brief Get the custom ADR list to apply
+ *
+ * @param [in] policy Link policy
+ * @param [out] list APP_LINK_ADR_LIST_LEN entries
+ *
+ * @returns false while the join list stands, the caller keeps it; nb_trans applies either way
+ */
+bool app_link_policy_get_list( const app_link_policy_t* policy, uint8_t* list );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_LINK_POLICY_H
+
+/* --- EOF ------------------------------------------------------------------ */
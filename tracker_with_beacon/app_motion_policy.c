@@ -0,0 +1,97 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_motion_policy.h"
+#include "app_gnss_fix.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_motion_policy_init( app_motion_policy_t* policy )
+{
+    memset( policy, 0, sizeof( *policy ));
+    policy->acc_threshold_mg = APP_MOTION_ACC_THRESHOLD_DEFAULT;
+    policy->speed_min_cm_s = APP_MOTION_SPEED_MIN_DEFAULT;
+    policy->distance_min_m = APP_MOTION_DISTANCE_MIN_DEFAULT;
+    policy->interval_max_s = APP_MOTION_INTERVAL_MAX_DEFAULT;
+    policy->moving = true;
+}
+
+bool app_motion_policy_acc_sample( app_motion_policy_t* policy, int16_t ax, int16_t ay, int16_t az )
+{
+    bool was_valid = policy->acc_valid;
+    uint32_t change = abs( ax - policy->acc[0] ) + abs( ay - policy->acc[1] ) + abs( az - policy->acc[2] );
+
+    policy->acc[0] = ax;
+    policy->acc[1] = ay;
+    policy->acc[2] = az;
+    policy->acc_valid = true;
+
+    // The first sample only sets the reference
+    if( !was_valid || change < policy->acc_threshold_mg )
+    {
+        return false;
+    }
+
+    policy->active = true;
+    if( policy->moving )
+    {
+        return false;
+    }
+    policy->moving = true;
+    return true;
+}
+
+void app_motion_policy_fix( app_motion_policy_t* policy, int32_t lat, int32_t lon, uint32_t time_s )
+{
+    if( policy->fix_valid && time_s > policy->fix_time_s )
+    {
+        float distance_m = app_gnss_distance_m( policy->fix_lat, policy->fix_lon, lat, lon );
+        float speed_cm_s = distance_m * 100 / ( time_s - policy->fix_time_s );
+
+        if( distance_m > policy->distance_min_m && speed_cm_s >= policy->speed_min_cm_s )
+        {
+            policy->active = true;
+        }
+    }
+    policy->fix_valid = true;
+    policy->fix_lat = lat;
+    policy->fix_lon = lon;
+    policy->fix_time_s = time_s;
+}
+
+uint32_t app_motion_policy_next_interval( app_motion_policy_t* policy, uint32_t base_s )
+{
+    uint32_t interval_s = base_s;
+
+    if( policy->active )
+    {
+        policy->moving = true;
+        policy->still_reports = 0;
+    }
+    else
+    {
+        policy->moving = false;
+        if( policy->still_reports < UINT8_MAX ) policy->still_reports++;
+
+        // Doubles on every report at rest, the ceiling also stops the shift from overflowing
+        for( uint8_t i = 0; i < policy->still_reports && interval_s < policy->interval_max_s; i++ )
+        {
+            interval_s *= 2;
+        }
+        if( interval_s > policy->interval_max_s && policy->interval_max_s > base_s )
+        {
+            interval_s = policy->interval_max_s;
+        }
+    }
+    policy->active = false;
+    return interval_s;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,131 @@
+#ifndef APP_MOTION_POLICY_H
+#define APP_MOTION_POLICY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Interval in s between two accelerometer checks
+ */
+#define APP_MOTION_SAMPLE_S                 30
+
+/*!
+ * @brief Default change of the acceleration vector between two checks that counts as activity
+ *
+ * Sum of the absolute changes on the three axes in mg, above the sensor noise
+ * and well below the tilt of an asset being picked up or driven.
+ */
+#define APP_MOTION_ACC_THRESHOLD_DEFAULT    150     // in mg
+
+/*!
+ * @brief Default speed between two fixes that counts as moving
+ */
+#define APP_MOTION_SPEED_MIN_DEFAULT        50      // in cm/s, about 1.8 km/h
+
+/*!
+ * @brief Default distance between two fixes below which the asset did not move
+ *
+ * Twice the GNSS stable radius, so the scatter of fixes at rest is not taken as speed.
+ */
+#define APP_MOTION_DISTANCE_MIN_DEFAULT     50      // in m
+
+/*!
+ * @brief Default longest reporting interval at rest
+ */
+#define APP_MOTION_INTERVAL_MAX_DEFAULT     21600   // in s
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Motion policy state
+ */
+typedef struct
+{
+    uint16_t acc_threshold_mg;      // activity threshold
+    uint16_t speed_min_cm_s;        // moving speed threshold
+    uint16_t distance_min_m;        // fix scatter at rest
+    uint32_t interval_max_s;        // back-off ceiling
+
+    bool moving;                    // state of the last report, or motion seen since
+    bool active;                    // accelerometer activity or speed seen since the last report
+    uint8_t still_reports;          // reports in a row at rest
+    bool acc_valid;
+    int16_t acc[3];                 // last accelerometer sample
+    bool fix_valid;
+    int32_t fix_lat, fix_lon;       // last fix, in 1e-6 degree
+    uint32_t fix_time_s;
+} app_motion_policy_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Initialise a motion policy with the default thresholds
+ *
+ * The asset starts as moving, so the first reports come at the base interval.
+ *
+ * @param [out] policy Motion policy
+ */
+void app_motion_policy_init( app_motion_policy_t* policy );
+
+/*!
+ * @brief Feed one accelerometer sample
+ *
+ * @param [in,out] policy Motion policy
+ * @param [in] ax Acceleration on x in mg
+ * @param [in] ay Acceleration on y in mg
+ * @param [in] az Acceleration on z in mg
+ *
+ * @returns true on the transition from rest to motion, the caller reports at once
+ */
+bool app_motion_policy_acc_sample( app_motion_policy_t* policy, int16_t ax, int16_t ay, int16_t az );
+
+/*!
+ * @brief Feed one GNSS fix, the speed from the previous fix counts as activity
+ *
+ * @param [in,out] policy Motion policy
+ * @param [in] lat Latitude in 1e-6 degree
+ * @param [in] lon Longitude in 1e-6 degree
+ * @param [in] time_s Fix time on a monotonic clock
+ */
+void app_motion_policy_fix( app_motion_policy_t* policy, int32_t lat, int32_t lon, uint32_t time_s );
+
+/*!
+ * @brief Close a report and get the interval to the next one
+ *
+ * A report with activity since the previous one is a moving report and keeps the
+ * base interval. Every report at rest in a row doubles the interval, up to
+ * interval_max_s.
+ *
+ * @param [in,out] policy Motion policy
+ * @param [in] base_s Reporting interval while moving in s
+ *
+ * @returns Interval to the next report in s, at least base_s
+ */
+uint32_t app_motion_policy_next_interval( app_motion_policy_t* policy, uint32_t base_s );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_MOTION_POLICY_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,86 @@
+#include "app_radio_coex.h"
+#include "app_ble_beacon.h"
+#include "smtc_hal.h"
+
+// Currently open windows and the subset that pauses the beacon
+static uint8_t open_mask = 0;
+static uint8_t suspend_mask = APP_RADIO_COEX_DEFAULT_SUSPEND_MASK;
+
+static uint32_t window_open_ms[APP_RADIO_COEX_WINDOW_NUM];
+
+static bool beacon_paused = false;
+static uint32_t beacon_paused_ms = 0;
+
+static void coex_evaluate(uint32_t now_ms);
+
+void app_radio_coex_init(void)
+{
+    open_mask = 0;
+    suspend_mask = APP_RADIO_COEX_DEFAULT_SUSPEND_MASK;
+    beacon_paused = false;
+
+    HAL_DBG_TRACE_INFO("Radio coexistence scheduler initialized\n");
+}
+
+void app_radio_coex_set_suspend_mask(uint8_t mask)
+{
+    suspend_mask = mask;
+    coex_evaluate(hal_rtc_get_time_ms());
+}
+
+void app_radio_coex_window_open(app_radio_coex_window_t window)
+{
+    uint8_t bit = APP_RADIO_COEX_MASK(window);
+
+    if (window >= APP_RADIO_COEX_WINDOW_NUM || (open_mask & bit)) {
+        return;
+    }
+
+    uint32_t now_ms = hal_rtc_get_time_ms();
+    window_open_ms[window] = now_ms;
+    open_mask |= bit;
+    coex_evaluate(now_ms);
+}
+
+void app_radio_coex_window_close(app_radio_coex_window_t window)
+{
+    uint8_t bit = APP_RADIO_COEX_MASK(window);
+
+    if (window >= APP_RADIO_COEX_WINDOW_NUM || !(open_mask & bit)) {
+        return;
+    }
+
+    uint32_t now_ms = hal_rtc_get_time_ms();
+
+    if (window == APP_RADIO_COEX_LORA_UPLINK) {
+        // Only the part of the uplink during which the beacon was paused costs air time
+        uint32_t off_ms = 0;
+        if (beacon_paused) {
+            uint32_t from_ms = window_open_ms[window];
+            if ((int32_t)(beacon_paused_ms - from_ms) > 0) {
+                from_ms = beacon_paused_ms;
+            }
+            off_ms = now_ms - from_ms;
+        }
+
+        HAL_DBG_TRACE_INFO("iBeacon off %u ms for uplink (~%u adv events)\n",
+                           off_ms, off_ms / APP_BLE_BEACON_ADV_INTERVAL_MS);
+    }
+
+    open_mask &= ~bit;
+    coex_evaluate(now_ms);
+}
+
+static void coex_evaluate(uint32_t now_ms)
+{
+    bool pause = (open_mask & suspend_mask) != 0;
+
+    if (pause && !beacon_paused) {
+        beacon_paused = true;
+        beacon_paused_ms = now_ms;
+        app_ble_beacon_suspend();
+    } else if (!pause && beacon_paused) {
+        beacon_paused = false;
+        app_ble_beacon_resume();
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef __APP_RADIO_COEX_H__
+#define __APP_RADIO_COEX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Radio activity windows known to the coexistence scheduler
+ */
+typedef enum {
+    APP_RADIO_COEX_LORA_UPLINK = 0,     // LR1110 uplink, from request until TX done
+    APP_RADIO_COEX_WIFI_SCAN,           // LR1110 Wi-Fi scan
+    APP_RADIO_COEX_GNSS_SCAN,           // LR1110 GNSS scan
+    APP_RADIO_COEX_BLE_SCAN,            // nRF52840 BLE scan
+    APP_RADIO_COEX_WINDOW_NUM
+} app_radio_coex_window_t;
+
+#define APP_RADIO_COEX_MASK(window)     (1u << (window))
+
+// Every window, the range of a suspend mask
+#define APP_RADIO_COEX_ALL_MASK         ((1u << APP_RADIO_COEX_WINDOW_NUM) - 1)
+
+// Windows that pause the beacon by default: LoRa TX peak current and BLE scan radio time
+#define APP_RADIO_COEX_DEFAULT_SUSPEND_MASK \
+    (APP_RADIO_COEX_MASK(APP_RADIO_COEX_LORA_UPLINK) | APP_RADIO_COEX_MASK(APP_RADIO_COEX_BLE_SCAN))
+
+/**
+ * @brief Initialize the radio coexistence scheduler
+ */
+void app_radio_coex_init(void);
+
+/**
+ * @brief Select which windows pause the iBeacon
+ *
+ * @param mask Bitmask of APP_RADIO_COEX_MASK(window) values
+ */
+void app_radio_coex_set_suspend_mask(uint8_t mask);
+
+/**
+ * @brief Signal the start of a radio activity window
+ *
+ * The beacon is paused when the first window of the suspend mask opens.
+ *
+ * @param window Window being opened
+ */
+void app_radio_coex_window_open(app_radio_coex_window_t window);
+
+/**
+ * @brief Signal the end of a radio activity window
+ *
+ * The beacon resumes with its existing configuration once no window of the
+ * suspend mask is open anymore. Closing a window that is not open is ignored.
+ *
+ * @param window Window being closed
+ */
+void app_radio_coex_window_close(app_radio_coex_window_t window);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __APP_RADIO_COEX_H__ */
@@ -0,0 +1,72 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include "app_report_slot.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+/*!
+ * @brief Xorshift32, enough to decorrelate devices
+ */
+static uint32_t report_slot_random( app_report_slot_t* slot )
+{
+    uint32_t x = slot->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    slot->rng = x;
+    return x;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_report_slot_init( app_report_slot_t* slot, const uint8_t* dev_eui )
+{
+    // FNV-1a, consecutive DevEUIs of a batch land far apart
+    uint32_t hash = 2166136261u;
+
+    for( uint8_t i = 0; i < APP_REPORT_SLOT_EUI_LEN; i++ )
+    {
+        hash = ( hash ^ dev_eui[i] ) * 16777619u;
+    }
+    slot->phase = hash;
+    slot->rng = hash ? hash : 1;
+}
+
+uint32_t app_report_slot_delay( app_report_slot_t* slot, uint32_t gps_time_s, uint32_t interval_s,
+                                uint32_t fallback_s )
+{
+    uint32_t delay = fallback_s;
+    uint32_t jitter_max = interval_s * APP_REPORT_SLOT_JITTER_PCT / 100;
+
+    if( jitter_max > APP_REPORT_SLOT_JITTER_MAX_S ) jitter_max = APP_REPORT_SLOT_JITTER_MAX_S;
+
+    if( gps_time_s != 0 && interval_s != 0 )
+    {
+        // Next time the GPS time modulo the interval is the phase
+        uint32_t offset = slot->phase % interval_s;
+        uint32_t now = gps_time_s % interval_s;
+
+        delay = offset >= now ? offset - now : interval_s - now + offset;
+        if( delay <= jitter_max )
+        {
+            // Too close to the report just sent, the slot after is used
+            delay += interval_s;
+        }
+    }
+    if( jitter_max > 0 )
+    {
+        delay += report_slot_random( slot ) % jitter_max;
+    }
+    return delay > 0 ? delay : 1;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
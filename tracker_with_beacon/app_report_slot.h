@@ -0,0 +1,84 @@
+#ifndef APP_REPORT_SLOT_H
+#define APP_REPORT_SLOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Length of a DevEUI
+ */
+#define APP_REPORT_SLOT_EUI_LEN         8
+
+/*!
+ * @brief Jitter added to a slot: a share of the interval, bounded
+ */
+#define APP_REPORT_SLOT_JITTER_PCT      5
+#define APP_REPORT_SLOT_JITTER_MAX_S    30
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Reporting slot of a device
+ */
+typedef struct
+{
+    uint32_t phase;                 // hash of the DevEUI, the slot is phase modulo the interval
+    uint32_t rng;                   // jitter generator state, never 0
+} app_report_slot_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Initialise the slot of a device
+ *
+ * @param [out] slot Reporting slot
+ * @param [in] dev_eui DevEUI, APP_REPORT_SLOT_EUI_LEN bytes
+ */
+void app_report_slot_init( app_report_slot_t* slot, const uint8_t* dev_eui );
+
+/*!
+ * @brief Delay to the next report
+ *
+ * With a GPS time, the reports of a device start at the times where GPS time
+ * modulo the interval is its phase, so devices sharing an interval spread over
+ * it whenever they were powered on. Without one, the fallback delay is kept.
+ * A random jitter below APP_REPORT_SLOT_JITTER_PCT % of the interval, and below
+ * APP_REPORT_SLOT_JITTER_MAX_S, is added either way; it does not build up from
+ * one report to the next.
+ *
+ * @param [in,out] slot Reporting slot
+ * @param [in] gps_time_s Current GPS time, 0 while the clock is not synced
+ * @param [in] interval_s Reporting interval
+ * @param [in] fallback_s Delay to use without a GPS time
+ *
+ * @returns Delay in s, at least 1
+ */
+uint32_t app_report_slot_delay( app_report_slot_t* slot, uint32_t gps_time_s, uint32_t interval_s,
+                                uint32_t fallback_s );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_REPORT_SLOT_H
+
+/* --- EOF ------------------------------------------------------------------ */
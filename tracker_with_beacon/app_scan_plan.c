@@ -0,0 +1,286 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stddef.h>
+
+#include "app_scan_plan.h"
+#include "main_lorawan_tracker.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define STAGE( tech )           { APP_SCAN_TECH_##tech, true, false }
+#define STAGE_WITH_NEXT( tech ) { APP_SCAN_TECH_##tech, true, true }
+
+/*!
+ * @brief Scan plans, indexed by TRACKER_SCAN_* type
+ *
+ * Every stage ends the run when it has a result, the last one ends it anyway.
+ */
+static const app_scan_plan_t scan_plans[] = {
+    [TRACKER_SCAN_GNSS_ONLY]        = { 1, { STAGE( GNSS ) } },
+    [TRACKER_SCAN_WIFI_ONLY]        = { 1, { STAGE( WIFI ) } },
+    [TRACKER_SCAN_WIFI_GNSS]        = { 2, { STAGE( WIFI ), STAGE( GNSS ) } },
+    [TRACKER_SCAN_GNSS_WIFI]        = { 2, { STAGE( GNSS ), STAGE( WIFI ) } },
+    [TRACKER_SCAN_BLE_ONLY]         = { 1, { STAGE( BLE ) } },
+    [TRACKER_SCAN_BLE_WIFI]         = { 2, { STAGE( BLE ), STAGE( WIFI ) } },
+    [TRACKER_SCAN_BLE_GNSS]         = { 2, { STAGE( BLE ), STAGE( GNSS ) } },
+    [TRACKER_SCAN_BLE_WIFI_GNSS]    = { 3, { STAGE( BLE ), STAGE( WIFI ), STAGE( GNSS ) } },
+};
+
+/*!
+ * @brief Plans replacing the serial ones when BLE and Wi-Fi scan concurrently
+ */
+static const app_scan_plan_t scan_plans_concurrent[] = {
+    [TRACKER_SCAN_BLE_WIFI]         = { 2, { STAGE_WITH_NEXT( BLE ), STAGE( WIFI ) } },
+    [TRACKER_SCAN_BLE_WIFI_GNSS]    = { 3, { STAGE_WITH_NEXT( BLE ), STAGE( WIFI ), STAGE( GNSS ) } },
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static bool scan_concurrent = APP_SCAN_PLAN_CONCURRENT_DEFAULT;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+/*!
+ * @brief Index of the last stage of the group starting at stage
+ */
+static uint8_t scan_plan_group_last( const app_scan_plan_t* plan, uint8_t stage )
+{
+    while( plan->stages[stage].with_next && stage + 1 < plan->stage_num )
+    {
+        stage++;
+    }
+    return stage;
+}
+
+/*!
+ * @brief Longest scan duration of the group from stage to last
+ */
+static uint32_t scan_plan_group_duration( const app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan,
+                                          uint8_t stage, uint8_t last )
+{
+    uint32_t duration = 0;
+
+    for( uint8_t i = stage; i <= last; i++ )
+    {
+        uint32_t d = ctx->ops->scan_duration( plan->stages[i].tech );
+        if( d > duration ) duration = d;
+    }
+    return duration;
+}
+
+/*!
+ * @brief Interval of the readiness checks of the group from stage to last, 0 if it cannot end early
+ */
+static uint32_t scan_plan_group_poll( const app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan,
+                                      uint8_t stage, uint8_t last )
+{
+    uint32_t poll = 0;
+
+    if( ctx->ops->scan_ready == NULL )
+    {
+        return 0;
+    }
+    for( uint8_t i = stage; i <= last; i++ )
+    {
+        uint32_t p = ctx->ops->scan_poll_s != NULL ? ctx->ops->scan_poll_s( plan->stages[i].tech )
+                                                   : APP_SCAN_PLAN_POLL_S;
+        // Every scan must be ready, one that is never checked holds the group to its duration
+        if( p == 0 ) return 0;
+        if( poll == 0 || p < poll ) poll = p;
+    }
+    return poll;
+}
+
+/*!
+ * @brief Arm the alarm for the rest of the group, or the next readiness check
+ */
+static void scan_plan_group_alarm( app_scan_plan_ctx_t* ctx, uint32_t remaining_s, uint32_t poll_s )
+{
+    if( poll_s != 0 && remaining_s > poll_s )
+    {
+        remaining_s = poll_s;
+    }
+    ctx->ops->alarm_start( remaining_s > 0 ? remaining_s : 1 );
+}
+
+static void scan_plan_group_begin( app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan, uint8_t stage )
+{
+    uint8_t last = scan_plan_group_last( plan, stage );
+
+    scan_plan_group_alarm( ctx, scan_plan_group_duration( ctx, plan, stage, last ),
+                           scan_plan_group_poll( ctx, plan, stage, last ));
+    ctx->group_begin_s = ctx->ops->time_s( );
+    for( uint8_t i = stage; i <= last; i++ )
+    {
+        ctx->ops->scan_begin( plan->stages[i].tech );
+    }
+    ctx->status = stage + 1;
+}
+
+/*!
+ * @brief Check whether every scan of the group has enough results
+ */
+static bool scan_plan_group_ready( const app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan,
+                                   uint8_t stage, uint8_t last )
+{
+    for( uint8_t i = stage; i <= last; i++ )
+    {
+        if( !ctx->ops->scan_ready( plan->stages[i].tech ))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+const app_scan_plan_t* app_scan_plan_get( uint8_t scan_type )
+{
+    if( scan_type >= sizeof( scan_plans ) / sizeof( scan_plans[0] ))
+    {
+        return NULL;
+    }
+    if( scan_concurrent && scan_type < sizeof( scan_plans_concurrent ) / sizeof( scan_plans_concurrent[0] )
+        && scan_plans_concurrent[scan_type].stage_num )
+    {
+        return &scan_plans_concurrent[scan_type];
+    }
+    return &scan_plans[scan_type];
+}
+
+void app_scan_plan_set_concurrent( bool enable )
+{
+    scan_concurrent = enable;
+}
+
+void app_scan_plan_init( app_scan_plan_ctx_t* ctx, const app_scan_plan_ops_t* ops )
+{
+    ctx->ops = ops;
+    ctx->status = APP_SCAN_PLAN_IDLE;
+    ctx->begin_s = 0;
+    ctx->group_begin_s = 0;
+}
+
+bool app_scan_plan_step( app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan )
+{
+    if( ctx->status == APP_SCAN_PLAN_DONE )
+    {
+        return true;
+    }
+
+    if( plan == NULL || plan->stage_num == 0 )
+    {
+        ctx->begin_s = ctx->ops->time_s( );
+        ctx->status = APP_SCAN_PLAN_DONE;
+        return true;
+    }
+
+    if( ctx->status == APP_SCAN_PLAN_IDLE )
+    {
+        ctx->begin_s = ctx->ops->time_s( );
+        scan_plan_group_begin( ctx, plan, 0 );
+        return false;
+    }
+
+    uint8_t first = ctx->status - 1;
+    uint8_t last = scan_plan_group_last( plan, first );
+
+    // The configured durations stay the upper bound, readiness only ends a group earlier
+    uint32_t poll = scan_plan_group_poll( ctx, plan, first, last );
+
+    if( poll != 0 )
+    {
+        uint32_t duration = scan_plan_group_duration( ctx, plan, first, last );
+        uint32_t elapsed = ctx->ops->time_s( ) - ctx->group_begin_s;
+
+        if( elapsed < duration && !scan_plan_group_ready( ctx, plan, first, last ))
+        {
+            scan_plan_group_alarm( ctx, duration - elapsed, poll );
+            return false;
+        }
+    }
+
+    // Every scan of the group is ended, results of all of them are kept
+    bool result = false;
+
+    for( uint8_t i = first; i <= last; i++ )
+    {
+        result |= ctx->ops->scan_end( plan->stages[i].tech );
+    }
+
+    if(( result && plan->stages[last].stop_on_success ) || last + 1 >= plan->stage_num )
+    {
+        ctx->status = APP_SCAN_PLAN_DONE;
+        return true;
+    }
+
+    scan_plan_group_begin( ctx, plan, last + 1 );
+    return false;
+}
+
+uint32_t app_scan_plan_finish( app_scan_plan_ctx_t* ctx, uint32_t period_s )
+{
+    int32_t next_delay = period_s - ( ctx->ops->time_s( ) - ctx->begin_s );
+
+    ctx->status = APP_SCAN_PLAN_IDLE;
+    return next_delay > 0 ? next_delay : 1;
+}
+
+void app_scan_plan_abort( app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan )
+{
+    if( ctx->status != APP_SCAN_PLAN_IDLE && ctx->status != APP_SCAN_PLAN_DONE && plan != NULL )
+    {
+        uint8_t first = ctx->status - 1;
+        uint8_t last = scan_plan_group_last( plan, first );
+
+        for( uint8_t i = first; i <= last; i++ )
+        {
+            if( ctx->ops->scan_abort != NULL )
+            {
+                ctx->ops->scan_abort( plan->stages[i].tech );
+            }
+            else
+            {
+                ctx->ops->scan_end( plan->stages[i].tech );
+            }
+        }
+    }
+    ctx->status = APP_SCAN_PLAN_IDLE;
+}
+
+bool app_scan_plan_is_busy( const app_scan_plan_ctx_t* ctx )
+{
+    return ctx->status != APP_SCAN_PLAN_IDLE;
+}
+
+uint32_t app_scan_plan_worst_case_s( const app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan )
+{
+    uint32_t total = 0;
+    uint8_t stage = 0;
+
+    while( stage < plan->stage_num )
+    {
+        uint8_t last = scan_plan_group_last( plan, stage );
+
+        total += scan_plan_group_duration( ctx, plan, stage, last );
+        stage = last + 1;
+    }
+    return total;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
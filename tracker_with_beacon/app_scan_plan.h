@@ -0,0 +1,208 @@
+#ifndef APP_SCAN_PLAN_H
+#define APP_SCAN_PLAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Maximum number of stages in a scan plan
+ */
+#define APP_SCAN_PLAN_STAGE_MAX 3
+
+/*!
+ * @brief Scan plan run status
+ */
+#define APP_SCAN_PLAN_IDLE      0x00    // no run in progress, 1..APP_SCAN_PLAN_STAGE_MAX is the running stage
+#define APP_SCAN_PLAN_DONE      0xff    // all stages ended, results pending
+
+/*!
+ * @brief Run the BLE and Wi-Fi stages one after the other by default
+ *
+ * BLE scans on the nRF52840 radio and Wi-Fi on the LR1110, so both can run
+ * together; it shortens the run but adds up both receive currents, so it is
+ * left to the device configuration.
+ */
+#define APP_SCAN_PLAN_CONCURRENT_DEFAULT false
+
+/*!
+ * @brief Interval in s at which running scans are checked for enough results, unless scan_poll_s says otherwise
+ */
+#define APP_SCAN_PLAN_POLL_S    1
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Scan technologies
+ */
+typedef enum
+{
+    APP_SCAN_TECH_GNSS = 0,
+    APP_SCAN_TECH_WIFI,
+    APP_SCAN_TECH_BLE,
+    APP_SCAN_TECH_NUM
+} app_scan_tech_t;
+
+/*!
+ * @brief One stage of a scan plan
+ */
+typedef struct
+{
+    uint8_t tech;                   // @ref app_scan_tech_t
+    bool stop_on_success;           // skip the remaining stages when this one has a result
+    bool with_next;                 // run at the same time as the next stage
+} app_scan_stage_t;
+
+/*!
+ * @brief Ordered list of scan stages
+ *
+ * Stages chained with with_next form a group: they begin together, the alarm
+ * covers the longest of them, they end together and the group has a result if
+ * any of them has one. The stop_on_success rule of the last stage of the group
+ * applies.
+ */
+typedef struct
+{
+    uint8_t stage_num;
+    app_scan_stage_t stages[APP_SCAN_PLAN_STAGE_MAX];
+} app_scan_plan_t;
+
+/*!
+ * @brief Hardware hooks of the scan plan engine
+ */
+typedef struct
+{
+    void ( *scan_begin )( uint8_t tech );               // start a scan
+    bool ( *scan_end )( uint8_t tech );                 // stop a scan, true if it produced a result
+    void ( *scan_abort )( uint8_t tech );               // stop a scan and drop it, NULL to use scan_end
+    bool ( *scan_ready )( uint8_t tech );               // true once a scan has enough results, NULL to always
+                                                        // run scans for their full duration
+    uint32_t ( *scan_poll_s )( uint8_t tech );          // interval of the scan_ready checks, 0 to never check
+                                                        // the scan, NULL for APP_SCAN_PLAN_POLL_S
+    uint32_t ( *scan_duration )( uint8_t tech );        // configured scan duration in s
+    void ( *alarm_start )( uint32_t delay_s );          // arm the next step
+    uint32_t ( *time_s )( void );                       // current time in s
+} app_scan_plan_ops_t;
+
+/*!
+ * @brief State of a scan plan run
+ */
+typedef struct
+{
+    const app_scan_plan_ops_t* ops;
+    uint8_t status;                 // APP_SCAN_PLAN_IDLE, first running stage + 1 or APP_SCAN_PLAN_DONE
+    uint32_t begin_s;               // time the run started
+    uint32_t group_begin_s;         // time the running stage group started
+} app_scan_plan_ctx_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Get the scan plan of a tracker scan type
+ *
+ * @param [in] scan_type TRACKER_SCAN_* value
+ *
+ * @returns Scan plan, NULL if the type is unknown
+ */
+const app_scan_plan_t* app_scan_plan_get( uint8_t scan_type );
+
+/*!
+ * @brief Select concurrent or serial BLE and Wi-Fi scanning
+ *
+ * Applies to TRACKER_SCAN_BLE_WIFI and TRACKER_SCAN_BLE_WIFI_GNSS from the next run.
+ *
+ * @param [in] enable true to scan BLE and Wi-Fi at the same time
+ */
+void app_scan_plan_set_concurrent( bool enable );
+
+/*!
+ * @brief Initialise a scan plan run context
+ *
+ * @param [out] ctx Run context
+ * @param [in] ops Hardware hooks
+ */
+void app_scan_plan_init( app_scan_plan_ctx_t* ctx, const app_scan_plan_ops_t* ops );
+
+/*!
+ * @brief Advance a scan plan, to be called on every alarm
+ *
+ * Starts the first stage group when idle, otherwise ends the running group and
+ * either starts the next one or marks the run done. A group ends once its
+ * longest duration has elapsed, or earlier when scan_ready reports every scan
+ * of the group ready; it is then checked at the shortest scan_poll_s of the
+ * group. A group holding a scan that is never checked runs its full duration.
+ *
+ * @param [in,out] ctx Run context
+ * @param [in] plan Scan plan
+ *
+ * @returns true while the run is done and its results are pending
+ */
+bool app_scan_plan_step( app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan );
+
+/*!
+ * @brief Close a done run once its results are sent
+ *
+ * @param [in,out] ctx Run context
+ * @param [in] period_s Reporting period in s
+ *
+ * @returns Delay to the next run in s, the rest of the period measured from the
+ *          real start of the run, at least 1
+ */
+uint32_t app_scan_plan_finish( app_scan_plan_ctx_t* ctx, uint32_t period_s );
+
+/*!
+ * @brief Stop a run at once, whatever its state
+ *
+ * The running scans are aborted and the run goes back to idle. Results of the
+ * stages already ended stay with the caller, the alarm armed by the run is
+ * left to it.
+ *
+ * @param [in,out] ctx Run context
+ * @param [in] plan Scan plan of the run
+ */
+void app_scan_plan_abort( app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan );
+
+/*!
+ * @brief Check whether a run is in progress or has results pending
+ *
+ * @param [in] ctx Run context
+ *
+ * @returns true if the run is not idle
+ */
+bool app_scan_plan_is_busy( const app_scan_plan_ctx_t* ctx );
+
+/*!
+ * @brief Longest time a plan can take, every stage running to its full duration
+ *
+ * @param [in] ctx Run context, for the configured durations
+ * @param [in] plan Scan plan
+ *
+ * @returns Worst case duration in s
+ */
+uint32_t app_scan_plan_worst_case_s( const app_scan_plan_ctx_t* ctx, const app_scan_plan_t* plan );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_SCAN_PLAN_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,114 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_scan_topk.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static int8_t entry_rssi( const uint8_t* entry )
+{
+    return ( int8_t )entry[APP_SCAN_ENTRY_RSSI];
+}
+
+/*!
+ * @brief Move the entry at index towards the front until the order is restored
+ */
+static void topk_sift_up( app_scan_topk_t* topk, uint8_t index )
+{
+    uint8_t entry[APP_SCAN_ENTRY_LEN];
+
+    memcpy( entry, topk->entries[index], APP_SCAN_ENTRY_LEN );
+    while( index > 0 && entry_rssi( topk->entries[index - 1] ) < entry_rssi( entry ))
+    {
+        memcpy( topk->entries[index], topk->entries[index - 1], APP_SCAN_ENTRY_LEN );
+        index--;
+    }
+    memcpy( topk->entries[index], entry, APP_SCAN_ENTRY_LEN );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_scan_topk_init( app_scan_topk_t* topk, uint8_t k )
+{
+    topk->k = k < APP_SCAN_TOPK_MAX ? k : APP_SCAN_TOPK_MAX;
+    topk->count = 0;
+}
+
+void app_scan_topk_add( app_scan_topk_t* topk, const uint8_t* entry )
+{
+    uint8_t i;
+
+    if( topk->k == 0 )
+    {
+        return;
+    }
+
+    for( i = 0; i < topk->count; i++ )
+    {
+        if( memcmp( topk->entries[i], entry, APP_SCAN_ENTRY_RSSI ) == 0 )
+        {
+            // Same MAC heard again, only a stronger RSSI changes the order
+            if( entry_rssi( entry ) > entry_rssi( topk->entries[i] ))
+            {
+                topk->entries[i][APP_SCAN_ENTRY_RSSI] = entry[APP_SCAN_ENTRY_RSSI];
+                topk_sift_up( topk, i );
+            }
+            return;
+        }
+    }
+
+    if( topk->count < topk->k )
+    {
+        i = topk->count++;
+    }
+    else if( entry_rssi( entry ) > entry_rssi( topk->entries[topk->count - 1] ))
+    {
+        i = topk->count - 1;
+    }
+    else
+    {
+        return;
+    }
+
+    memcpy( topk->entries[i], entry, APP_SCAN_ENTRY_LEN );
+    topk_sift_up( topk, i );
+}
+
+void app_scan_topk_add_all( app_scan_topk_t* topk, const uint8_t* data, uint8_t len )
+{
+    for( uint8_t i = 0; i + APP_SCAN_ENTRY_LEN <= len; i += APP_SCAN_ENTRY_LEN )
+    {
+        app_scan_topk_add( topk, &data[i] );
+    }
+}
+
+uint8_t app_scan_topk_count_above( const app_scan_topk_t* topk, int8_t rssi_min )
+{
+    uint8_t count = 0;
+
+    // Sorted, so the first entry below the threshold ends the count
+    while( count < topk->count && entry_rssi( topk->entries[count] ) >= rssi_min )
+    {
+        count++;
+    }
+    return count;
+}
+
+uint8_t app_scan_topk_get( const app_scan_topk_t* topk, uint8_t* buffer )
+{
+    uint8_t len = topk->count * APP_SCAN_ENTRY_LEN;
+
+    memcpy( buffer, topk->entries, len );
+    return len;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
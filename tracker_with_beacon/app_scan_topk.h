@@ -0,0 +1,105 @@
+#ifndef APP_SCAN_TOPK_H
+#define APP_SCAN_TOPK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Scan result entry: MAC address (6 bytes) then RSSI (1 byte, signed)
+ */
+#define APP_SCAN_ENTRY_LEN      7
+#define APP_SCAN_ENTRY_RSSI     6
+
+/*!
+ * @brief Most entries a selector keeps, as many as fit the 64 byte scan buffers
+ */
+#define APP_SCAN_TOPK_MAX       9
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Strongest-K selector, entries kept sorted by decreasing RSSI
+ */
+typedef struct
+{
+    uint8_t k;
+    uint8_t count;
+    uint8_t entries[APP_SCAN_TOPK_MAX][APP_SCAN_ENTRY_LEN];
+} app_scan_topk_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Clear a selector
+ *
+ * @param [out] topk Selector
+ * @param [in] k Number of entries to keep, capped to APP_SCAN_TOPK_MAX
+ */
+void app_scan_topk_init( app_scan_topk_t* topk, uint8_t k );
+
+/*!
+ * @brief Offer one scan result
+ *
+ * A MAC address already kept is merged, keeping its strongest RSSI. Otherwise
+ * the entry is kept if there is room or if it beats the weakest one kept.
+ *
+ * @param [in,out] topk Selector
+ * @param [in] entry Scan result entry, APP_SCAN_ENTRY_LEN bytes
+ */
+void app_scan_topk_add( app_scan_topk_t* topk, const uint8_t* entry );
+
+/*!
+ * @brief Offer a buffer of scan results
+ *
+ * @param [in,out] topk Selector
+ * @param [in] data Scan result entries
+ * @param [in] len Length of data, a trailing partial entry is ignored
+ */
+void app_scan_topk_add_all( app_scan_topk_t* topk, const uint8_t* data, uint8_t len );
+
+/*!
+ * @brief Count the entries kept at or above an RSSI
+ *
+ * @param [in] topk Selector
+ * @param [in] rssi_min RSSI in dBm
+ *
+ * @returns Number of entries
+ */
+uint8_t app_scan_topk_count_above( const app_scan_topk_t* topk, int8_t rssi_min );
+
+/*!
+ * @brief Copy the entries kept, strongest first
+ *
+ * @param [in] topk Selector
+ * @param [out] buffer Output, at least k * APP_SCAN_ENTRY_LEN bytes
+ *
+ * @returns Number of bytes written
+ */
+uint8_t app_scan_topk_get( const app_scan_topk_t* topk, uint8_t* buffer );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_SCAN_TOPK_H
+
+/* --- EOF ------------------------------------------------------------------ */
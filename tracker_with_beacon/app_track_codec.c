@@ -0,0 +1,215 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stddef.h>
+
+#include "app_track_codec.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint32_t track_zigzag( int32_t value )
+{
+    return (( uint32_t )value << 1 ) ^ ( uint32_t )( value >> 31 );
+}
+
+static int32_t track_unzigzag( uint32_t value )
+{
+    return ( int32_t )( value >> 1 ) ^ -( int32_t )( value & 1 );
+}
+
+/*!
+ * @brief Write a varint, 7 bits per byte, low bits first
+ *
+ * @returns Bytes written, 0 if buf is too small
+ */
+static uint8_t track_varint_put( uint32_t value, uint8_t* buf, uint8_t size )
+{
+    uint8_t len = 0;
+
+    do
+    {
+        if( len >= size )
+        {
+            return 0;
+        }
+        buf[len++] = ( value & 0x7f ) | ( value > 0x7f ? 0x80 : 0 );
+        value >>= 7;
+    } while( value );
+    return len;
+}
+
+/*!
+ * @brief Read a varint
+ *
+ * @returns Bytes read, 0 if it is truncated or longer than 32 bits
+ */
+static uint8_t track_varint_get( const uint8_t* buf, uint8_t len, uint32_t* value )
+{
+    *value = 0;
+    for( uint8_t i = 0; i < len && i < 5; i++ )
+    {
+        *value |= ( uint32_t )( buf[i] & 0x7f ) << ( 7 * i );
+        if(( buf[i] & 0x80 ) == 0 )
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void track_put32( int32_t value, uint8_t* buf )
+{
+    buf[0] = ( uint32_t )value >> 24;
+    buf[1] = ( uint32_t )value >> 16;
+    buf[2] = ( uint32_t )value >> 8;
+    buf[3] = ( uint32_t )value;
+}
+
+static int32_t track_get32( const uint8_t* buf )
+{
+    return ( int32_t )(( uint32_t )buf[0] << 24 | ( uint32_t )buf[1] << 16 | ( uint32_t )buf[2] << 8 | buf[3] );
+}
+
+/*!
+ * @brief Delta in quantisation steps, rounded to the nearest
+ */
+static int32_t track_quantise( int32_t to, int32_t from, uint32_t quant )
+{
+    int64_t delta = ( int64_t )to - from;
+    int64_t half = quant / 2;
+
+    return ( int32_t )( delta >= 0 ? ( delta + half ) / quant : -(( half - delta ) / quant ));
+}
+
+static uint8_t track_encode_key( app_track_codec_t* codec, int32_t lat, int32_t lon, uint8_t* buf, uint8_t size )
+{
+    uint8_t len = 1;
+
+    if( size < 1 + 1 + 8 )
+    {
+        return 0;
+    }
+    buf[0] = 0x01;
+
+    uint8_t n = track_varint_put( codec->quant_udeg, buf + len, size - len );
+    if( n == 0 || len + n + 8 > size )
+    {
+        return 0;
+    }
+    len += n;
+    track_put32( lon, buf + len );
+    track_put32( lat, buf + len + 4 );
+    len += 8;
+
+    codec->has_ref = true;
+    codec->since_key = 0;
+    codec->ref_lat = lat;
+    codec->ref_lon = lon;
+    return len;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_track_codec_init( app_track_codec_t* codec, uint32_t quant_udeg, uint8_t key_interval )
+{
+    codec->quant_udeg = quant_udeg ? quant_udeg : 1;
+    codec->key_interval = key_interval;
+    app_track_codec_reset( codec );
+}
+
+void app_track_codec_reset( app_track_codec_t* codec )
+{
+    codec->has_ref = false;
+    codec->since_key = 0;
+    codec->ref_lat = 0;
+    codec->ref_lon = 0;
+}
+
+uint8_t app_track_encode( app_track_codec_t* codec, int32_t lat, int32_t lon, uint8_t* buf, uint8_t size )
+{
+    if( !codec->has_ref || ( codec->key_interval && codec->since_key >= codec->key_interval ))
+    {
+        return track_encode_key( codec, lat, lon, buf, size );
+    }
+
+    int32_t dlon = track_quantise( lon, codec->ref_lon, codec->quant_udeg );
+    int32_t dlat = track_quantise( lat, codec->ref_lat, codec->quant_udeg );
+    uint32_t head = track_zigzag( dlon );
+
+    // A delta too large for the header bit is sent as a keyframe
+    if( head > 0x7fffffff )
+    {
+        return track_encode_key( codec, lat, lon, buf, size );
+    }
+
+    uint8_t len = track_varint_put( head << 1, buf, size );
+    uint8_t n = len ? track_varint_put( track_zigzag( dlat ), buf + len, size - len ) : 0;
+    if( n == 0 )
+    {
+        return 0;
+    }
+
+    codec->ref_lon += dlon * ( int32_t )codec->quant_udeg;
+    codec->ref_lat += dlat * ( int32_t )codec->quant_udeg;
+    codec->since_key++;
+    return len + n;
+}
+
+void app_track_decoder_init( app_track_decoder_t* decoder )
+{
+    decoder->has_ref = false;
+    decoder->quant_udeg = 1;
+    decoder->lat = 0;
+    decoder->lon = 0;
+}
+
+uint8_t app_track_decode( app_track_decoder_t* decoder, const uint8_t* buf, uint8_t len, int32_t* lat,
+                          int32_t* lon )
+{
+    uint32_t head, value;
+    uint8_t used = track_varint_get( buf, len, &head );
+
+    if( used == 0 )
+    {
+        return 0;
+    }
+
+    if( head & 1 )
+    {
+        uint8_t n = track_varint_get( buf + used, len - used, &value );
+        if( n == 0 || value == 0 || used + n + 8 > len )
+        {
+            return 0;
+        }
+        used += n;
+        decoder->quant_udeg = value;
+        decoder->lon = track_get32( buf + used );
+        decoder->lat = track_get32( buf + used + 4 );
+        decoder->has_ref = true;
+        used += 8;
+    }
+    else
+    {
+        uint8_t n = track_varint_get( buf + used, len - used, &value );
+        if( n == 0 || !decoder->has_ref )
+        {
+            return 0;
+        }
+        used += n;
+        decoder->lon += track_unzigzag( head >> 1 ) * ( int32_t )decoder->quant_udeg;
+        decoder->lat += track_unzigzag( value ) * ( int32_t )decoder->quant_udeg;
+    }
+
+    *lat = decoder->lat;
+    *lon = decoder->lon;
+    return used;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
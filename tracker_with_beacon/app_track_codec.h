@@ -0,0 +1,132 @@
+#ifndef APP_TRACK_CODEC_H
+#define APP_TRACK_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Largest encoded fix: a keyframe with a 5 byte quantisation step
+ */
+#define APP_TRACK_FIX_MAX           14
+
+/*!
+ * @brief Default quantisation step in 1e-6 degree, about 1.1 m of latitude
+ */
+#define APP_TRACK_QUANT_DEFAULT     10
+
+/*!
+ * @brief Default number of delta fixes between two keyframes
+ */
+#define APP_TRACK_KEY_INTERVAL_DEFAULT 15
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Track encoder
+ *
+ * A fix starts with the zig-zag varint of ( longitude delta << 1 ) | keyframe.
+ * A keyframe is the single byte 0x01, the varint quantisation step, then the
+ * absolute longitude and latitude on 4 bytes each, MSB first. A delta fix
+ * carries the zig-zag varint of the latitude delta next. Deltas are counted in
+ * quantisation steps from the position the decoder rebuilt, so the error stays
+ * within half a step and does not add up along the track.
+ */
+typedef struct
+{
+    uint32_t quant_udeg;            // quantisation step of the deltas in 1e-6 degree, 1 is lossless
+    uint8_t key_interval;           // delta fixes between keyframes, 0 for a keyframe only when needed
+    uint8_t since_key;              // delta fixes since the last keyframe
+    bool has_ref;                   // false until a keyframe is sent
+    int32_t ref_lat;                // position as the decoder rebuilds it, in 1e-6 degree
+    int32_t ref_lon;
+} app_track_codec_t;
+
+/*!
+ * @brief Track decoder
+ */
+typedef struct
+{
+    bool has_ref;                   // false until a keyframe is decoded
+    uint32_t quant_udeg;
+    int32_t lat;                    // last decoded position, in 1e-6 degree
+    int32_t lon;
+} app_track_decoder_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Initialise a track encoder, the first fix is a keyframe
+ *
+ * @param [out] codec Encoder
+ * @param [in] quant_udeg Quantisation step in 1e-6 degree, 0 is taken as 1
+ * @param [in] key_interval Delta fixes between keyframes, 0 for no periodic keyframe
+ */
+void app_track_codec_init( app_track_codec_t* codec, uint32_t quant_udeg, uint8_t key_interval );
+
+/*!
+ * @brief Make the next fix a keyframe, when the decoder may have missed a fix
+ *
+ * @param [in,out] codec Encoder
+ */
+void app_track_codec_reset( app_track_codec_t* codec );
+
+/*!
+ * @brief Encode one fix
+ *
+ * @param [in,out] codec Encoder
+ * @param [in] lat Latitude in 1e-6 degree
+ * @param [in] lon Longitude in 1e-6 degree
+ * @param [out] buf Encoded fix
+ * @param [in] size Size of buf
+ *
+ * @returns Length of the encoded fix, 0 if buf is too small and nothing was encoded
+ */
+uint8_t app_track_encode( app_track_codec_t* codec, int32_t lat, int32_t lon, uint8_t* buf, uint8_t size );
+
+/*!
+ * @brief Initialise a track decoder
+ *
+ * @param [out] decoder Decoder
+ */
+void app_track_decoder_init( app_track_decoder_t* decoder );
+
+/*!
+ * @brief Decode one fix
+ *
+ * @param [in,out] decoder Decoder
+ * @param [in] buf Encoded fixes
+ * @param [in] len Length of buf
+ * @param [out] lat Latitude in 1e-6 degree
+ * @param [out] lon Longitude in 1e-6 degree
+ *
+ * @returns Bytes used by the fix, 0 if it is truncated or a delta comes before any keyframe
+ */
+uint8_t app_track_decode( app_track_decoder_t* decoder, const uint8_t* buf, uint8_t len, int32_t* lat,
+                          int32_t* lon );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_TRACK_CODEC_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,155 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stddef.h>
+
+#include "app_uplink_queue.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static bool uplink_before( const app_uplink_t* a, const app_uplink_t* b )
+{
+    return a->prio < b->prio || ( a->prio == b->prio && a->seq < b->seq );
+}
+
+static void uplink_queue_remove( app_uplink_queue_t* queue, uint8_t index, app_uplink_t* removed )
+{
+    if( removed != NULL )
+    {
+        *removed = queue->items[index];
+    }
+    // Order is not kept in the array, the last item fills the hole
+    queue->count--;
+    if( index != queue->count )
+    {
+        queue->items[index] = queue->items[queue->count];
+    }
+}
+
+/*!
+ * @brief Index of the uplink a new one of priority prio may replace, -1 if none
+ */
+static int8_t uplink_queue_victim( const app_uplink_queue_t* queue, uint8_t prio )
+{
+    int8_t victim = -1;
+
+    // Stale report of the same kind first
+    if( prio == APP_UPLINK_PRIO_PERIODIC || prio == APP_UPLINK_PRIO_BACKFILL )
+    {
+        for( uint8_t i = 0; i < queue->count; i++ )
+        {
+            if( queue->items[i].prio == prio )
+            {
+                return i;
+            }
+        }
+    }
+
+    if( queue->count < APP_UPLINK_QUEUE_SIZE )
+    {
+        return -1;
+    }
+
+    // Otherwise the oldest of the lowest priority, when not above the new one
+    for( uint8_t i = 0; i < queue->count; i++ )
+    {
+        const app_uplink_t* item = &queue->items[i];
+        if( victim < 0 || item->prio > queue->items[victim].prio
+            || ( item->prio == queue->items[victim].prio && item->seq < queue->items[victim].seq ))
+        {
+            victim = i;
+        }
+    }
+    if( queue->items[victim].prio < prio || queue->items[victim].prio == APP_UPLINK_PRIO_EMERGENCY )
+    {
+        return -2;
+    }
+    return victim;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_uplink_queue_init( app_uplink_queue_t* queue )
+{
+    queue->count = 0;
+    queue->next_seq = 0;
+    queue->dropped = 0;
+}
+
+app_uplink_push_t app_uplink_queue_push( app_uplink_queue_t* queue, const app_uplink_t* uplink,
+                                         app_uplink_t* dropped )
+{
+    app_uplink_push_t result = APP_UPLINK_QUEUED;
+    int8_t victim = uplink_queue_victim( queue, uplink->prio );
+
+    if( victim == -2 )
+    {
+        return APP_UPLINK_REJECTED;
+    }
+    if( victim >= 0 )
+    {
+        uplink_queue_remove( queue, victim, dropped );
+        queue->dropped++;
+        result = APP_UPLINK_QUEUED_DROPPED;
+    }
+
+    app_uplink_t* item = &queue->items[queue->count++];
+    *item = *uplink;
+    item->seq = queue->next_seq++;
+    return result;
+}
+
+const app_uplink_t* app_uplink_queue_head( const app_uplink_queue_t* queue )
+{
+    const app_uplink_t* head = NULL;
+
+    for( uint8_t i = 0; i < queue->count; i++ )
+    {
+        if( head == NULL || uplink_before( &queue->items[i], head ))
+        {
+            head = &queue->items[i];
+        }
+    }
+    return head;
+}
+
+bool app_uplink_queue_pop( app_uplink_queue_t* queue, app_uplink_t* uplink )
+{
+    const app_uplink_t* head = app_uplink_queue_head( queue );
+
+    if( head == NULL )
+    {
+        return false;
+    }
+    uplink_queue_remove( queue, head - queue->items, uplink );
+    return true;
+}
+
+bool app_uplink_queue_expire( app_uplink_queue_t* queue, uint8_t prio, uint32_t now_ms, uint32_t max_age_ms,
+                              app_uplink_t* dropped )
+{
+    for( uint8_t i = 0; i < queue->count; i++ )
+    {
+        if( queue->items[i].prio == prio && now_ms - queue->items[i].queued_ms > max_age_ms )
+        {
+            uplink_queue_remove( queue, i, dropped );
+            queue->dropped++;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t app_uplink_queue_count( const app_uplink_queue_t* queue )
+{
+    return queue->count;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,167 @@
+#ifndef APP_UPLINK_QUEUE_H
+#define APP_UPLINK_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Uplinks waiting at most
+ */
+#define APP_UPLINK_QUEUE_SIZE       4
+
+/*!
+ * @brief Largest uplink payload, the LoRaWAN maximum
+ */
+#define APP_UPLINK_PAYLOAD_MAX      242
+
+/*!
+ * @brief Records tracked per uplink, for the owner to save them if the uplink is dropped
+ */
+#define APP_UPLINK_RECORD_MAX       3
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Uplink priorities, highest first
+ */
+typedef enum
+{
+    APP_UPLINK_PRIO_EMERGENCY = 0,
+    APP_UPLINK_PRIO_ALARM,
+    APP_UPLINK_PRIO_PERIODIC,                   // a newer periodic report replaces the queued one
+    APP_UPLINK_PRIO_BACKFILL,                   // a newer backfill frame replaces the queued one
+    APP_UPLINK_PRIO_NUM
+} app_uplink_prio_t;
+
+/*!
+ * @brief Result of a push
+ */
+typedef enum
+{
+    APP_UPLINK_QUEUED = 0,
+    APP_UPLINK_QUEUED_DROPPED,                  // queued, a stale or lower priority uplink was dropped for it
+    APP_UPLINK_REJECTED,                        // full of uplinks of higher priority
+} app_uplink_push_t;
+
+/*!
+ * @brief One pending uplink
+ */
+typedef struct
+{
+    uint8_t prio;                               // @ref app_uplink_prio_t
+    uint8_t port;
+    bool confirmed;
+    bool emergency;
+    uint32_t seq;                               // push order
+    uint32_t queued_ms;                         // time of the push
+    uint32_t time_s;                            // GPS time of the data, 0 if unknown
+    uint8_t record_num;
+    uint8_t record_at[APP_UPLINK_RECORD_MAX];   // offsets of the records in data
+    uint8_t place;                              // Wi-Fi place defined by the uplink, known to the server once delivered
+    bool track_fix;                             // the first record is a track codec fix of fix_lat, fix_lon
+    int32_t fix_lat;                            // in 1e-6 degree, to log the fix as a keyframe
+    int32_t fix_lon;
+    uint8_t len;
+    uint8_t data[APP_UPLINK_PAYLOAD_MAX];
+} app_uplink_t;
+
+/*!
+ * @brief Priority queue of uplinks, FIFO within a priority
+ */
+typedef struct
+{
+    uint8_t count;
+    uint32_t next_seq;
+    uint32_t dropped;                           // uplinks dropped as stale or for a higher priority one
+    app_uplink_t items[APP_UPLINK_QUEUE_SIZE];
+} app_uplink_queue_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Empty a queue
+ *
+ * @param [out] queue Queue
+ */
+void app_uplink_queue_init( app_uplink_queue_t* queue );
+
+/*!
+ * @brief Add an uplink
+ *
+ * A periodic or backfill uplink replaces the queued one of the same priority.
+ * When the queue is full, the oldest uplink of the lowest priority is dropped if
+ * it is not above the new one; emergency uplinks are never dropped.
+ *
+ * @param [in,out] queue Queue
+ * @param [in] uplink Uplink, seq is set by the queue
+ * @param [out] dropped Uplink dropped for it, valid for APP_UPLINK_QUEUED_DROPPED
+ *
+ * @returns Push result
+ */
+app_uplink_push_t app_uplink_queue_push( app_uplink_queue_t* queue, const app_uplink_t* uplink,
+                                         app_uplink_t* dropped );
+
+/*!
+ * @brief Next uplink to send: highest priority, then oldest
+ *
+ * @param [in] queue Queue
+ *
+ * @returns Uplink, NULL if the queue is empty
+ */
+const app_uplink_t* app_uplink_queue_head( const app_uplink_queue_t* queue );
+
+/*!
+ * @brief Remove the next uplink to send
+ *
+ * @param [in,out] queue Queue
+ * @param [out] uplink Removed uplink
+ *
+ * @returns false if the queue is empty
+ */
+bool app_uplink_queue_pop( app_uplink_queue_t* queue, app_uplink_t* uplink );
+
+/*!
+ * @brief Drop one uplink of a priority queued for longer than max_age_ms
+ *
+ * @param [in,out] queue Queue
+ * @param [in] prio Priority
+ * @param [in] now_ms Current time
+ * @param [in] max_age_ms Age from which an uplink is stale
+ * @param [out] dropped Dropped uplink
+ *
+ * @returns true if an uplink was dropped, call again until false
+ */
+bool app_uplink_queue_expire( app_uplink_queue_t* queue, uint8_t prio, uint32_t now_ms, uint32_t max_age_ms,
+                              app_uplink_t* dropped );
+
+/*!
+ * @brief Number of queued uplinks
+ */
+uint8_t app_uplink_queue_count( const app_uplink_queue_t* queue );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_UPLINK_QUEUE_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,297 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stddef.h>
+#include <string.h>
+
+#include "app_uplink_schema.h"
+#include "app_lora_packet.h"
+#include "main_lorawan_tracker.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define SENSOR_FIELDS           APP_UPLINK_FIELD_EVENT, APP_UPLINK_FIELD_BATTERY, \
+                                APP_UPLINK_FIELD_TEMPERATURE, APP_UPLINK_FIELD_LIGHT
+#define GPS_FIELD               ( TRACKER_GPS_TRACK_CODEC ? APP_UPLINK_FIELD_TRACK : APP_UPLINK_FIELD_POSITION )
+#if TRACKER_GPS_FIX_TIME
+#define GPS_FIELDS              GPS_FIELD, APP_UPLINK_FIELD_TIME
+#else
+#define GPS_FIELDS              GPS_FIELD
+#endif
+
+#define RECORD( id, ... )       { id, #id, sizeof(( uint8_t[] ){ __VA_ARGS__ }), { __VA_ARGS__ } }
+
+/*!
+ * @brief Record layouts, the single definition shared by the encoder and every decoder
+ */
+static const app_uplink_schema_t uplink_schemas[] = {
+    RECORD( DATA_ID_UP_PACKET_SEN_BAT, SENSOR_FIELDS ),
+    RECORD( DATA_ID_UP_PACKET_SEN_ACC_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_ACC ),
+    RECORD( DATA_ID_UP_PACKET_GPS_SEN_BAT, SENSOR_FIELDS, GPS_FIELDS ),
+    RECORD( DATA_ID_UP_PACKET_GPS_SEN_ACC_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_ACC, GPS_FIELDS ),
+    RECORD( DATA_ID_UP_PACKET_WIFI_SEN_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_SCAN ),
+    RECORD( DATA_ID_UP_PACKET_WIFI_SEN_ACC_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_ACC, APP_UPLINK_FIELD_SCAN ),
+    RECORD( DATA_ID_UP_PACKET_BLE_SEN_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_SCAN ),
+    RECORD( DATA_ID_UP_PACKET_BLE_SEN_ACC_BAT, SENSOR_FIELDS, APP_UPLINK_FIELD_ACC, APP_UPLINK_FIELD_SCAN ),
+};
+
+#define SCHEMA_NUM              ( sizeof( uplink_schemas ) / sizeof( uplink_schemas[0] ))
+
+static const uint8_t field_sizes[APP_UPLINK_FIELD_NUM] = {
+    [APP_UPLINK_FIELD_EVENT]        = 1,
+    [APP_UPLINK_FIELD_BATTERY]      = 1,
+    [APP_UPLINK_FIELD_TEMPERATURE]  = 2,
+    [APP_UPLINK_FIELD_LIGHT]        = 2,
+    [APP_UPLINK_FIELD_ACC]          = 6,
+    [APP_UPLINK_FIELD_POSITION]     = 8,
+    [APP_UPLINK_FIELD_TRACK]        = 0,
+    [APP_UPLINK_FIELD_SCAN]         = 0,
+    [APP_UPLINK_FIELD_TIME]         = 4,
+};
+
+static const char* const field_names[APP_UPLINK_FIELD_NUM] = {
+    [APP_UPLINK_FIELD_EVENT]        = "event",
+    [APP_UPLINK_FIELD_BATTERY]      = "battery",
+    [APP_UPLINK_FIELD_TEMPERATURE]  = "temperature",
+    [APP_UPLINK_FIELD_LIGHT]        = "light",
+    [APP_UPLINK_FIELD_ACC]          = "acc",
+    [APP_UPLINK_FIELD_POSITION]     = "position",
+    [APP_UPLINK_FIELD_TRACK]        = "track",
+    [APP_UPLINK_FIELD_SCAN]         = "scan",
+    [APP_UPLINK_FIELD_TIME]         = "time",
+};
+
+// Scan entry: MAC address then RSSI, as in app_scan_topk.h
+#define SCAN_ENTRY_LEN          7
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void schema_put16( uint16_t value, uint8_t* buf )
+{
+    buf[0] = value >> 8;
+    buf[1] = value;
+}
+
+static uint16_t schema_get16( const uint8_t* buf )
+{
+    return ( uint16_t )( buf[0] << 8 | buf[1] );
+}
+
+static void schema_put32( uint32_t value, uint8_t* buf )
+{
+    schema_put16( value >> 16, buf );
+    schema_put16( value, buf + 2 );
+}
+
+static uint32_t schema_get32( const uint8_t* buf )
+{
+    return ( uint32_t )schema_get16( buf ) << 16 | schema_get16( buf + 2 );
+}
+
+/*!
+ * @brief Length of a track codec fix, 0 if truncated
+ */
+static uint8_t schema_track_len( const uint8_t* buf, uint8_t len )
+{
+    uint8_t pos = 0;
+    uint8_t varints = 2;
+
+    // A keyframe has its step varint then 8 bytes, a delta fix its latitude varint
+    if( len > 0 && buf[0] == 0x01 )
+    {
+        varints = 1;
+        pos = 1;
+    }
+    while( varints-- )
+    {
+        do
+        {
+            if( pos >= len ) return 0;
+        } while( buf[pos++] & 0x80 );
+    }
+    if( buf[0] == 0x01 )
+    {
+        pos += 8;
+    }
+    return pos <= len ? pos : 0;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+const app_uplink_schema_t* app_uplink_schema_find( uint8_t id )
+{
+    for( uint8_t i = 0; i < SCHEMA_NUM; i++ )
+    {
+        if( uplink_schemas[i].id == id )
+        {
+            return &uplink_schemas[i];
+        }
+    }
+    return NULL;
+}
+
+const app_uplink_schema_t* app_uplink_schema_at( uint8_t index )
+{
+    return index < SCHEMA_NUM ? &uplink_schemas[index] : NULL;
+}
+
+uint8_t app_uplink_schema_field_size( uint8_t field )
+{
+    return field < APP_UPLINK_FIELD_NUM ? field_sizes[field] : 0;
+}
+
+const char* app_uplink_schema_field_name( uint8_t field )
+{
+    return field < APP_UPLINK_FIELD_NUM ? field_names[field] : "";
+}
+
+uint16_t app_uplink_schema_size( const app_uplink_schema_t* schema, const app_uplink_values_t* values )
+{
+    uint16_t size = 1;
+
+    for( uint8_t i = 0; i < schema->field_num; i++ )
+    {
+        switch( schema->fields[i] )
+        {
+            case APP_UPLINK_FIELD_TRACK: size += values->location_len; break;
+            case APP_UPLINK_FIELD_SCAN: size += 1 + ( values->place != 0 ) + values->location_len; break;
+            default: size += field_sizes[schema->fields[i]]; break;
+        }
+    }
+    return size;
+}
+
+uint8_t app_uplink_schema_encode( const app_uplink_schema_t* schema, const app_uplink_values_t* values,
+                                  uint8_t* buf, uint8_t size )
+{
+    uint8_t len = 1;
+
+    if( app_uplink_schema_size( schema, values ) > size )
+    {
+        return 0;
+    }
+
+    buf[0] = schema->id;
+    for( uint8_t i = 0; i < schema->field_num; i++ )
+    {
+        uint8_t* p = buf + len;
+
+        switch( schema->fields[i] )
+        {
+            case APP_UPLINK_FIELD_EVENT: p[0] = values->event; break;
+            case APP_UPLINK_FIELD_BATTERY: p[0] = values->battery; break;
+            case APP_UPLINK_FIELD_TEMPERATURE: schema_put16( values->temperature, p ); break;
+            case APP_UPLINK_FIELD_LIGHT: schema_put16( values->light, p ); break;
+            case APP_UPLINK_FIELD_ACC:
+                schema_put16( values->acc[0], p );
+                schema_put16( values->acc[1], p + 2 );
+                schema_put16( values->acc[2], p + 4 );
+                break;
+            case APP_UPLINK_FIELD_POSITION:
+                memcpy( p, values->location, field_sizes[APP_UPLINK_FIELD_POSITION] );
+                break;
+            case APP_UPLINK_FIELD_TIME: schema_put32( values->time, p ); break;
+            case APP_UPLINK_FIELD_TRACK:
+                memcpy( p, values->location, values->location_len );
+                len += values->location_len;
+                continue;
+            case APP_UPLINK_FIELD_SCAN:
+            {
+                uint8_t head = values->place != 0 ? 2 : 1;
+
+                p[0] = values->location_len / SCAN_ENTRY_LEN;
+                if( values->place != 0 )
+                {
+                    p[0] |= APP_UPLINK_SCAN_PLACE;
+                    p[1] = values->place;
+                }
+                memcpy( p + head, values->location, values->location_len );
+                len += head + values->location_len;
+                continue;
+            }
+            default:
+                break;
+        }
+        len += field_sizes[schema->fields[i]];
+    }
+    return len;
+}
+
+uint8_t app_uplink_schema_decode( const uint8_t* buf, uint8_t len, const app_uplink_schema_t** schema,
+                                  app_uplink_values_t* values )
+{
+    uint8_t pos = 1;
+
+    if( len == 0 || ( *schema = app_uplink_schema_find( buf[0] )) == NULL )
+    {
+        return 0;
+    }
+
+    memset( values, 0, sizeof( *values ));
+    for( uint8_t i = 0; i < ( *schema )->field_num; i++ )
+    {
+        uint8_t field = ( *schema )->fields[i];
+        uint8_t field_len = field_sizes[field];
+        const uint8_t* p = buf + pos;
+
+        if( field == APP_UPLINK_FIELD_TRACK )
+        {
+            field_len = schema_track_len( p, len - pos );
+            if( field_len == 0 ) return 0;
+        }
+        else if( field == APP_UPLINK_FIELD_SCAN )
+        {
+            if( pos >= len ) return 0;
+            field_len = 1 + ( p[0] & ~APP_UPLINK_SCAN_PLACE ) * SCAN_ENTRY_LEN;
+            if( p[0] & APP_UPLINK_SCAN_PLACE ) field_len++;
+        }
+        if( pos + field_len > len )
+        {
+            return 0;
+        }
+
+        switch( field )
+        {
+            case APP_UPLINK_FIELD_EVENT: values->event = p[0]; break;
+            case APP_UPLINK_FIELD_BATTERY: values->battery = ( int8_t )p[0]; break;
+            case APP_UPLINK_FIELD_TEMPERATURE: values->temperature = ( int16_t )schema_get16( p ); break;
+            case APP_UPLINK_FIELD_LIGHT: values->light = schema_get16( p ); break;
+            case APP_UPLINK_FIELD_ACC:
+                values->acc[0] = ( int16_t )schema_get16( p );
+                values->acc[1] = ( int16_t )schema_get16( p + 2 );
+                values->acc[2] = ( int16_t )schema_get16( p + 4 );
+                break;
+            case APP_UPLINK_FIELD_POSITION:
+            case APP_UPLINK_FIELD_TRACK:
+                values->location = p;
+                values->location_len = field_len;
+                break;
+            case APP_UPLINK_FIELD_TIME: values->time = schema_get32( p ); break;
+            case APP_UPLINK_FIELD_SCAN:
+            {
+                uint8_t head = ( p[0] & APP_UPLINK_SCAN_PLACE ) ? 2 : 1;
+
+                values->place = head == 2 ? p[1] : 0;
+                values->location = p + head;
+                values->location_len = field_len - head;
+                break;
+            }
+            default:
+                break;
+        }
+        pos += field_len;
+    }
+    return pos;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,160 @@
+#ifndef APP_UPLINK_SCHEMA_H
+#define APP_UPLINK_SCHEMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Most fields in a record after its data ID
+ */
+#define APP_UPLINK_SCHEMA_FIELD_MAX 7
+
+/*!
+ * @brief Bit of the scan count telling that a Wi-Fi place ID follows it
+ *
+ * With no entry the record stands for the place alone, with entries it defines the place.
+ */
+#define APP_UPLINK_SCAN_PLACE       0x80
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Record fields, multi-byte values are MSB first
+ */
+typedef enum
+{
+    APP_UPLINK_FIELD_EVENT = 0,     // 1 byte, event state bits
+    APP_UPLINK_FIELD_BATTERY,       // 1 byte, battery level as sampled
+    APP_UPLINK_FIELD_TEMPERATURE,   // 2 bytes signed, as sampled
+    APP_UPLINK_FIELD_LIGHT,         // 2 bytes, as sampled
+    APP_UPLINK_FIELD_ACC,           // 3 x 2 bytes signed, x y z raw accelerometer data
+    APP_UPLINK_FIELD_POSITION,      // 4 bytes longitude then 4 bytes latitude, signed 1e-6 degree
+    APP_UPLINK_FIELD_TRACK,         // track codec fix, see app_track_codec.h
+    APP_UPLINK_FIELD_SCAN,          // 1 byte count, 1 byte place ID if APP_UPLINK_SCAN_PLACE is set in the count,
+                                    // then count x ( 6 bytes MAC, 1 byte signed RSSI )
+    APP_UPLINK_FIELD_TIME,          // 4 bytes, GPS time of the fix in s, 0 if the clock was not synced
+    APP_UPLINK_FIELD_NUM
+} app_uplink_field_t;
+
+/*!
+ * @brief Layout of one record type
+ */
+typedef struct
+{
+    uint8_t id;                                 // DATA_ID_UP_PACKET_* value
+    const char* name;
+    uint8_t field_num;
+    uint8_t fields[APP_UPLINK_SCHEMA_FIELD_MAX]; // @ref app_uplink_field_t
+} app_uplink_schema_t;
+
+/*!
+ * @brief Values of a record
+ *
+ * The location tail is referenced, not copied: the encoder writes it straight
+ * into the frame and the decoder points into the frame.
+ */
+typedef struct
+{
+    uint8_t event;
+    int8_t battery;
+    int16_t temperature;
+    uint16_t light;
+    int16_t acc[3];
+    const uint8_t* location;        // POSITION or TRACK bytes, or SCAN entries without the count
+    uint8_t location_len;
+    uint8_t place;                  // Wi-Fi place ID of a SCAN field, 0 for none
+    uint32_t time;                  // GPS time of a TIME field
+} app_uplink_values_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Layout of a record type
+ *
+ * @param [in] id DATA_ID_UP_PACKET_* value
+ *
+ * @returns Layout, NULL if the ID is unknown
+ */
+const app_uplink_schema_t* app_uplink_schema_find( uint8_t id );
+
+/*!
+ * @brief Layout at an index, to walk every record type
+ *
+ * @param [in] index From 0
+ *
+ * @returns Layout, NULL past the last one
+ */
+const app_uplink_schema_t* app_uplink_schema_at( uint8_t index );
+
+/*!
+ * @brief Size of a field, 0 if it depends on the data
+ */
+uint8_t app_uplink_schema_field_size( uint8_t field );
+
+/*!
+ * @brief Name of a field, as used by the backend decoder
+ */
+const char* app_uplink_schema_field_name( uint8_t field );
+
+/*!
+ * @brief Encoded size of a record
+ *
+ * @param [in] schema Layout
+ * @param [in] values Values, only location_len is used
+ *
+ * @returns Size in bytes, data ID included
+ */
+uint16_t app_uplink_schema_size( const app_uplink_schema_t* schema, const app_uplink_values_t* values );
+
+/*!
+ * @brief Encode one record
+ *
+ * @param [in] schema Layout
+ * @param [in] values Values
+ * @param [out] buf Frame position to write the record at
+ * @param [in] size Room left in the frame
+ *
+ * @returns Record length, 0 if it does not fit and nothing was written
+ */
+uint8_t app_uplink_schema_encode( const app_uplink_schema_t* schema, const app_uplink_values_t* values,
+                                  uint8_t* buf, uint8_t size );
+
+/*!
+ * @brief Decode one record
+ *
+ * @param [in] buf Frame position of the record
+ * @param [in] len Bytes left in the frame
+ * @param [out] schema Layout of the record
+ * @param [out] values Values, location points into buf
+ *
+ * @returns Record length, 0 if the ID is unknown or the record is truncated
+ */
+uint8_t app_uplink_schema_decode( const uint8_t* buf, uint8_t len, const app_uplink_schema_t** schema,
+                                  app_uplink_values_t* values );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_UPLINK_SCHEMA_H
+
+/* --- EOF ------------------------------------------------------------------ */
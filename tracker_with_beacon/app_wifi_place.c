@@ -0,0 +1,231 @@
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "app_wifi_place.h"
+#include "app_fds_store.h"
+#include "fds.h"
+#include "smtc_hal.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define WIFI_PLACE_STORE_WORDS  (( sizeof( app_wifi_place_cache_t ) + 3 ) / 4 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+// FDS reads the image until the write completes, a confirmation meanwhile is written after it
+static app_wifi_place_cache_t store;
+static app_fds_store_write_t store_write;
+static const app_wifi_place_cache_t* store_cache = NULL;
+static bool store_pending = false;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+/*!
+ * @brief Jaccard index in % of the MAC addresses of a scan and of a place
+ */
+static uint8_t wifi_place_similarity( const app_wifi_place_t* place, const uint8_t* entries, uint8_t num,
+                                      uint8_t* common )
+{
+    *common = 0;
+    for( uint8_t i = 0; i < num; i++ )
+    {
+        for( uint8_t j = 0; j < place->mac_num; j++ )
+        {
+            if( memcmp( entries + i * APP_SCAN_ENTRY_LEN, place->mac[j], APP_WIFI_PLACE_MAC_LEN ) == 0 )
+            {
+                ( *common )++;
+                break;
+            }
+        }
+    }
+    // Scan entries are unique by MAC address, as the top-K selector keeps them
+    return *common * 100 / ( num + place->mac_num - *common );
+}
+
+/*!
+ * @brief Slot for a new place: a free one, or the least recently seen
+ */
+static app_wifi_place_t* wifi_place_slot( app_wifi_place_cache_t* cache )
+{
+    app_wifi_place_t* slot = &cache->places[0];
+
+    for( uint8_t i = 0; i < APP_WIFI_PLACE_MAX; i++ )
+    {
+        app_wifi_place_t* place = &cache->places[i];
+
+        if( place->id == 0 )
+        {
+            return place;
+        }
+        if( place->seen < slot->seen )
+        {
+            slot = place;
+        }
+    }
+    return slot;
+}
+
+static void wifi_place_store_write( void );
+
+static void wifi_place_store_done( app_fds_store_write_t* write, bool ok )
+{
+    ( void )write;
+    if( !ok )
+    {
+        HAL_DBG_TRACE_ERROR( "wifi place write failed\n" );
+    }
+    if( store_pending )
+    {
+        store_pending = false;
+        wifi_place_store_write( );
+    }
+}
+
+static void wifi_place_store_write( void )
+{
+    store = *store_cache;
+
+    store_write.file_id = APP_WIFI_PLACE_FILE_ID;
+    store_write.key = APP_WIFI_PLACE_KEY;
+    store_write.data = &store;
+    store_write.length_words = WIFI_PLACE_STORE_WORDS;
+    store_write.done = wifi_place_store_done;
+    app_fds_store_write( &store_write );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void app_wifi_place_init( app_wifi_place_cache_t* cache )
+{
+    memset( cache, 0, sizeof( *cache ));
+    cache->similarity_min = APP_WIFI_PLACE_SIMILARITY_DEFAULT;
+    cache->next_id = 1;
+}
+
+bool app_wifi_place_restore( app_wifi_place_cache_t* cache )
+{
+    fds_record_desc_t desc;
+    fds_find_token_t token;
+    fds_flash_record_t flash_record;
+    bool ok = false;
+
+    memset( &token, 0, sizeof( token ));
+    if( fds_record_find( APP_WIFI_PLACE_FILE_ID, APP_WIFI_PLACE_KEY, &desc, &token ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( fds_record_open( &desc, &flash_record ) != NRF_SUCCESS )
+    {
+        return false;
+    }
+    if( flash_record.p_header->length_words == WIFI_PLACE_STORE_WORDS )
+    {
+        memcpy( cache, flash_record.p_data, sizeof( *cache ));
+        ok = true;
+    }
+    fds_record_close( &desc );
+
+    if( ok )
+    {
+        HAL_DBG_TRACE_INFO( "wifi places restored, next ID %d\n", cache->next_id );
+    }
+    return ok;
+}
+
+uint8_t app_wifi_place_lookup( app_wifi_place_cache_t* cache, const uint8_t* entries, uint8_t len, bool* known )
+{
+    uint8_t num = len / APP_SCAN_ENTRY_LEN;
+    app_wifi_place_t* best = NULL;
+    uint8_t best_similarity = 0;
+
+    *known = false;
+    if( num < APP_WIFI_PLACE_COMMON_MIN )
+    {
+        return 0;
+    }
+    if( num > APP_SCAN_TOPK_MAX ) num = APP_SCAN_TOPK_MAX;
+
+    for( uint8_t i = 0; i < APP_WIFI_PLACE_MAX; i++ )
+    {
+        app_wifi_place_t* place = &cache->places[i];
+        uint8_t common;
+
+        if( place->id == 0 )
+        {
+            continue;
+        }
+
+        uint8_t similarity = wifi_place_similarity( place, entries, num, &common );
+        if( common >= APP_WIFI_PLACE_COMMON_MIN && similarity >= cache->similarity_min && similarity > best_similarity )
+        {
+            best = place;
+            best_similarity = similarity;
+        }
+    }
+
+    cache->stamp++;
+    if( best != NULL )
+    {
+        best->seen = cache->stamp;
+        *known = best->known;
+        return best->id;
+    }
+
+    best = wifi_place_slot( cache );
+    best->id = cache->next_id;
+    best->known = false;
+    best->seen = cache->stamp;
+    best->mac_num = num;
+    for( uint8_t i = 0; i < num; i++ )
+    {
+        memcpy( best->mac[i], entries + i * APP_SCAN_ENTRY_LEN, APP_WIFI_PLACE_MAC_LEN );
+    }
+
+    // IDs go round 1 to 255, so an ID is not given again while the server may still get reports of it
+    cache->next_id = cache->next_id == UINT8_MAX ? 1 : cache->next_id + 1;
+    return best->id;
+}
+
+void app_wifi_place_confirm( app_wifi_place_cache_t* cache, uint8_t id )
+{
+    bool changed = false;
+
+    for( uint8_t i = 0; i < APP_WIFI_PLACE_MAX; i++ )
+    {
+        if( id != 0 && cache->places[i].id == id && !cache->places[i].known )
+        {
+            cache->places[i].known = true;
+            changed = true;
+        }
+    }
+    if( !changed )
+    {
+        return;
+    }
+
+    // Places created since are stored too, an unknown one only ever went out with its scan
+    store_cache = cache;
+    if( app_fds_store_is_pending( &store_write ))
+    {
+        store_pending = true;
+        return;
+    }
+    wifi_place_store_write( );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,137 @@
+#ifndef APP_WIFI_PLACE_H
+#define APP_WIFI_PLACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_scan_topk.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Places remembered, the least recently seen one makes room for a new one
+ */
+#define APP_WIFI_PLACE_MAX                  8
+
+/*!
+ * @brief Default similarity from which a scan is taken for a known place
+ *
+ * Jaccard index of the access point sets in %: with 3 access points kept, one of
+ * them replaced by another still matches, two do not.
+ */
+#define APP_WIFI_PLACE_SIMILARITY_DEFAULT   50
+
+/*!
+ * @brief Access points a scan and a place must have in common at least
+ */
+#define APP_WIFI_PLACE_COMMON_MIN           2
+
+/*!
+ * @brief MAC address length of a scan entry
+ */
+#define APP_WIFI_PLACE_MAC_LEN              6
+
+/*!
+ * @brief FDS file and key of the stored cache
+ */
+#define APP_WIFI_PLACE_FILE_ID              0x5750
+#define APP_WIFI_PLACE_KEY                  0x0001
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Fingerprint of one place
+ */
+typedef struct
+{
+    uint8_t id;                     // place ID, 0 for a free slot
+    bool known;                     // the scan defining the place was delivered, the ID can replace it
+    uint32_t seen;                  // cache stamp of the last match
+    uint8_t mac_num;
+    uint8_t mac[APP_SCAN_TOPK_MAX][APP_WIFI_PLACE_MAC_LEN];
+} app_wifi_place_t;
+
+/*!
+ * @brief Fingerprint cache
+ */
+typedef struct
+{
+    uint8_t similarity_min;         // in %
+    uint8_t next_id;
+    uint32_t stamp;
+    app_wifi_place_t places[APP_WIFI_PLACE_MAX];
+} app_wifi_place_cache_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Clear a fingerprint cache
+ *
+ * @param [out] cache Fingerprint cache
+ */
+void app_wifi_place_init( app_wifi_place_cache_t* cache );
+
+/*!
+ * @brief Load the cache stored by the last confirmation, to be called once FDS is initialised
+ *
+ * Known places keep their IDs over resets, so an ID the server has solved is
+ * never given to another place by a restarted counter.
+ *
+ * @param [out] cache Fingerprint cache, left as it is if nothing is stored
+ *
+ * @returns true if a stored cache was loaded
+ */
+bool app_wifi_place_restore( app_wifi_place_cache_t* cache );
+
+/*!
+ * @brief Find the place of a scan, or remember it as a new place
+ *
+ * The most similar place wins if it reaches similarity_min with at least
+ * APP_WIFI_PLACE_COMMON_MIN access points in common. Its fingerprint is kept as
+ * first seen, so the place stays where the server located it. Otherwise the scan
+ * becomes a new place with the next ID, 1 to 255 in turn, evicting the least
+ * recently seen one when the cache is full.
+ *
+ * @param [in,out] cache Fingerprint cache
+ * @param [in] entries Scan entries, APP_SCAN_ENTRY_LEN bytes each
+ * @param [in] len Length of entries
+ * @param [out] known true if the server already knows the place
+ *
+ * @returns Place ID, 0 if the scan has too few access points to make a place
+ */
+uint8_t app_wifi_place_lookup( app_wifi_place_cache_t* cache, const uint8_t* entries, uint8_t len, bool* known );
+
+/*!
+ * @brief Mark a place known once the uplink carrying its defining scan is acknowledged
+ *
+ * A place that becomes known is stored to flash with the whole cache.
+ *
+ * @param [in,out] cache Fingerprint cache
+ * @param [in] id Place ID
+ */
+void app_wifi_place_confirm( app_wifi_place_cache_t* cache, uint8_t id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APP_WIFI_PLACE_H
+
+/* --- EOF ------------------------------------------------------------------ */
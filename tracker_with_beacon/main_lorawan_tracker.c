@@ -19,7 +19,22 @@
 #include "app_board.h"
 #include "app_ble_all.h"
 #include "app_ble_beacon.h"  // Add iBeacon functionality
+#include "app_ble_scan_filter.h"
+#include "app_radio_coex.h"
+#include "app_scan_plan.h"
+#include "app_scan_topk.h"
+#include "app_gnss_fix.h"
+#include "app_fds_store.h"
+#include "app_fix_log.h"
+#include "app_track_codec.h"
+#include "app_uplink_queue.h"
+#include "app_uplink_schema.h"
+#include "app_motion_policy.h"
+#include "app_wifi_place.h"
+#include "app_link_policy.h"
+#include "app_config_batch.h"
 #include "app_config_param.h"
+#include "app_report_slot.h"
 #include "app_at_fds_datas.h"
 #include "app_at_command.h"
 #include "app_lora_packet.h"
@@ -33,16 +48,42 @@
  * --- PRIVATE MACROS-----------------------------------------------------------
  */
 
+// AS923 groups share one custom ADR profile
+#define REGION_AS923 { "AS923", LORAWAN_AS923_DR_MIN, LORAWAN_AS923_DR_MAX, 12, \
+                       { 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5 }} // SF9,SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE CONSTANTS -------------------------------------------------------
  */
 
+/*!
+ * @brief Delay in ms before an uplink request the modem refused as busy is made again
+ */
+#define TRACKER_UPLINK_RETRY_MS 1000
+
+/*!
+ * @brief Interval in s at which a GNSS scan is checked for a stable fix, the time-to-fix histogram resolution
+ */
+#define TRACKER_GNSS_POLL_S ( APP_GNSS_TTF_BUCKET_MS / 1000 )
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE TYPES -----------------------------------------------------------
  */
 
+/*!
+ * @brief Data rate limits and default custom ADR list of a region
+ */
+typedef struct
+{
+    const char* name;                           // NULL for a region without custom profile
+    uint8_t dr_min;
+    uint8_t dr_max;
+    uint8_t sf_dr0;                             // spreading factor of DR0
+    uint8_t adr_list[APP_LINK_ADR_LIST_LEN];
+} tracker_region_t;
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE VARIABLES -------------------------------------------------------
@@ -61,30 +102,90 @@ static ralf_t* modem_radio;
 /*!
  * @brief User application data
  */
-static uint8_t app_data_buffer[LORAWAN_APP_DATA_MAX_SIZE];
-static uint8_t app_data_len = 0;
-
-static uint8_t adr_custom_list_eu868_default[16] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }; // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
-static uint8_t adr_custom_list_us915_default[16] = { 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3 }; // SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
-static uint8_t adr_custom_list_au915_default[16] = { 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5 }; // SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
-static uint8_t adr_custom_list_as923_default[16] = { 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5 }; // SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
-static uint8_t adr_custom_list_kr920_default[16] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }; // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
-static uint8_t adr_custom_list_in865_default[16] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }; // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
-static uint8_t adr_custom_list_ru864_default[16] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }; // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
 
-static uint8_t tracker_scan_status = 0;
-static uint32_t tracker_scan_begin = 0;
+/*!
+ * @brief Data rate limits and default custom ADR list of the supported regions
+ */
+static const tracker_region_t tracker_regions[] = {
+    [SMTC_MODEM_REGION_EU_868] = { "EU868", LORAWAN_EU868_DR_MIN, LORAWAN_EU868_DR_MAX, 12,
+                                   { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }}, // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
+    [SMTC_MODEM_REGION_US_915] = { "US915", LORAWAN_US915_DR_MIN, LORAWAN_US915_DR_MAX, 10,
+                                   { 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3 }}, // SF9,SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
+    [SMTC_MODEM_REGION_AU_915] = { "AU915", LORAWAN_AU915_DR_MIN, LORAWAN_AU915_DR_MAX, 12,
+                                   { 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5 }}, // SF9,SF9,SF9,SF9,SF9,SF9,SF8,SF8,SF8,SF8,SF8,SF7,SF7,SF7,SF7,SF7
+    [SMTC_MODEM_REGION_AS_923_GRP1] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_GRP2] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_GRP3] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_GRP4] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_HELIUM_1] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_HELIUM_2] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_HELIUM_3] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_HELIUM_4] = REGION_AS923,
+    [SMTC_MODEM_REGION_AS_923_HELIUM_1B] = REGION_AS923,
+    [SMTC_MODEM_REGION_KR_920] = { "KR920", LORAWAN_KR920_DR_MIN, LORAWAN_KR920_DR_MAX, 12,
+                                   { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }}, // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
+    [SMTC_MODEM_REGION_IN_865] = { "IN865", LORAWAN_IN865_DR_MIN, LORAWAN_IN865_DR_MAX, 12,
+                                   { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }}, // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
+    [SMTC_MODEM_REGION_RU_864] = { "RU864", LORAWAN_RU864_DR_MIN, LORAWAN_RU864_DR_MAX, 12,
+                                   { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5 }}, // SF12,SF12,SF12,SF11,SF11,SF11,SF10,SF10,SF10,SF9,SF9,SF9,SF8,SF8,SF7,SF7
+};
+
+// Custom ADR list following the measured link, once joined with a custom profile
+static app_link_policy_t tracker_link;
+static bool tracker_link_adaptive = false;
+
+static app_scan_plan_ctx_t tracker_scan_plan;
+static const app_scan_plan_t* tracker_run_plan = NULL;     // plan of the run in progress
+
+static app_scan_topk_t tracker_wifi_topk;
+
+// Wi-Fi place of the pending scan, sent alone once the server knows it
+static app_wifi_place_cache_t tracker_wifi_places;
+static uint8_t tracker_wifi_place = 0;
+static bool tracker_wifi_place_known = false;
+
+static app_track_codec_t tracker_track_codec;
+// A delta fix only follows a fix that went out: acked, or sent unconfirmed
+static bool tracker_track_ref_delivered = false;
+
+// Reporting interval follows the motion of the asset, tracker_periodic_interval while moving
+static app_motion_policy_t tracker_motion;
+static uint32_t tracker_report_interval = 0;
+static uint32_t tracker_motion_sample_ms = 0;
+
+// Periodic reports start in a slot of the interval given by the DevEUI, once the clock is synced
+static app_report_slot_t tracker_report_slot;
+
+// SOS press waiting for the main loop, then the emergency uplink until its TX done
+static volatile bool tracker_emergency_pending = false;
+static volatile uint32_t tracker_emergency_press_ms = 0;
+static bool tracker_emergency_active = false;
+static uint32_t tracker_emergency_latency_max_ms = 0;
+
+// Uplinks waiting for the duty cycle, and the one in flight until its TX done
+static app_uplink_queue_t tracker_uplink_queue;
+static app_uplink_t tracker_uplink_inflight;
+static bool tracker_uplink_busy = false;
+
+// Log records carried by the queued or in flight backfill uplink, removed once it is delivered
+static uint32_t tracker_backfill_seq[APP_FIX_LOG_CAPACITY];
+static uint8_t tracker_backfill_num = 0;
+
+// Records that should have gone to the fix log but did not fit in its write queue, since boot
+static uint32_t tracker_fix_log_lost = 0;
 
 uint8_t tracker_scan_type = 0;
 
 uint32_t gnss_scan_duration = 30;            // in second
 uint32_t wifi_scan_duration = 3;            // in second
 uint32_t ble_scan_duration = 3;             // in second
-uint32_t tracker_periodic_interval = 60;    // in minute
+uint32_t tracker_periodic_interval = 60;    // in second, reporting interval while moving
 
 uint8_t wifi_scan_max = 3;
 uint8_t ble_scan_max = 3;
 
+int8_t ble_scan_rssi_min = -80;             // in dBm, scans end early once ble_scan_max results reach it
+
 uint8_t tracker_acc_en = 0;
 
 bool adr_user_enable = true;
@@ -94,12 +195,30 @@ uint8_t adr_custom_list_region[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 
 uint8_t packet_policy = RETRY_STATE_1N;
 
+uint8_t backfill_policy = APP_FIX_LOG_NEWEST_FIRST;    // order in which logged records are backfilled
+
 bool duty_cycle_enable = true;
 
+// BLE and Wi-Fi stages at the same time, taken at the start of each run
+bool scan_concurrent_enable = APP_SCAN_PLAN_CONCURRENT_DEFAULT;
+
+// Radio windows that pause the iBeacon, APP_RADIO_COEX_MASK() bits
+uint8_t coex_suspend_mask = APP_RADIO_COEX_DEFAULT_SUSPEND_MASK;
+
+// Company IDs allowed by the BLE scan, TRACKER_BLE_ALLOW_NONE for an unused entry
+uint16_t ble_allow_company[APP_BLE_SCAN_FILTER_COMPANY_MAX] = {
+    TRACKER_BLE_ALLOW_NONE, TRACKER_BLE_ALLOW_NONE, TRACKER_BLE_ALLOW_NONE, TRACKER_BLE_ALLOW_NONE
+};
+
+// iBeacon proximity UUIDs allowed by the BLE scan, set at build time, all zero for an unused entry
+static const uint8_t tracker_ble_allow_uuid[APP_BLE_SCAN_FILTER_UUID_MAX][16] = { { 0 } };
+
 uint8_t tracker_test_mode = 0;
 
 uint8_t tracker_gps_scan_len = 0;
 uint8_t tracker_gps_scan_data[64] = { 0 };
+int32_t tracker_gps_scan_lat = 0;           // position of tracker_gps_scan_data, in 1e-6 degree
+int32_t tracker_gps_scan_lon = 0;
 
 uint8_t tracker_wifi_scan_len = 0;
 uint8_t tracker_wifi_scan_data[64] = { 0 };
@@ -107,7 +226,6 @@ uint8_t tracker_wifi_scan_data[64] = { 0 };
 uint8_t tracker_ble_scan_len = 0;
 uint8_t tracker_ble_scan_data[64] = { 0 };
 
-uint8_t tracker_scan_temp_len = 0;
 uint8_t tracker_scan_data_temp[64] = { 0 };
 
 bool scan_result = false;
@@ -158,6 +276,13 @@ static void on_modem_network_joined( void );
  */
 static void on_modem_alarm( void );
 
+/*!
+ * @brief Application layer clock sync event callback
+ *
+ * @param [in] status Time status @ref smtc_modem_event_time_status_t
+ */
+static void on_modem_time_updated_alc_sync( smtc_modem_event_time_status_t status );
+
 /*!
  * @brief Tx done event callback
  *
@@ -183,6 +308,166 @@ static void on_modem_down_data( int8_t rssi, int8_t snr, smtc_modem_event_downda
  */
 static void app_tracker_scan_process( void );
 
+/*!
+ * @brief Send the next queued uplink once the duty cycle allows it, called from the main loop
+ *
+ * @returns Time in ms until it has to be called again, 0 right after an uplink request
+ */
+static uint32_t app_tracker_uplink_service( void );
+
+/*!
+ * @brief Check the accelerometer every APP_MOTION_SAMPLE_S, called from the main loop
+ *
+ * Starts a report at once when the asset starts moving after a rest.
+ *
+ * @returns Time in ms until it has to be called again
+ */
+static uint32_t app_tracker_motion_service( void );
+
+/*!
+ * @brief Send the emergency uplink of an SOS press, called from the main loop
+ *
+ * The running scan is stopped and the last known fix goes out at once with fresh
+ * sensor data, a run for a fresh fix follows the emergency uplink.
+ */
+static void app_tracker_emergency_service( void );
+
+/*!
+ * @brief Sample the sensors into the fields shared by every record
+ */
+static void app_tracker_sensors_sample( app_uplink_values_t* values );
+
+/*!
+ * @brief Current GPS time from the modem
+ *
+ * @returns GPS time in s, 0 while the clock is not synced
+ */
+static uint32_t app_tracker_gps_time_s( void );
+
+/*!
+ * @brief Rebuild the track fix record of an uplink as a keyframe
+ *
+ * @param [in] uplink Uplink, its first record is the track fix
+ * @param [in] record Track fix record
+ * @param [in] len Record length
+ * @param [out] buf Keyframe record
+ * @param [in] size Size of buf
+ *
+ * @returns Length of the keyframe record, 0 if it could not be built
+ */
+static uint8_t app_tracker_track_keyframe( const app_uplink_t* uplink, const uint8_t* record, uint8_t len,
+                                           uint8_t* buf, uint8_t size );
+
+/*!
+ * @brief Follow-up of a delivered report: Wi-Fi place and one backfill frame when the log holds records
+ *
+ * @param [in] uplink Delivered report
+ */
+static void app_tracker_report_delivered( const app_uplink_t* uplink );
+
+/*!
+ * @brief End the emergency of an uplink that is done with, sent or not, and start the run for a fresh fix
+ *
+ * @param [in] uplink Uplink done with, nothing happens unless it is the emergency uplink
+ */
+static void app_tracker_emergency_release( const app_uplink_t* uplink );
+
+/*!
+ * @brief Start a tracking run now, unless one is in progress
+ *
+ * @param [in] event Event state bits reported by the run
+ */
+static void app_tracker_run_request( uint8_t event );
+
+/*!
+ * @brief Take back an uplink that will not be delivered, its scan records go to the fix log
+ */
+static void app_tracker_uplink_dropped( const app_uplink_t* uplink );
+
+/*!
+ * @brief Queue one frame of logged records, newest or oldest first by backfill_policy
+ *
+ * Each record goes with its GPS time on 4 bytes, then its uplink record as first sent.
+ * The records leave the log once the uplink is delivered.
+ */
+static void app_tracker_backfill_queue( void );
+
+/*!
+ * @brief Scan plan engine hooks
+ */
+static void app_tracker_plan_scan_begin( uint8_t tech );
+static bool app_tracker_plan_scan_end( uint8_t tech );
+static void app_tracker_plan_scan_abort( uint8_t tech );
+static bool app_tracker_plan_scan_ready( uint8_t tech );
+static uint32_t app_tracker_plan_scan_poll( uint8_t tech );
+static uint32_t app_tracker_plan_scan_duration( uint8_t tech );
+static void app_tracker_plan_alarm_start( uint32_t delay_s );
+
+/*!
+ * @brief Set the custom ADR profile and the duty cycle of the joined region
+ */
+static void app_tracker_region_setup( void );
+
+/*!
+ * @brief Check whether a scan type runs GNSS scans
+ */
+static bool app_tracker_scan_uses_gnss( uint8_t scan_type );
+
+/*!
+ * @brief Check the configuration set by a batch as a whole
+ *
+ * @returns false if the worst case scan plan does not fit in the reporting interval
+ */
+static bool app_tracker_config_check( void );
+
+/*!
+ * @brief Apply a configuration batch received by downlink and queue its acknowledgement
+ */
+static void app_tracker_config_receive( const uint8_t* payload, uint8_t size );
+
+static const app_scan_plan_ops_t tracker_scan_plan_ops = {
+    .scan_begin = app_tracker_plan_scan_begin,
+    .scan_end = app_tracker_plan_scan_end,
+    .scan_abort = app_tracker_plan_scan_abort,
+    .scan_ready = app_tracker_plan_scan_ready,
+    .scan_poll_s = app_tracker_plan_scan_poll,
+    .scan_duration = app_tracker_plan_scan_duration,
+    .alarm_start = app_tracker_plan_alarm_start,
+    .time_s = hal_rtc_get_time_s,
+};
+
+/*!
+ * @brief Parameters set by downlink on LORAWAN_CONFIG_PORT, tags are part of the server interface
+ */
+static const app_config_param_t tracker_config_params[] = {
+    { 0x01, sizeof( tracker_scan_type ), false, &tracker_scan_type, TRACKER_SCAN_GNSS_ONLY, TRACKER_SCAN_BLE_WIFI_GNSS },
+    { 0x02, sizeof( tracker_periodic_interval ), false, &tracker_periodic_interval, 30, 604800 },
+    { 0x03, sizeof( gnss_scan_duration ), false, &gnss_scan_duration, 10, 300 },
+    { 0x04, sizeof( wifi_scan_duration ), false, &wifi_scan_duration, 1, 30 },
+    { 0x05, sizeof( ble_scan_duration ), false, &ble_scan_duration, 1, 30 },
+    { 0x06, sizeof( wifi_scan_max ), false, &wifi_scan_max, 1, APP_SCAN_TOPK_MAX },
+    { 0x07, sizeof( ble_scan_max ), false, &ble_scan_max, 1, APP_SCAN_TOPK_MAX },
+    { 0x09, sizeof( ble_scan_rssi_min ), true, &ble_scan_rssi_min, INT8_MIN, 0 },
+    { 0x0A, sizeof( tracker_acc_en ), false, &tracker_acc_en, 0, 1 },
+    { 0x0B, sizeof( adr_user_enable ), false, &adr_user_enable, 0, 1 },
+    { 0x0C, sizeof( adr_user_dr_min ), false, &adr_user_dr_min, 0, 15 },
+    { 0x0D, sizeof( adr_user_dr_max ), false, &adr_user_dr_max, 0, 15 },
+    { 0x0E, sizeof( backfill_policy ), false, &backfill_policy, APP_FIX_LOG_NEWEST_FIRST, APP_FIX_LOG_OLDEST_FIRST },
+    { 0x0F, sizeof( duty_cycle_enable ), false, &duty_cycle_enable, 0, 1 },
+    { 0x10, sizeof( ble_allow_company[0] ), false, &ble_allow_company[0], 0, TRACKER_BLE_ALLOW_NONE },
+    { 0x11, sizeof( ble_allow_company[1] ), false, &ble_allow_company[1], 0, TRACKER_BLE_ALLOW_NONE },
+    { 0x12, sizeof( ble_allow_company[2] ), false, &ble_allow_company[2], 0, TRACKER_BLE_ALLOW_NONE },
+    { 0x13, sizeof( ble_allow_company[3] ), false, &ble_allow_company[3], 0, TRACKER_BLE_ALLOW_NONE },
+    { 0x14, sizeof( coex_suspend_mask ), false, &coex_suspend_mask, 0, APP_RADIO_COEX_ALL_MASK },
+    { 0x15, sizeof( scan_concurrent_enable ), false, &scan_concurrent_enable, 0, 1 },
+};
+
+static const app_config_table_t tracker_config = {
+    .params = tracker_config_params,
+    .param_num = sizeof( tracker_config_params ) / sizeof( tracker_config_params[0] ),
+    .check = app_tracker_config_check,
+};
+
 /*!
  * @}
  */
@@ -210,7 +495,7 @@ int main( void )
         .reset                 = on_modem_reset,
         .set_conf              = NULL,
         .stream_done           = NULL,
-        .time_updated_alc_sync = NULL,
+        .time_updated_alc_sync = on_modem_time_updated_alc_sync,
         .tx_done               = on_modem_tx_done,
         .upload_done           = NULL,
     };
@@ -220,9 +505,15 @@ int main( void )
 
     /* Init board and peripherals */
     hal_mcu_init( );
+    app_fds_store_register( );
     fds_init_write( );
+    app_fix_log_init( );
+    app_track_codec_init( &tracker_track_codec, APP_TRACK_QUANT_DEFAULT, APP_TRACK_KEY_INTERVAL_DEFAULT );
+    app_uplink_queue_init( &tracker_uplink_queue );
     smtc_board_init_periph( );
     app_lora_packet_params_load( );
+    // The last configuration batch received by downlink takes over the parameters the parameter store did not save since
+    app_config_batch_restore( &tracker_config );
 
     ret_code_t err_code;
     err_code = app_timer_init( );
@@ -234,21 +525,30 @@ int main( void )
     app_user_button_init( );
     app_ble_all_init( );
     app_ble_beacon_init( );  // Initialize iBeacon functionality
+    app_ble_scan_filter_init( );
+    app_radio_coex_init( );
+    app_radio_coex_set_suspend_mask( coex_suspend_mask );
+    app_scan_plan_init( &tracker_scan_plan, &tracker_scan_plan_ops );
+    app_motion_policy_init( &tracker_motion );
+    app_wifi_place_init( &tracker_wifi_places );
+    app_wifi_place_restore( &tracker_wifi_places );
     app_led_init( );
     app_beep_init( );
 
     app_beep_boot_up( );
 
-    if( tracker_scan_type == TRACKER_SCAN_GNSS_ONLY 
-        || tracker_scan_type == TRACKER_SCAN_WIFI_GNSS 
-        || tracker_scan_type == TRACKER_SCAN_GNSS_WIFI 
-        || tracker_scan_type == TRACKER_SCAN_BLE_GNSS 
-        || tracker_scan_type == TRACKER_SCAN_BLE_WIFI_GNSS )
+    // Last fix and learned scan window survive warm resets in retained RAM
+    bool gnss_warm = app_gnss_fix_init( );
+
+    if( app_tracker_scan_uses_gnss( tracker_scan_type ))
     {
         gnss_init( );
-        gnss_scan_start( );
-        hal_mcu_wait_ms( 3000 );
-        gnss_scan_stop( );
+        if( !gnss_warm ) // the blind first run is only needed from cold
+        {
+            gnss_scan_start( );
+            hal_mcu_wait_ms( 3000 );
+            gnss_scan_stop( );
+        }
     }
 
     if( tracker_acc_en )
@@ -278,6 +578,16 @@ APP_MAIN:
     {
         /* Execute modem runtime, this function must be called again in sleep_time_ms milliseconds or sooner. */
         uint32_t sleep_time_ms = smtc_modem_run_engine( );
+        /* An SOS press preempts everything else */
+        app_tracker_emergency_service( );
+        /* Send queued uplinks as soon as the duty cycle allows, wake up for it */
+        uint32_t uplink_wait_ms = app_tracker_uplink_service( );
+        if( uplink_wait_ms < sleep_time_ms ) sleep_time_ms = uplink_wait_ms;
+        /* Keep the stored configuration batch in line with the parameter store */
+        app_config_batch_sync( &tracker_config );
+        /* Wake up for the next accelerometer check */
+        uint32_t motion_wait_ms = app_tracker_motion_service( );
+        if( motion_wait_ms < sleep_time_ms ) sleep_time_ms = motion_wait_ms;
         /* go in low power */
         hal_mcu_set_sleep_for_ms( sleep_time_ms );
     }
@@ -298,6 +608,15 @@ static void on_modem_reset( uint16_t reset_count )
     HAL_DBG_TRACE_INFO( "  - LoRaWAN uplink Fport = %d\n", LORAWAN_APP_PORT );
     HAL_DBG_TRACE_INFO( "  - Confirmed uplink     = %s\n", ( LORAWAN_CONFIRMED_MSG_ON == true ) ? "Yes" : "No" );
 
+    // No TX done comes for an uplink lost in the reset
+    if( tracker_uplink_busy )
+    {
+        tracker_uplink_busy = false;
+        app_tracker_uplink_dropped( &tracker_uplink_inflight );
+    }
+    // Runs start again after the join
+    tracker_emergency_active = false;
+
     apps_modem_common_configure_lorawan_params( stack_id );
 
     uint8_t ativation_mode;
@@ -313,222 +632,58 @@ static void on_modem_reset( uint16_t reset_count )
     }
 }
 
-static void custom_lora_adr_compute( uint8_t min, uint8_t max, uint8_t *buf )
+static const tracker_region_t* app_tracker_region_get( smtc_modem_region_t region )
 {
-    uint8_t temp = max - min + 1;
-    uint8_t num = 16 / temp;
-    uint8_t remain = 16 % temp;
-    uint8_t offset = 0;
-
-    for( uint8_t i = 0; i < temp; i++ )
+    if(( uint32_t )region >= sizeof( tracker_regions ) / sizeof( tracker_regions[0] )
+       || tracker_regions[region].name == NULL )
     {
-        for( uint8_t j = 0; j < num; j++ )
-        {
-            buf[i * num + j + offset] = min + i;
-        }
+        return NULL;
+    }
+    return &tracker_regions[region];
+}
 
-        if(( 16 % temp != 0 ) && ( i < remain ))
-        {
-            buf[( i + 1 ) * num + offset] = min + i;
-            offset += 1;
-        }
+static void app_tracker_link_apply( void )
+{
+    HAL_DBG_TRACE_PRINTF( "link policy: from DR%d, nb_trans %d\n", tracker_link.dr_low, tracker_link.nb_trans );
+    if( app_link_policy_get_list( &tracker_link, adr_custom_list_region ))
+    {
+        ASSERT_SMTC_MODEM_RC( smtc_modem_adr_set_profile( stack_id, SMTC_MODEM_ADR_PROFILE_CUSTOM, adr_custom_list_region ));
     }
+    ASSERT_SMTC_MODEM_RC( smtc_modem_set_nb_trans( stack_id, tracker_link.nb_trans ));
 }
 
-static void on_modem_network_joined( void )
+static void app_tracker_region_setup( void )
 {
     smtc_modem_region_t region;
     ASSERT_SMTC_MODEM_RC( smtc_modem_get_region( stack_id, &region ));
 
-    if( app_led_state != APP_LED_BLE_CFG )
-    {
-        uint8_t ativation_mode;
-        ativation_mode = smtc_modem_get_activation_mode( stack_id );
-        if( ativation_mode == 0 ) // OTAA
-        {
-            app_beep_joined( );
-            app_led_breathe_stop( );
-            app_led_lora_joined( );
-        }
-    }
-
+    // A batch enabling the network ADR leaves the custom list in the modem until the next join
+    tracker_link_adaptive = false;
     if( adr_user_enable == false )
     {
         /* Set the ADR profile based on selected region */
-        switch( region )
-        {
-            case SMTC_MODEM_REGION_EU_868:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for EU868\n" );
-                if( adr_user_dr_min >= LORAWAN_EU868_DR_MIN && adr_user_dr_max <= LORAWAN_EU868_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_eu868_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_eu868_default, 16 );
-                }
-            break;
-
-            case SMTC_MODEM_REGION_US_915:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for US915\n" );
-                if( adr_user_dr_min >= LORAWAN_US915_DR_MIN && adr_user_dr_max <= LORAWAN_US915_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_us915_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_us915_default, 16 );
-                }
-            break;
-
-            case SMTC_MODEM_REGION_AU_915:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for AU915\n" );
-                if( adr_user_dr_min >= LORAWAN_AU915_DR_MIN && adr_user_dr_max <= LORAWAN_AU915_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_au915_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_au915_default, 16 );
-                }
-            break;
-
-            case SMTC_MODEM_REGION_AS_923_GRP1:
-            case SMTC_MODEM_REGION_AS_923_GRP2:
-            case SMTC_MODEM_REGION_AS_923_GRP3:
-            case SMTC_MODEM_REGION_AS_923_GRP4:
-            case SMTC_MODEM_REGION_AS_923_HELIUM_1:
-            case SMTC_MODEM_REGION_AS_923_HELIUM_2:
-            case SMTC_MODEM_REGION_AS_923_HELIUM_3:
-            case SMTC_MODEM_REGION_AS_923_HELIUM_4:
-            case SMTC_MODEM_REGION_AS_923_HELIUM_1B:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for AS923\n" );
-                if( adr_user_dr_min >= LORAWAN_AS923_DR_MIN && adr_user_dr_max <= LORAWAN_AS923_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_as923_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_as923_default, 16 );
-                }
-            break;
-
-            case SMTC_MODEM_REGION_KR_920:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for KR920\n" );
-                if( adr_user_dr_min >= LORAWAN_KR920_DR_MIN && adr_user_dr_max <= LORAWAN_KR920_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_kr920_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_kr920_default, 16 );
-                }
-            break;
-
-            case SMTC_MODEM_REGION_IN_865:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for IN865\n" );
-                if( adr_user_dr_min >= LORAWAN_IN865_DR_MIN && adr_user_dr_max <= LORAWAN_IN865_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_in865_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_in865_default, 16 );
-                }
-            break;
+        const tracker_region_t* profile = app_tracker_region_get( region );
 
-            case SMTC_MODEM_REGION_RU_864:
-                HAL_DBG_TRACE_INFO( "Set ADR profile for RU864\n" );
-                if( adr_user_dr_min >= LORAWAN_RU864_DR_MIN && adr_user_dr_max <= LORAWAN_RU864_DR_MAX )
-                {
-                    if( adr_user_dr_min == adr_user_dr_max )
-                    {
-                        memset( adr_custom_list_region, adr_user_dr_min, 16 );
-                    }
-                    else if( adr_user_dr_min > adr_user_dr_max )
-                    {
-                        memcpy( adr_custom_list_region, adr_custom_list_ru864_default, 16 );
-                    }
-                    else
-                    {
-                        custom_lora_adr_compute( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
-                    }
-                }
-                else
-                {
-                    memcpy( adr_custom_list_region, adr_custom_list_ru864_default, 16 );
-                }
-            break;
-
-            default:
-                HAL_DBG_TRACE_ERROR( "Region not supported in this example, could not set custom ADR profile\n" );
-            break;
+        if( profile == NULL )
+        {
+            HAL_DBG_TRACE_ERROR( "Region not supported in this example, could not set custom ADR profile\n" );
+        }
+        else
+        {
+            HAL_DBG_TRACE_INFO( "Set ADR profile for %s\n", profile->name );
+            if( adr_user_dr_min >= profile->dr_min && adr_user_dr_max <= profile->dr_max
+                && adr_user_dr_min <= adr_user_dr_max )
+            {
+                app_link_adr_list( adr_user_dr_min, adr_user_dr_max, adr_custom_list_region );
+                app_link_policy_init( &tracker_link, adr_user_dr_min, adr_user_dr_max, profile->sf_dr0, adr_custom_list_region );
+            }
+            else
+            {
+                memcpy( adr_custom_list_region, profile->adr_list, sizeof( profile->adr_list ));
+                app_link_policy_init( &tracker_link, profile->dr_min, profile->dr_max, profile->sf_dr0, adr_custom_list_region );
+            }
+            // The list then follows the downlink SNR and the confirmed uplinks
+            tracker_link_adaptive = true;
         }
 
         HAL_DBG_TRACE_PRINTF( "User ADR list: " ); // just for test
@@ -539,24 +694,46 @@ static void on_modem_network_joined( void )
         HAL_DBG_TRACE_PRINTF( "\r\n" ); // just for test
 
         ASSERT_SMTC_MODEM_RC( smtc_modem_adr_set_profile( stack_id, SMTC_MODEM_ADR_PROFILE_CUSTOM, adr_custom_list_region ));
-        // ASSERT_SMTC_MODEM_RC( smtc_modem_set_nb_trans( stack_id, custom_nb_trans_region ));
     }
 
     switch( region )
     {
         case SMTC_MODEM_REGION_EU_868:
         case SMTC_MODEM_REGION_RU_864:
-            if( duty_cycle_enable == false )
-            {
-                smtc_modem_set_region_duty_cycle( stack_id, false );
-                modem_set_duty_cycle_disabled_by_host( true );
-            }
+            smtc_modem_set_region_duty_cycle( stack_id, duty_cycle_enable );
+            modem_set_duty_cycle_disabled_by_host( !duty_cycle_enable );
         break;
 
         default:
         break;
     }
 
+}
+
+static void on_modem_network_joined( void )
+{
+    if( app_led_state != APP_LED_BLE_CFG )
+    {
+        uint8_t ativation_mode;
+        ativation_mode = smtc_modem_get_activation_mode( stack_id );
+        if( ativation_mode == 0 ) // OTAA
+        {
+            app_beep_joined( );
+            app_led_breathe_stop( );
+            app_led_lora_joined( );
+        }
+    }
+
+    app_tracker_region_setup( );
+
+    uint8_t dev_eui[APP_REPORT_SLOT_EUI_LEN] = { 0 };
+    ASSERT_SMTC_MODEM_RC( smtc_modem_get_deveui( stack_id, dev_eui ));
+    app_report_slot_init( &tracker_report_slot, dev_eui );
+
+    // GPS time for the fixes and the report slots, the modem keeps it from one sync to the next
+    ASSERT_SMTC_MODEM_RC( smtc_modem_time_set_sync_interval_s( TRACKER_TIME_SYNC_INTERVAL_S ));
+    ASSERT_SMTC_MODEM_RC( smtc_modem_time_start_sync_service( stack_id, SMTC_MODEM_TIME_ALC_SYNC ));
+
     app_led_bat_new_detect( 3000 );
 
     app_lora_packet_power_on_uplink( );
@@ -576,13 +753,72 @@ static void on_modem_alarm( void )
     app_tracker_scan_process( );
 }
 
+static void on_modem_time_updated_alc_sync( smtc_modem_event_time_status_t status )
+{
+    switch( status )
+    {
+        case SMTC_MODEM_EVENT_TIME_VALID:
+            HAL_DBG_TRACE_INFO( "time: synced, GPS time %u s\n", app_tracker_gps_time_s( ));
+            break;
+
+        case SMTC_MODEM_EVENT_TIME_VALID_BUT_NOT_SYNC:
+            HAL_DBG_TRACE_WARNING( "time: sync missed, GPS time %u s kept\n", app_tracker_gps_time_s( ));
+            break;
+
+        default:
+            // Fixes go out without a timestamp and reports without a slot until the next sync
+            HAL_DBG_TRACE_WARNING( "time: not valid\n" );
+            break;
+    }
+}
+
 static void on_modem_tx_done( smtc_modem_event_txdone_status_t status )
 {
     static uint32_t uplink_count = 0;
+    bool emergency_done = false;
     HAL_DBG_TRACE_INFO( "Uplink count: %d\n", ++uplink_count );
 
-    // Resume iBeacon advertising after LoRaWAN transmission
-    app_ble_beacon_start( );
+    // Uplink window is over, iBeacon resumes with its existing configuration
+    app_radio_coex_window_close( APP_RADIO_COEX_LORA_UPLINK );
+
+    if( tracker_uplink_busy )
+    {
+        const app_uplink_t* uplink = &tracker_uplink_inflight;
+        // An unconfirmed uplink that went out counts as delivered, asking the network for evidence of each
+        // one would cost a downlink per report and drain the gateway duty cycle
+        bool delivered = ( status == SMTC_MODEM_EVENT_TXDONE_CONFIRMED )
+                         || ( status == SMTC_MODEM_EVENT_TXDONE_SENT && !uplink->confirmed );
+
+        tracker_uplink_busy = false;
+        // Only a confirmed uplink that went out tells whether the link holds
+        if( tracker_link_adaptive && uplink->confirmed && status != SMTC_MODEM_EVENT_TXDONE_NOT_SENT
+            && app_link_policy_confirmed( &tracker_link, status == SMTC_MODEM_EVENT_TXDONE_CONFIRMED ))
+        {
+            app_tracker_link_apply( );
+        }
+        if( !delivered )
+        {
+            app_tracker_uplink_dropped( uplink );
+        }
+        else if( uplink->prio == APP_UPLINK_PRIO_BACKFILL )
+        {
+            for( uint8_t i = 0; i < tracker_backfill_num; i++ )
+            {
+                app_fix_log_remove( tracker_backfill_seq[i] );
+            }
+            HAL_DBG_TRACE_PRINTF( "backfill: %d record(s) delivered, %d left\n", tracker_backfill_num, app_fix_log_count( ));
+            tracker_backfill_num = 0;
+        }
+        else
+        {
+            app_tracker_report_delivered( uplink );
+        }
+        if( uplink->emergency )
+        {
+            HAL_DBG_TRACE_INFO( "emergency: TX done %u ms after the press\n", hal_rtc_get_time_ms( ) - uplink->queued_ms );
+            emergency_done = true;
+        }
+    }
 
     if( status == SMTC_MODEM_EVENT_TXDONE_CONFIRMED )
     {
@@ -592,6 +828,12 @@ static void on_modem_tx_done( smtc_modem_event_txdone_status_t status )
         }
     }
     event_state = 0;
+
+    // The last known fix is out, a fresh one follows, the beacon stays in emergency mode until the next periodic report
+    if( emergency_done )
+    {
+        app_tracker_emergency_release( &tracker_uplink_inflight );
+    }
 }
 
 static void on_modem_down_data( int8_t rssi, int8_t snr, smtc_modem_event_downdata_window_t rx_window, uint8_t port,
@@ -603,6 +845,11 @@ static void on_modem_down_data( int8_t rssi, int8_t snr, smtc_modem_event_downda
     HAL_DBG_TRACE_INFO( "  - RSSI          = %d dBm\n", rssi - 64 );
     HAL_DBG_TRACE_INFO( "  - SNR           = %d dB\n", snr >> 2 );
 
+    if( tracker_link_adaptive && app_link_policy_downlink( &tracker_link, snr ))
+    {
+        app_tracker_link_apply( );
+    }
+
     switch( rx_window )
     {
         case SMTC_MODEM_EVENT_DOWNDATA_WINDOW_RX1:
@@ -630,6 +877,32 @@ static void on_modem_down_data( int8_t rssi, int8_t snr, smtc_modem_event_downda
         {
             app_lora_packet_downlink_decode( payload, size );
         }
+        else if( port == LORAWAN_CONFIG_PORT )
+        {
+            app_tracker_config_receive( payload, size );
+        }
+    }
+}
+
+static void app_tracker_ble_allowlist_setup( void )
+{
+    static const uint8_t uuid_none[16] = { 0 };
+
+    // Rebuilt at every scan, a configuration batch may have changed the company IDs
+    app_ble_scan_filter_clear_allowlist( );
+    for( uint8_t i = 0; i < APP_BLE_SCAN_FILTER_UUID_MAX; i++ )
+    {
+        if( memcmp( tracker_ble_allow_uuid[i], uuid_none, sizeof( uuid_none )) != 0 )
+        {
+            app_ble_scan_filter_add_uuid( tracker_ble_allow_uuid[i] );
+        }
+    }
+    for( uint8_t i = 0; i < APP_BLE_SCAN_FILTER_COMPANY_MAX; i++ )
+    {
+        if( ble_allow_company[i] != TRACKER_BLE_ALLOW_NONE )
+        {
+            app_ble_scan_filter_add_company( ble_allow_company[i] );
+        }
     }
 }
 
@@ -637,16 +910,25 @@ static void app_tracker_ble_scan_begin( void )
 {
     tracker_ble_scan_len = 0;
     memset( tracker_ble_scan_data, 0, sizeof( tracker_ble_scan_data ));
+    app_tracker_ble_allowlist_setup( );
+    app_radio_coex_window_open( APP_RADIO_COEX_BLE_SCAN );
+    app_ble_scan_filter_start( ble_scan_max );
     ble_scan_start( );
 }
 
 static void app_tracker_ble_scan_end( void )
 {
+    app_ble_scan_filter_stats_t filter_stats;
+
     ble_scan_stop( );
-    ble_get_results( tracker_ble_scan_data, &tracker_ble_scan_len );
-    ble_display_results( );
-    uint8_t len_max = ble_scan_max * 7;
-    if( tracker_ble_scan_len > len_max ) tracker_ble_scan_len = len_max;
+    app_ble_scan_filter_stop( );
+    app_radio_coex_window_close( APP_RADIO_COEX_BLE_SCAN );
+    // The scan filter already kept the strongest ble_scan_max allowed beacons
+    tracker_ble_scan_len = app_ble_scan_filter_get_results( tracker_ble_scan_data );
+    app_ble_scan_filter_get_stats( &filter_stats );
+    HAL_DBG_TRACE_PRINTF( "ble seen %u, accepted %u (rssi %u, dup %u, allowlist %u dropped)\n",
+                          filter_stats.seen, filter_stats.accepted, filter_stats.rssi_dropped,
+                          filter_stats.dup_dropped, filter_stats.allowlist_dropped );
     if( tracker_ble_scan_len ) scan_result_num ++;
     if( scan_result_num > 3 ) scan_result_num = 3;
     if( tracker_test_mode == 0 && tracker_ble_scan_len ) scan_result = true;    
@@ -655,17 +937,28 @@ static void app_tracker_ble_scan_end( void )
 static void app_tracker_wifi_scan_begin( void )
 {
     tracker_wifi_scan_len = 0;
+    tracker_wifi_place = 0;
     memset( tracker_wifi_scan_data, 0, sizeof( tracker_wifi_scan_data ));
+    app_scan_topk_init( &tracker_wifi_topk, wifi_scan_max );
+    app_radio_coex_window_open( APP_RADIO_COEX_WIFI_SCAN );
     wifi_scan_start( modem_radio );
 }
 
 static void app_tracker_wifi_scan_end( void )
 {
     wifi_scan_stop( modem_radio );
+    app_radio_coex_window_close( APP_RADIO_COEX_WIFI_SCAN );
     wifi_get_results( modem_radio, tracker_wifi_scan_data, &tracker_wifi_scan_len );
     wifi_display_results( );
-    uint8_t len_max = wifi_scan_max * 7;
-    if( tracker_wifi_scan_len > len_max ) tracker_wifi_scan_len = len_max;
+    // Keep the strongest wifi_scan_max access points of the whole scan, not the first ones heard
+    app_scan_topk_add_all( &tracker_wifi_topk, tracker_wifi_scan_data, tracker_wifi_scan_len );
+    tracker_wifi_scan_len = app_scan_topk_get( &tracker_wifi_topk, tracker_wifi_scan_data );
+    if( TRACKER_WIFI_PLACE_CACHE && tracker_wifi_scan_len )
+    {
+        tracker_wifi_place = app_wifi_place_lookup( &tracker_wifi_places, tracker_wifi_scan_data, tracker_wifi_scan_len,
+                                                    &tracker_wifi_place_known );
+        HAL_DBG_TRACE_PRINTF( "wifi place %d%s\n", tracker_wifi_place, tracker_wifi_place_known ? ", known" : "" );
+    }
     if( tracker_wifi_scan_len ) scan_result_num ++;
     if( scan_result_num > 3 ) scan_result_num = 3;
     if( tracker_test_mode == 0 && tracker_wifi_scan_len ) scan_result = true;
@@ -675,20 +968,48 @@ static void app_tracker_gnss_scan_begin( void )
 {
     tracker_gps_scan_len = 0;
     memset( tracker_gps_scan_data, 0, sizeof( tracker_gps_scan_data ));
+    app_radio_coex_window_open( APP_RADIO_COEX_GNSS_SCAN );
+
+    app_gnss_fix_begin( hal_rtc_get_time_ms( ));
     gnss_scan_start( );
 }
 
 static void app_tracker_gnss_scan_end( void )
 {
     static int32_t lat = 0, lon = 0;
+    app_gnss_fix_stats_t fix_stats;
+
     gnss_scan_stop( );
+    app_radio_coex_window_close( APP_RADIO_COEX_GNSS_SCAN );
+    app_gnss_fix_end( );
+    app_gnss_fix_get_stats( &fix_stats );
+    HAL_DBG_TRACE_PRINTF( "gnss fixes %u/%u, ttf last %u ms, mean %u ms, max %u ms\n", fix_stats.fixes,
+                          fix_stats.attempts, fix_stats.ttf_last_ms,
+                          fix_stats.fixes ? ( uint32_t )( fix_stats.ttf_sum_ms / fix_stats.fixes ) : 0,
+                          fix_stats.ttf_max_ms );
     if( gnss_get_fix_status( ))
     {
         gnss_get_position( &lat, &lon );
         HAL_DBG_TRACE_PRINTF( "lat: %u, lon: %u\n\n", lat, lon );
-        memcpyr( tracker_gps_scan_data, ( uint8_t *)&lon, 4 );
-        memcpyr( tracker_gps_scan_data + 4, ( uint8_t *)&lat, 4 );
-        tracker_gps_scan_len = 8;
+        if( TRACKER_GPS_TRACK_CODEC )
+        {
+            if( !tracker_track_ref_delivered ) app_track_codec_reset( &tracker_track_codec );
+            tracker_gps_scan_len = app_track_encode( &tracker_track_codec, lat, lon, tracker_gps_scan_data,
+                                                     sizeof( tracker_gps_scan_data ));
+            tracker_track_ref_delivered = false;
+        }
+        else
+        {
+            memcpyr( tracker_gps_scan_data, ( uint8_t *)&lon, 4 );
+            memcpyr( tracker_gps_scan_data + 4, ( uint8_t *)&lat, 4 );
+            tracker_gps_scan_len = 8;
+        }
+        tracker_gps_scan_lat = lat;
+        tracker_gps_scan_lon = lon;
+        app_ble_beacon_update_position( lat, lon );
+
+        app_gnss_fix_set_position( lat, lon, app_tracker_gps_time_s( ));
+        app_motion_policy_fix( &tracker_motion, lat, lon, hal_rtc_get_time_s( ));
     }
     else
     {
@@ -699,171 +1020,284 @@ static void app_tracker_gnss_scan_end( void )
     if( tracker_test_mode == 0 && tracker_gps_scan_len ) scan_result = true;
 }
 
-static void app_tracker_scan_result_send( void )
+/*!
+ * @brief Largest payload the next uplink can carry at the current data rate
+ */
+static uint8_t app_tracker_tx_max_payload( void )
 {
-    bool send_ok = false;
-    bool confirm = false;
-    int16_t temp = 0;
-    uint16_t light = 0;
-    int8_t battery = 0;
-    int16_t ax = 0, ay = 0, az = 0;
+    uint8_t tx_max_payload = 0;
 
-    if(( packet_policy == RETRY_STATE_1C ) || ( event_state == TRACKER_STATE_BIT8_USER ))
+    if( smtc_modem_get_next_tx_max_payload( stack_id, &tx_max_payload ) != SMTC_MODEM_RC_OK )
     {
-        confirm = true;
+        return 0;
     }
+    return tx_max_payload < LORAWAN_APP_DATA_MAX_SIZE ? tx_max_payload : LORAWAN_APP_DATA_MAX_SIZE;
+}
 
-    memset( tracker_scan_data_temp, 0, sizeof( tracker_scan_data_temp ));
-    tracker_scan_temp_len = 0;
-
-    battery = sensor_bat_sample( );
-    temp = sensor_ntc_sample( );
-    light = sensor_lux_sample( );
+/*!
+ * @brief Encode one record straight into an uplink, laid out by its app_uplink_schema entry
+ *
+ * The first record of a frame is always appended, app_tracker_uplink_service() deals
+ * with a frame too large for the data rate.
+ *
+ * @returns true if the record was appended
+ */
+static bool app_tracker_record_append( app_uplink_t* uplink, uint8_t packet_id, const app_uplink_values_t* values,
+                                       uint8_t tx_max_payload )
+{
+    const app_uplink_schema_t* schema = app_uplink_schema_find( packet_id );
+    uint8_t room = sizeof( uplink->data ) - uplink->len;
 
-    if( tracker_acc_en )
+    if( schema == NULL )
     {
-        qma6100p_read_raw_data( &ax, &ay, &az );
+        return false;
+    }
+    if( uplink->len > 0 )
+    {
+        room = uplink->len < tx_max_payload ? tx_max_payload - uplink->len : 0;
     }
 
-    // Update iBeacon with current sensor data
-    bool is_emergency = (event_state == TRACKER_STATE_BIT8_USER);
-    app_ble_beacon_update_sensor_data( battery, temp, light, ax, ay, az, is_emergency );
+    uint8_t len = app_uplink_schema_encode( schema, values, uplink->data + uplink->len, room );
+    if( len == 0 )
+    {
+        return false;
+    }
+    if( uplink->record_num < APP_UPLINK_RECORD_MAX )
+    {
+        uplink->record_at[uplink->record_num++] = uplink->len;
+    }
+    uplink->len += len;
+    return true;
+}
 
-    PRINTF( "tracker_gps_scan_len: %d\r\n", tracker_gps_scan_len );
-    PRINTF( "tracker_wifi_scan_len: %d\r\n", tracker_wifi_scan_len );
-    PRINTF( "tracker_ble_scan_len: %d\r\n", tracker_ble_scan_len );
-    PRINTF( "scan_result_num: %d\r\n", scan_result_num );
+static uint8_t app_tracker_track_keyframe( const app_uplink_t* uplink, const uint8_t* record, uint8_t len,
+                                           uint8_t* buf, uint8_t size )
+{
+    const app_uplink_schema_t* schema;
+    app_uplink_values_t values;
+    app_track_codec_t key_codec;
+    uint8_t fix[APP_TRACK_FIX_MAX];
 
-    if( tracker_gps_scan_len == 0 && tracker_wifi_scan_len == 0 && tracker_ble_scan_len == 0 )
+    if( app_uplink_schema_decode( record, len, &schema, &values ) == 0 )
     {
-        scan_result_num = 1;
-
-        if( tracker_acc_en )
-        {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_SEN_ACC_BAT;
-        }
-        else
-        {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_SEN_BAT;
-        }
-        
-        tracker_scan_data_temp[1] = event_state;
-        tracker_scan_data_temp[2] = battery;
-        memcpyr( tracker_scan_data_temp + 3, ( uint8_t *)( &temp ), 2 );
-        memcpyr( tracker_scan_data_temp + 5, ( uint8_t *)( &light ), 2 );
-        tracker_scan_temp_len += 7;
-
-        if( tracker_acc_en )
-        {
-            memcpyr( tracker_scan_data_temp + 7, ( uint8_t *)( &ax ), 2 );
-            memcpyr( tracker_scan_data_temp + 9, ( uint8_t *)( &ay ), 2 );
-            memcpyr( tracker_scan_data_temp + 11, ( uint8_t *)( &az ), 2 );
-            tracker_scan_temp_len += 6;
-        }
+        return 0;
+    }
+    app_track_codec_init( &key_codec, tracker_track_codec.quant_udeg, 0 );
+    values.location_len = app_track_encode( &key_codec, uplink->fix_lat, uplink->fix_lon, fix, sizeof( fix ));
+    values.location = fix;
+    return app_uplink_schema_encode( schema, &values, buf, size );
+}
 
-        send_ok = app_send_frame( tracker_scan_data_temp, tracker_scan_temp_len, confirm, false );
+static void app_tracker_uplink_dropped( const app_uplink_t* uplink )
+{
+    if( uplink->prio == APP_UPLINK_PRIO_BACKFILL )
+    {
+        // The records stay in the log for the next backfill frame
+        tracker_backfill_num = 0;
+        return;
+    }
+    if( uplink->record_num == 0 )
+    {
+        return;
     }
-    else if( tracker_gps_scan_len )
+
+    uint8_t kept = 0;
+
+    for( uint8_t i = 0; i < uplink->record_num; i++ )
     {
-        if( tracker_acc_en )
+        uint8_t end = ( i + 1 < uplink->record_num ) ? uplink->record_at[i + 1] : uplink->len;
+        const uint8_t* record = uplink->data + uplink->record_at[i];
+        uint8_t len = end - uplink->record_at[i];
+        uint8_t keyed[APP_FIX_LOG_DATA_MAX];
+
+        if( i == 0 && uplink->track_fix )
+        {
+            // A delta fix decodes only right after the fix before it, the log keeps it as a keyframe
+            len = app_tracker_track_keyframe( uplink, record, len, keyed, sizeof( keyed ));
+            record = keyed;
+        }
+        if( len && app_fix_log_append( uplink->time_s, record, len ))
         {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_GPS_SEN_ACC_BAT;
+            kept++;
         }
         else
         {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_GPS_SEN_BAT;
+            tracker_fix_log_lost++;
         }
+    }
+    HAL_DBG_TRACE_WARNING( "%d record(s) kept for backfill, %d in log\n", kept, app_fix_log_count( ));
+    if( kept < uplink->record_num )
+    {
+        HAL_DBG_TRACE_ERROR( "fix log: %d record(s) lost, %u since boot\n", uplink->record_num - kept, tracker_fix_log_lost );
+    }
 
-        tracker_scan_data_temp[1] = event_state;
-        tracker_scan_data_temp[2] = battery;
-        memcpyr( tracker_scan_data_temp + 3, ( uint8_t *)( &temp ), 2 );
-        memcpyr( tracker_scan_data_temp + 5, ( uint8_t *)( &light ), 2 );
-        tracker_scan_temp_len += 7;
+    // The server missed this fix, the next one must not be a delta from it
+    app_track_codec_reset( &tracker_track_codec );
+}
 
-        if( tracker_acc_en )
-        {
-            memcpyr( tracker_scan_data_temp + 7, ( uint8_t *)( &ax ), 2 );
-            memcpyr( tracker_scan_data_temp + 9, ( uint8_t *)( &ay ), 2 );
-            memcpyr( tracker_scan_data_temp + 11, ( uint8_t *)( &az ), 2 );
-            tracker_scan_temp_len += 6;
-        }
+/*!
+ * @brief Queue an uplink, taking back the one it replaces
+ *
+ * @returns false if the queue is full of uplinks of higher priority
+ */
+static bool app_tracker_uplink_push( const app_uplink_t* uplink )
+{
+    static app_uplink_t dropped;
+    app_uplink_push_t result = app_uplink_queue_push( &tracker_uplink_queue, uplink, &dropped );
 
-        memcpy( tracker_scan_data_temp + tracker_scan_temp_len, tracker_gps_scan_data, tracker_gps_scan_len );
-        tracker_scan_temp_len += tracker_gps_scan_len;
+    if( result == APP_UPLINK_QUEUED_DROPPED )
+    {
+        HAL_DBG_TRACE_WARNING( "uplink queue: priority %d uplink dropped\n", dropped.prio );
+        app_tracker_uplink_dropped( &dropped );
+    }
+    return result != APP_UPLINK_REJECTED;
+}
+
+static void app_tracker_sensors_sample( app_uplink_values_t* values )
+{
+    int16_t ax = 0, ay = 0, az = 0;
 
-        send_ok = app_send_frame( tracker_scan_data_temp, tracker_scan_temp_len, confirm, false );
-        if( send_ok ) tracker_gps_scan_len = 0;
+    if( tracker_acc_en )
+    {
+        qma6100p_read_raw_data( &ax, &ay, &az );
+        app_motion_policy_acc_sample( &tracker_motion, ax, ay, az );
     }
-    else if( tracker_wifi_scan_len )
+
+    memset( values, 0, sizeof( *values ));
+    values->event = event_state;
+    values->battery = sensor_bat_sample( );
+    values->temperature = sensor_ntc_sample( );
+    values->light = sensor_lux_sample( );
+    values->acc[0] = ax;
+    values->acc[1] = ay;
+    values->acc[2] = az;
+}
+
+static uint32_t app_tracker_gps_time_s( void )
+{
+    uint32_t gps_time_s = 0, gps_fractional_s = 0;
+
+    if( smtc_modem_get_time( &gps_time_s, &gps_fractional_s ) != SMTC_MODEM_RC_OK ) gps_time_s = 0;
+    return gps_time_s;
+}
+
+static void app_tracker_scan_result_send( void )
+{
+    static app_uplink_t uplink;
+    app_uplink_values_t values;
+    bool send_ok = false;
+    bool confirm = false;
+
+    if(( packet_policy == RETRY_STATE_1C ) || ( event_state == TRACKER_STATE_BIT8_USER ))
     {
-        if( tracker_acc_en )
-        {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_WIFI_SEN_ACC_BAT;
-        }
-        else
-        {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_WIFI_SEN_BAT;
-        }
+        confirm = true;
+    }
 
-        tracker_scan_data_temp[1] = event_state;
-        tracker_scan_data_temp[2] = battery;
-        memcpyr( tracker_scan_data_temp + 3, ( uint8_t *)( &temp ), 2 );
-        memcpyr( tracker_scan_data_temp + 5, ( uint8_t *)( &light ), 2 );
-        tracker_scan_temp_len += 7;
+    // Sensor fields shared by every record, the location tail is set per record
+    app_tracker_sensors_sample( &values );
 
-        if( tracker_acc_en )
-        {
-            memcpyr( tracker_scan_data_temp + 7, ( uint8_t *)( &ax ), 2 );
-            memcpyr( tracker_scan_data_temp + 9, ( uint8_t *)( &ay ), 2 );
-            memcpyr( tracker_scan_data_temp + 11, ( uint8_t *)( &az ), 2 );
-            tracker_scan_temp_len += 6;
-        }
+    // Update iBeacon with current sensor data
+    bool is_emergency = (event_state == TRACKER_STATE_BIT8_USER);
+    app_ble_beacon_update_sensor_data( values.battery, values.temperature, values.light, values.acc[0], values.acc[1],
+                                       values.acc[2], is_emergency );
+
+    PRINTF( "tracker_gps_scan_len: %d\r\n", tracker_gps_scan_len );
+    PRINTF( "tracker_wifi_scan_len: %d\r\n", tracker_wifi_scan_len );
+    PRINTF( "tracker_ble_scan_len: %d\r\n", tracker_ble_scan_len );
+    PRINTF( "scan_result_num: %d\r\n", scan_result_num );
 
-        tracker_scan_data_temp[tracker_scan_temp_len] = tracker_wifi_scan_len / 7;
-        tracker_scan_temp_len += 1;
+    uint8_t tx_max_payload = app_tracker_tx_max_payload( );
+    uint8_t records = 0;
+    bool gps_in = false, wifi_in = false, ble_in = false;
 
-        memcpy( tracker_scan_data_temp + tracker_scan_temp_len, tracker_wifi_scan_data, tracker_wifi_scan_len );
-        tracker_scan_temp_len += tracker_wifi_scan_len;
+    uplink.len = 0;
+    uplink.record_num = 0;
+    uplink.place = 0;
+    uplink.track_fix = false;
+    uplink.time_s = app_tracker_gps_time_s( );
 
-        send_ok = app_send_frame( tracker_scan_data_temp, tracker_scan_temp_len, confirm, false );
-        if( send_ok ) tracker_wifi_scan_len = 0;
+    if( tracker_gps_scan_len == 0 && tracker_wifi_scan_len == 0 && tracker_ble_scan_len == 0 )
+    {
+        scan_result_num = 1;
+        app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_SEN_ACC_BAT : DATA_ID_UP_PACKET_SEN_BAT,
+                                   &values, tx_max_payload );
+        records = 1;
+        uplink.record_num = 0; // no fix, nothing worth a backfill
     }
-    else if( tracker_ble_scan_len )
+    else
     {
-        if( tracker_acc_en )
+        // As many pending results as the current data rate carries in one frame, GNSS first
+        if( tracker_gps_scan_len )
         {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_BLE_SEN_ACC_BAT;
+            // Timestamped at the fix rather than at the send, the frame may wait for the duty cycle
+            app_gnss_aiding_t fix;
+            app_gnss_fix_get_aiding( &fix );
+
+            values.location = tracker_gps_scan_data;
+            values.location_len = tracker_gps_scan_len;
+            values.time = fix.gps_time_s;
+            gps_in = app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_GPS_SEN_ACC_BAT : DATA_ID_UP_PACKET_GPS_SEN_BAT,
+                                                &values, tx_max_payload );
+            records += gps_in;
+            if( gps_in )
+            {
+                uplink.track_fix = TRACKER_GPS_TRACK_CODEC;
+                uplink.fix_lat = tracker_gps_scan_lat;
+                uplink.fix_lon = tracker_gps_scan_lon;
+                if( fix.gps_time_s ) uplink.time_s = fix.gps_time_s;
+            }
         }
-        else
+        if( tracker_wifi_scan_len )
         {
-            tracker_scan_data_temp[0] = DATA_ID_UP_PACKET_BLE_SEN_BAT;
+            values.location = tracker_wifi_scan_data;
+            values.location_len = tracker_wifi_scan_len;
+            values.place = tracker_wifi_place;
+            if( tracker_wifi_place_known )
+            {
+                // Same place as a scan the server already solved, its ID stands for the access points
+                values.location_len = 0;
+            }
+            wifi_in = app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_WIFI_SEN_ACC_BAT : DATA_ID_UP_PACKET_WIFI_SEN_BAT,
+                                                 &values, tx_max_payload );
+            if( wifi_in && !tracker_wifi_place_known && tracker_wifi_place )
+            {
+                // The place only becomes known on an ack, so the scan defining it asks for one
+                uplink.place = tracker_wifi_place;
+                confirm = true;
+            }
+            values.place = 0;
+            records += wifi_in;
         }
-        
-        tracker_scan_data_temp[1] = event_state;
-        tracker_scan_data_temp[2] = battery;
-        memcpyr( tracker_scan_data_temp + 3, ( uint8_t *)( &temp ), 2 );
-        memcpyr( tracker_scan_data_temp + 5, ( uint8_t *)( &light ), 2 );
-        tracker_scan_temp_len += 7;
-
-        if( tracker_acc_en )
+        if( tracker_ble_scan_len )
         {
-            memcpyr( tracker_scan_data_temp + 7, ( uint8_t *)( &ax ), 2 );
-            memcpyr( tracker_scan_data_temp + 9, ( uint8_t *)( &ay ), 2 );
-            memcpyr( tracker_scan_data_temp + 11, ( uint8_t *)( &az ), 2 );
-            tracker_scan_temp_len += 6;
+            values.location = tracker_ble_scan_data;
+            values.location_len = tracker_ble_scan_len;
+            ble_in = app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_BLE_SEN_ACC_BAT : DATA_ID_UP_PACKET_BLE_SEN_BAT,
+                                                &values, tx_max_payload );
+            records += ble_in;
         }
-
-        tracker_scan_data_temp[tracker_scan_temp_len] = tracker_ble_scan_len / 7;
-        tracker_scan_temp_len += 1;
-
-        memcpy( tracker_scan_data_temp + tracker_scan_temp_len, tracker_ble_scan_data, tracker_ble_scan_len );
-        tracker_scan_temp_len += tracker_ble_scan_len;
-
-        send_ok = app_send_frame( tracker_scan_data_temp, tracker_scan_temp_len, confirm, false );
-        if( send_ok ) tracker_ble_scan_len = 0;
     }
 
-    if( send_ok ) scan_result_num -= 1;
+    HAL_DBG_TRACE_PRINTF( "%d record(s), %d/%d bytes\n", records, uplink.len, tx_max_payload );
+    uplink.prio = event_state ? APP_UPLINK_PRIO_ALARM : APP_UPLINK_PRIO_PERIODIC;
+    uplink.port = LORAWAN_APP_PORT;
+    uplink.confirmed = confirm;
+    uplink.emergency = false;
+    uplink.queued_ms = hal_rtc_get_time_ms( );
+    send_ok = app_tracker_uplink_push( &uplink );
+    if( !send_ok )
+    {
+        // The fix log holds the records from now on, the results still pending get their own attempt
+        app_tracker_uplink_dropped( &uplink );
+    }
+    if( send_ok || gps_in || wifi_in || ble_in )
+    {
+        if( gps_in ) tracker_gps_scan_len = 0;
+        if( wifi_in ) tracker_wifi_scan_len = 0;
+        if( ble_in ) tracker_ble_scan_len = 0;
+        scan_result_num -= records;
+        if( scan_result_num < 0 ) scan_result_num = 0;
+    }
     if( scan_result_num )
     {
         smtc_modem_alarm_start_timer( LORWAN_SEND_INTERVAL_MIN );
@@ -871,281 +1305,251 @@ static void app_tracker_scan_result_send( void )
     }
     else
     {
-        tracker_scan_status = 0;
-        int32_t next_delay = tracker_periodic_interval - ( hal_rtc_get_time_s( ) - tracker_scan_begin );
-        smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-        HAL_DBG_TRACE_PRINTF( "send end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
+        tracker_report_interval = app_motion_policy_next_interval( &tracker_motion, tracker_periodic_interval );
+        uint32_t next_delay = app_scan_plan_finish( &tracker_scan_plan, tracker_report_interval );
+        // Next run in the slot of this device, so that a fleet powered on together does not report together
+        next_delay = app_report_slot_delay( &tracker_report_slot, app_tracker_gps_time_s( ), tracker_report_interval,
+                                            next_delay );
+        smtc_modem_alarm_start_timer( next_delay );
+        HAL_DBG_TRACE_PRINTF( "send end, %s, new alarm %d s\n\n", tracker_motion.moving ? "moving" : "at rest", next_delay );
     }
 }
 
-static void app_tracker_scan_process( void )
+static const char* const scan_tech_name[APP_SCAN_TECH_NUM] = { "gnss", "wifi", "ble" };
+
+static void app_tracker_plan_scan_begin( uint8_t tech )
 {
-    int32_t next_delay = 0;
+    HAL_DBG_TRACE_PRINTF( "%s begin, up to %d s\n", scan_tech_name[tech], app_tracker_plan_scan_duration( tech ));
+    switch( tech )
+    {
+        case APP_SCAN_TECH_GNSS: app_tracker_gnss_scan_begin( ); break;
+        case APP_SCAN_TECH_WIFI: app_tracker_wifi_scan_begin( ); break;
+        case APP_SCAN_TECH_BLE: app_tracker_ble_scan_begin( ); break;
+        default: break;
+    }
+}
 
+static bool app_tracker_plan_scan_end( uint8_t tech )
+{
     scan_result = false;
+    switch( tech )
+    {
+        case APP_SCAN_TECH_GNSS: app_tracker_gnss_scan_end( ); break;
+        case APP_SCAN_TECH_WIFI: app_tracker_wifi_scan_end( ); break;
+        case APP_SCAN_TECH_BLE: app_tracker_ble_scan_end( ); break;
+        default: break;
+    }
+    HAL_DBG_TRACE_PRINTF( "%s end\n", scan_tech_name[tech] );
+    return scan_result;
+}
 
-    if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_GNSS_ONLY ))
+static void app_tracker_plan_scan_abort( uint8_t tech )
+{
+    // Radios off and results dropped: no timeout, motion update or place lookup for a partial scan
+    switch( tech )
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( gnss_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "gnss begin, new alarm %d s\n\n", gnss_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_gnss_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            next_delay = tracker_periodic_interval - gnss_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "gnss end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_gnss_scan_end( );
-            tracker_scan_status = 0xff;
-        }
+        case APP_SCAN_TECH_GNSS:
+            gnss_scan_stop( );
+            app_radio_coex_window_close( APP_RADIO_COEX_GNSS_SCAN );
+            app_gnss_fix_abort( );
+            tracker_gps_scan_len = 0;
+            break;
+        case APP_SCAN_TECH_WIFI:
+            wifi_scan_stop( modem_radio );
+            app_radio_coex_window_close( APP_RADIO_COEX_WIFI_SCAN );
+            tracker_wifi_scan_len = 0;
+            tracker_wifi_place = 0;
+            break;
+        case APP_SCAN_TECH_BLE:
+            ble_scan_stop( );
+            app_ble_scan_filter_stop( );
+            app_radio_coex_window_close( APP_RADIO_COEX_BLE_SCAN );
+            tracker_ble_scan_len = 0;
+            break;
+        default: break;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_WIFI_ONLY ))
+    HAL_DBG_TRACE_PRINTF( "%s aborted\n", scan_tech_name[tech] );
+}
+
+static bool app_tracker_plan_scan_ready( uint8_t tech )
+{
+    switch( tech )
     {
-        if( tracker_scan_status == 0 )
+        case APP_SCAN_TECH_BLE:
+            return app_ble_scan_filter_count_above( ble_scan_rssi_min ) >= ble_scan_max;
+        case APP_SCAN_TECH_GNSS:
         {
-            smtc_modem_alarm_start_timer( wifi_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "wifi begin, new alarm %d s\n\n", wifi_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_wifi_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            next_delay = tracker_periodic_interval - wifi_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "wifi end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_wifi_scan_end( );
-            tracker_scan_status = 0xff;
+            // gnss_scan_duration stays the timeout, a stable fix ends the scan before it
+            int32_t lat = 0, lon = 0;
+            bool fix = gnss_get_fix_status( );
+            if( fix ) gnss_get_position( &lat, &lon );
+            return app_gnss_fix_update( hal_rtc_get_time_ms( ), fix, lat, lon );
         }
+        default:
+            return false;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_WIFI_GNSS ))
+}
+
+static uint32_t app_tracker_plan_scan_poll( uint8_t tech )
+{
+    switch( tech )
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( wifi_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "wifi begin, new alarm %d s\n\n", wifi_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_wifi_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            app_tracker_wifi_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - wifi_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "wifi end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( gnss_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "wifi end\r\ngnss begin, new alarm %d s\n\n", gnss_scan_duration );
-                tracker_scan_status = 2;
-                app_tracker_gnss_scan_begin( );
-            }          
-        }
-        else if( tracker_scan_status == 2 )
-        {
-            next_delay = tracker_periodic_interval - wifi_scan_duration - gnss_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "gnss end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_gnss_scan_end( );
-            tracker_scan_status = 0xff;
-        }
+        // The scan filter counts in RAM, checking it costs a wake up and nothing else
+        case APP_SCAN_TECH_BLE: return APP_SCAN_PLAN_POLL_S;
+        // The LR1110 is busy until the Wi-Fi scan stops, its results are only read after wifi_scan_stop()
+        case APP_SCAN_TECH_WIFI: return 0;
+        // A stable fix takes several polls, finer than the histogram buckets would not show in the statistics
+        case APP_SCAN_TECH_GNSS: return TRACKER_GNSS_POLL_S;
+        default: return 0;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_GNSS_WIFI ))
+}
+
+static uint32_t app_tracker_plan_scan_duration( uint8_t tech )
+{
+    switch( tech )
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( gnss_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "gnss begin, new alarm %d s\n\n", gnss_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_gnss_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            app_tracker_gnss_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - gnss_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "gnss end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( wifi_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "gnss end\r\nwifi begin, new alarm %d s\n\n", wifi_scan_duration );
-                app_tracker_wifi_scan_begin( );
-                tracker_scan_status = 2;
-            }
-        }
-        else if( tracker_scan_status == 2 )
-        {
-            next_delay = tracker_periodic_interval - gnss_scan_duration - wifi_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "wifi end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_wifi_scan_end( );
-            tracker_scan_status = 0xff;
-        }
+        case APP_SCAN_TECH_GNSS: return app_gnss_fix_window_s( gnss_scan_duration );
+        case APP_SCAN_TECH_WIFI: return wifi_scan_duration;
+        case APP_SCAN_TECH_BLE: return ble_scan_duration;
+        default: return 1;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_BLE_ONLY ))
+}
+
+static void app_tracker_plan_alarm_start( uint32_t delay_s )
+{
+    smtc_modem_alarm_start_timer( delay_s );
+}
+
+static void app_tracker_backfill_queue( void )
+{
+    static app_uplink_t uplink;
+    app_fix_log_record_t record;
+    uint8_t tx_max_payload = app_tracker_tx_max_payload( );
+
+    tracker_backfill_num = 0;
+    uplink.len = 0;
+
+    while( app_fix_log_peek( backfill_policy, tracker_backfill_num, &record ))
     {
-        if( tracker_scan_status == 0 )
+        if( uplink.len + 4 + record.len > tx_max_payload )
         {
-            smtc_modem_alarm_start_timer( ble_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "ble begin, new alarm %d s\n\n", ble_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_ble_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            next_delay = tracker_periodic_interval - ble_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "ble end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_ble_scan_end( );
-            tracker_scan_status = 0xff;
+            break;
         }
+        memcpyr( uplink.data + uplink.len, ( uint8_t *)&record.timestamp_s, 4 );
+        memcpy( uplink.data + uplink.len + 4, record.data, record.len );
+        uplink.len += 4 + record.len;
+        tracker_backfill_seq[tracker_backfill_num++] = record.seq;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_BLE_WIFI ))
+    if( tracker_backfill_num == 0 )
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( ble_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "ble begin, new alarm %d s\n\n", ble_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_ble_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            app_tracker_ble_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - ble_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "ble end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( wifi_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "ble end\r\nwifi begin, new alarm %d s\n\n", wifi_scan_duration );
-                app_tracker_wifi_scan_begin( );
-                tracker_scan_status = 2;
-            }
-        }
-        else if( tracker_scan_status == 2 )
-        {
-            next_delay = tracker_periodic_interval - ble_scan_duration - wifi_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "wifi end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_wifi_scan_end( );
-            tracker_scan_status = 0xff;
-        }
+        return;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_BLE_GNSS ))
+
+    uplink.prio = APP_UPLINK_PRIO_BACKFILL;
+    uplink.port = LORAWAN_BACKFILL_PORT;
+    // Records leave the log on the ack only, a backfill sent into the same coverage hole is not lost
+    uplink.confirmed = true;
+    uplink.emergency = false;
+    uplink.queued_ms = hal_rtc_get_time_ms( );
+    uplink.time_s = 0;
+    uplink.record_num = 0;
+    uplink.place = 0;
+    uplink.track_fix = false;
+    HAL_DBG_TRACE_PRINTF( "backfill: %d record(s), %d/%d bytes\n", tracker_backfill_num, uplink.len, tx_max_payload );
+    if( !app_tracker_uplink_push( &uplink ))
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( ble_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "ble begin, new alarm %d s\n\n", ble_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_ble_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
-        {
-            app_tracker_ble_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - ble_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "ble end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( gnss_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "ble end\r\ngnss begin, new alarm %d s\n\n", gnss_scan_duration );
-                app_tracker_gnss_scan_begin( );
-                tracker_scan_status = 2;
-            }
-        }
-        else if( tracker_scan_status == 2 )
-        {
-            next_delay = tracker_periodic_interval - ble_scan_duration - gnss_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "gnss end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_gnss_scan_end( );
-            tracker_scan_status = 0xff;
-        }
+        tracker_backfill_num = 0;
+    }
+}
+
+static bool app_tracker_scan_uses_gnss( uint8_t scan_type )
+{
+    return scan_type == TRACKER_SCAN_GNSS_ONLY
+        || scan_type == TRACKER_SCAN_WIFI_GNSS
+        || scan_type == TRACKER_SCAN_GNSS_WIFI
+        || scan_type == TRACKER_SCAN_BLE_GNSS
+        || scan_type == TRACKER_SCAN_BLE_WIFI_GNSS;
+}
+
+static bool app_tracker_config_check( void )
+{
+    if( adr_user_dr_min > adr_user_dr_max )
+    {
+        return false;
     }
-    else if(( scan_result == false ) && ( tracker_scan_type == TRACKER_SCAN_BLE_WIFI_GNSS ))
+    // A run must be over before the next report is due, the run in progress keeps its own plan
+    app_scan_plan_set_concurrent( scan_concurrent_enable );
+    return app_scan_plan_worst_case_s( &tracker_scan_plan, app_scan_plan_get( tracker_scan_type ))
+           < tracker_periodic_interval;
+}
+
+static void app_tracker_config_receive( const uint8_t* payload, uint8_t size )
+{
+    static app_uplink_t uplink;
+    app_config_batch_result_t result;
+    uint8_t scan_type = tracker_scan_type;
+    uint8_t acc_en = tracker_acc_en;
+    bool adr_enable = adr_user_enable;
+    uint8_t dr_min = adr_user_dr_min;
+    uint8_t dr_max = adr_user_dr_max;
+    bool duty_cycle = duty_cycle_enable;
+
+    if( app_config_batch_apply( &tracker_config, payload, size, &result ))
     {
-        if( tracker_scan_status == 0 )
-        {
-            smtc_modem_alarm_start_timer( ble_scan_duration );
-            HAL_DBG_TRACE_PRINTF( "ble begin, new alarm %d s\n\n", ble_scan_duration );
-            tracker_scan_begin = hal_rtc_get_time_s( );
-            app_tracker_ble_scan_begin( );
-            tracker_scan_status = 1;
-        }
-        else if( tracker_scan_status == 1 )
+        HAL_DBG_TRACE_INFO( "config batch %d: %d parameter(s) applied, digest %04x\n", result.batch_id, result.detail,
+                            result.digest );
+
+        // The new values take effect now for what is only set up at boot or at join
+        if( app_tracker_scan_uses_gnss( tracker_scan_type ) && !app_tracker_scan_uses_gnss( scan_type ))
         {
-            app_tracker_ble_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - ble_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "ble end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( wifi_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "ble end\r\nwifi begin, new alarm %d s\n\n", wifi_scan_duration );
-                app_tracker_wifi_scan_begin( );
-                tracker_scan_status = 2;
-            }
+            gnss_init( );
         }
-        else if( tracker_scan_status == 2 )
+        if( tracker_acc_en && !acc_en )
         {
-            app_tracker_wifi_scan_end( );
-            if( scan_result )
-            {
-                next_delay = tracker_periodic_interval - ble_scan_duration - wifi_scan_duration;
-                smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-                HAL_DBG_TRACE_PRINTF( "wifi end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-                tracker_scan_status = 0xff;
-            }
-            else
-            {
-                smtc_modem_alarm_start_timer( gnss_scan_duration );
-                HAL_DBG_TRACE_PRINTF( "wifi end\r\ngnss begin, new alarm %d s\n\n", gnss_scan_duration );
-                tracker_scan_status = 3;
-                app_tracker_gnss_scan_begin( );
-            }
+            hal_gpio_init_out( ACC_POWER, HAL_GPIO_SET );
+            qma6100p_init( );
+            app_motion_policy_init( &tracker_motion );
+            tracker_motion_sample_ms = hal_rtc_get_time_ms( );
         }
-        else if( tracker_scan_status == 3 )
+        app_radio_coex_set_suspend_mask( coex_suspend_mask );
+        // The alarm already set keeps its delay, the next run takes the new interval
+        tracker_report_interval = 0;
+        if( adr_enable != adr_user_enable || dr_min != adr_user_dr_min || dr_max != adr_user_dr_max
+            || duty_cycle != duty_cycle_enable )
         {
-            next_delay = tracker_periodic_interval - ble_scan_duration - wifi_scan_duration - gnss_scan_duration;
-            smtc_modem_alarm_start_timer( next_delay > 0 ? next_delay : 1 );
-            HAL_DBG_TRACE_PRINTF( "gnss end, new alarm %d s\n\n", next_delay > 0 ? next_delay : 1 );
-            app_tracker_gnss_scan_end( );
-            tracker_scan_status = 0xff;
+            app_tracker_region_setup( );
         }
     }
+    else
+    {
+        HAL_DBG_TRACE_WARNING( "config batch %d: refused, status %d at %02x, digest %04x\n", result.batch_id,
+                               result.status, result.detail, result.digest );
+    }
+
+    // Acknowledged either way, the digest tells the server the configuration in force
+    app_config_batch_ack( &result, uplink.data );
+    uplink.prio = APP_UPLINK_PRIO_ALARM;
+    uplink.port = LORAWAN_CONFIG_PORT;
+    uplink.confirmed = false;
+    uplink.emergency = false;
+    uplink.queued_ms = hal_rtc_get_time_ms( );
+    uplink.time_s = 0;
+    uplink.record_num = 0;
+    uplink.place = 0;
+    uplink.track_fix = false;
+    uplink.len = APP_CONFIG_BATCH_ACK_LEN;
+    app_tracker_uplink_push( &uplink );
+}
 
-    if( tracker_scan_status == 0xff )
+static void app_tracker_scan_process( void )
+{
+    if( !app_scan_plan_is_busy( &tracker_scan_plan ))
+    {
+        // A batch applied during the run only changes the next one
+        app_scan_plan_set_concurrent( scan_concurrent_enable );
+        tracker_run_plan = app_scan_plan_get( tracker_scan_type );
+    }
+    if( app_scan_plan_step( &tracker_scan_plan, tracker_run_plan ))
     {
         app_tracker_scan_result_send( );
     }
@@ -1153,47 +1557,297 @@ static void app_tracker_scan_process( void )
 
 bool app_send_frame( const uint8_t* buffer, const uint8_t length, bool tx_confirmed, bool emergency )
 {
+    static app_uplink_t uplink;
+
+    if( length > sizeof( uplink.data ))
+    {
+        return false;
+    }
+    uplink.prio = emergency ? APP_UPLINK_PRIO_EMERGENCY : APP_UPLINK_PRIO_ALARM;
+    uplink.port = LORAWAN_APP_PORT;
+    uplink.confirmed = tx_confirmed;
+    uplink.emergency = emergency;
+    uplink.queued_ms = hal_rtc_get_time_ms( );
+    uplink.time_s = 0;
+    uplink.record_num = 0;
+    uplink.place = 0;
+    uplink.track_fix = false;
+    uplink.len = length;
+    memcpy( uplink.data, buffer, length );
+    return app_tracker_uplink_push( &uplink );
+}
+
+static uint32_t app_tracker_uplink_service( void )
+{
+    static app_uplink_t dropped;
+    app_uplink_t* uplink = &tracker_uplink_inflight;
     uint8_t tx_max_payload;
     int32_t duty_cycle;
+    smtc_modem_return_code_t rc;
 
-    /* Check if duty cycle is available */
+    // A periodic report older than the period is superseded, its records go to the fix log
+    uint32_t report_interval = tracker_report_interval ? tracker_report_interval : tracker_periodic_interval;
+
+    while( app_uplink_queue_expire( &tracker_uplink_queue, APP_UPLINK_PRIO_PERIODIC, hal_rtc_get_time_ms( ),
+                                    report_interval * 1000, &dropped ))
+    {
+        HAL_DBG_TRACE_WARNING( "uplink queue: stale periodic report dropped\n" );
+        app_tracker_uplink_dropped( &dropped );
+    }
+
+    if( tracker_uplink_busy || app_uplink_queue_count( &tracker_uplink_queue ) == 0 )
+    {
+        return UINT32_MAX;
+    }
+
+    /* Check if duty cycle is available, an emergency uplink does not wait for it */
     ASSERT_SMTC_MODEM_RC( smtc_modem_get_duty_cycle_status( &duty_cycle ) );
-    if( duty_cycle < 0 )
+    if( duty_cycle < 0 && !app_uplink_queue_head( &tracker_uplink_queue )->emergency )
     {
-        HAL_DBG_TRACE_WARNING( "Duty-cycle limitation - next possible uplink in %d ms \n\n", duty_cycle );
-        return false;
+        // Woken up again when the budget allows the next uplink
+        return -duty_cycle;
     }
 
     ASSERT_SMTC_MODEM_RC( smtc_modem_get_next_tx_max_payload( stack_id, &tx_max_payload ) );
-    if( length > tx_max_payload )
+    if( app_uplink_queue_head( &tracker_uplink_queue )->len > tx_max_payload )
     {
         HAL_DBG_TRACE_WARNING( "Not enough space in buffer - send empty uplink to flush MAC commands \n" );
-        ASSERT_SMTC_MODEM_RC( smtc_modem_request_empty_uplink( stack_id, true, LORAWAN_APP_PORT, tx_confirmed ));
-        return false;
+        app_uplink_queue_pop( &tracker_uplink_queue, uplink );
+        app_tracker_uplink_dropped( uplink );
+        uplink->prio = APP_UPLINK_PRIO_ALARM;
+        uplink->record_num = 0;
+        uplink->place = 0;
+        uplink->track_fix = false;
+        rc = smtc_modem_request_empty_uplink( stack_id, true, uplink->port, uplink->confirmed );
+        if( rc != SMTC_MODEM_RC_OK )
+        {
+            // Nothing left to send, the MAC commands go with the next uplink
+            HAL_DBG_TRACE_ERROR( "empty uplink refused: %d\n", rc );
+            app_tracker_emergency_release( uplink );
+            return TRACKER_UPLINK_RETRY_MS;
+        }
+        tracker_uplink_busy = true;
+        return 0;
+    }
+
+    // The uplink leaves the queue only once the modem takes it, no TX done comes for a refused request
+    *uplink = *app_uplink_queue_head( &tracker_uplink_queue );
+
+    HAL_DBG_TRACE_INFO( "Request uplink, priority %d, %d queued\n", uplink->prio, app_uplink_queue_count( &tracker_uplink_queue ) - 1 );
+
+    // Pause iBeacon advertising during the LoRaWAN uplink, the coex scheduler resumes it on TX done
+    app_radio_coex_window_open( APP_RADIO_COEX_LORA_UPLINK );
+
+    if( uplink->emergency )
+    {
+        rc = smtc_modem_request_emergency_uplink( stack_id, uplink->port, uplink->confirmed, uplink->data, uplink->len );
     }
     else
     {
-        HAL_DBG_TRACE_INFO( "Request uplink\n" );
-        
-        // Pause iBeacon advertising during LoRaWAN transmission for power efficiency
-        app_ble_beacon_stop( );
-        
-        if( emergency )
+        rc = smtc_modem_request_uplink( stack_id, uplink->port, uplink->confirmed, uplink->data, uplink->len );
+    }
+
+    if( rc != SMTC_MODEM_RC_OK )
+    {
+        app_radio_coex_window_close( APP_RADIO_COEX_LORA_UPLINK );
+        if( rc == SMTC_MODEM_RC_BUSY )
+        {
+            HAL_DBG_TRACE_WARNING( "uplink request: modem busy, retry in %u ms\n", TRACKER_UPLINK_RETRY_MS );
+            return TRACKER_UPLINK_RETRY_MS;
+        }
+
+        // Refused for good, its records go to the fix log
+        HAL_DBG_TRACE_ERROR( "uplink request refused: %d\n", rc );
+        app_uplink_queue_pop( &tracker_uplink_queue, uplink );
+        app_tracker_uplink_dropped( uplink );
+        app_tracker_emergency_release( uplink );
+        return 0;
+    }
+
+    app_uplink_queue_pop( &tracker_uplink_queue, uplink );
+    tracker_uplink_busy = true;
+
+    if( uplink->emergency )
+    {
+        uint32_t latency_ms = hal_rtc_get_time_ms( ) - uplink->queued_ms;
+        if( latency_ms > tracker_emergency_latency_max_ms ) tracker_emergency_latency_max_ms = latency_ms;
+        if( latency_ms > TRACKER_EMERGENCY_LATENCY_MS )
         {
-            ASSERT_SMTC_MODEM_RC ( smtc_modem_request_emergency_uplink( stack_id, LORAWAN_APP_PORT, tx_confirmed, buffer, length ));
+            HAL_DBG_TRACE_ERROR( "emergency: requested %u ms after the press, target %u ms\n", latency_ms,
+                                 TRACKER_EMERGENCY_LATENCY_MS );
         }
         else
         {
-            ASSERT_SMTC_MODEM_RC( smtc_modem_request_uplink( stack_id, LORAWAN_APP_PORT, tx_confirmed, buffer, length ));
+            HAL_DBG_TRACE_INFO( "emergency: requested %u ms after the press, max %u ms\n", latency_ms,
+                                tracker_emergency_latency_max_ms );
         }
-        return true;
     }
+    return 0;
 }
 
-void app_tracker_new_run( uint8_t event )
+static uint32_t app_tracker_motion_service( void )
+{
+    int16_t ax = 0, ay = 0, az = 0;
+    uint32_t elapsed_ms = hal_rtc_get_time_ms( ) - tracker_motion_sample_ms;
+
+    if( !tracker_acc_en )
+    {
+        return UINT32_MAX;
+    }
+    if( elapsed_ms < APP_MOTION_SAMPLE_S * 1000 )
+    {
+        return APP_MOTION_SAMPLE_S * 1000 - elapsed_ms;
+    }
+
+    tracker_motion_sample_ms += elapsed_ms;
+    qma6100p_read_raw_data( &ax, &ay, &az );
+    if( app_motion_policy_acc_sample( &tracker_motion, ax, ay, az ) && !app_scan_plan_is_busy( &tracker_scan_plan )
+        && !tracker_emergency_active )
+    {
+        // The backed off alarm is replaced by a report now, the track starts where the asset left
+        HAL_DBG_TRACE_INFO( "motion after rest, report now\n" );
+        app_tracker_new_run( 0 );
+    }
+    return APP_MOTION_SAMPLE_S * 1000;
+}
+
+static void app_tracker_emergency_service( void )
 {
+    static app_uplink_t uplink;
+    app_uplink_values_t values;
+    app_gnss_aiding_t last_fix;
+    uint8_t position[APP_TRACK_FIX_MAX];
+    smtc_modem_status_mask_t modem_status;
+
+    if( !tracker_emergency_pending )
+    {
+        return;
+    }
+    tracker_emergency_pending = false;
+
+    if( tracker_emergency_active )
+    {
+        // One alert is enough, the beacon already shows it and the fresh fix run follows its TX done
+        HAL_DBG_TRACE_WARNING( "emergency: uplink already in flight, press ignored\n" );
+        return;
+    }
+
+    // Receivers nearby see the alert before any LoRaWAN uplink
+    event_state = TRACKER_STATE_BIT8_USER;
+    app_tracker_sensors_sample( &values );
+    app_ble_beacon_update_sensor_data( values.battery, values.temperature, values.light, values.acc[0], values.acc[1],
+                                       values.acc[2], true );
+
+    smtc_modem_get_status( stack_id, &modem_status );
+    if(( modem_status & SMTC_MODEM_STATUS_JOINED ) != SMTC_MODEM_STATUS_JOINED )
+    {
+        event_state = 0;
+        PRINTF( "\r\nNOT JOINED, SKIP EMERGENCY UPLINK\r\n" );
+        return;
+    }
+
+    // The scan gives way, what it gathered so far is superseded by the fresh fix run
+    if( app_scan_plan_is_busy( &tracker_scan_plan ))
+    {
+        smtc_modem_alarm_clear_timer( );
+        app_scan_plan_abort( &tracker_scan_plan, tracker_run_plan );
+        tracker_gps_scan_len = 0;
+        tracker_wifi_scan_len = 0;
+        tracker_ble_scan_len = 0;
+        scan_result_num = 0;
+        HAL_DBG_TRACE_WARNING( "emergency: scan run aborted\n" );
+    }
+
+    uplink.len = 0;
+    uplink.record_num = 0;
+    uplink.place = 0;
+    uplink.track_fix = false;
+    uplink.time_s = app_tracker_gps_time_s( );
+
+    app_gnss_fix_get_aiding( &last_fix );
+    if( last_fix.valid )
+    {
+        if( TRACKER_GPS_TRACK_CODEC )
+        {
+            // A key fix, the server decodes it whatever it missed before
+            app_track_codec_reset( &tracker_track_codec );
+            values.location_len = app_track_encode( &tracker_track_codec, last_fix.lat, last_fix.lon, position,
+                                                    sizeof( position ));
+            tracker_track_ref_delivered = false;
+            tracker_gps_scan_lat = last_fix.lat;
+            tracker_gps_scan_lon = last_fix.lon;
+            uplink.track_fix = true;
+            uplink.fix_lat = last_fix.lat;
+            uplink.fix_lon = last_fix.lon;
+        }
+        else
+        {
+            memcpyr( position, ( uint8_t *)&last_fix.lon, 4 );
+            memcpyr( position + 4, ( uint8_t *)&last_fix.lat, 4 );
+            values.location_len = 8;
+        }
+        values.location = position;
+        values.time = last_fix.gps_time_s;
+        app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_GPS_SEN_ACC_BAT : DATA_ID_UP_PACKET_GPS_SEN_BAT,
+                                   &values, app_tracker_tx_max_payload( ));
+    }
+    else
+    {
+        app_tracker_record_append( &uplink, tracker_acc_en ? DATA_ID_UP_PACKET_SEN_ACC_BAT : DATA_ID_UP_PACKET_SEN_BAT,
+                                   &values, app_tracker_tx_max_payload( ));
+        uplink.record_num = 0; // no fix, nothing worth a backfill
+    }
+
+    uplink.prio = APP_UPLINK_PRIO_EMERGENCY;
+    uplink.port = LORAWAN_APP_PORT;
+    uplink.confirmed = true;
+    uplink.emergency = true;
+    uplink.queued_ms = tracker_emergency_press_ms;
+    HAL_DBG_TRACE_WARNING( "emergency: %s, %d bytes\n", last_fix.valid ? "last known fix" : "no fix yet", uplink.len );
+    tracker_emergency_active = app_tracker_uplink_push( &uplink );
+    if( !tracker_emergency_active )
+    {
+        app_tracker_run_request( TRACKER_STATE_BIT8_USER );
+    }
+}
+
+static void app_tracker_report_delivered( const app_uplink_t* uplink )
+{
+    if( uplink->track_fix && uplink->fix_lat == tracker_gps_scan_lat && uplink->fix_lon == tracker_gps_scan_lon )
+    {
+        // The server holds the last encoded fix, the next one can be a delta from it
+        tracker_track_ref_delivered = true;
+    }
+    if( uplink->place && uplink->confirmed )
+    {
+        // Acked: the server has the scan defining the place
+        app_wifi_place_confirm( &tracker_wifi_places, uplink->place );
+    }
+    if( uplink->record_num && app_fix_log_count( ) && tracker_backfill_num == 0 )
+    {
+        // The link is back, one backfill frame follows each delivered report
+        app_tracker_backfill_queue( );
+    }
+}
+
+static void app_tracker_emergency_release( const app_uplink_t* uplink )
+{
+    if( uplink->emergency && tracker_emergency_active )
+    {
+        tracker_emergency_active = false;
+        app_tracker_run_request( TRACKER_STATE_BIT8_USER );
+    }
+}
+
+static void app_tracker_run_request( uint8_t event )
+{
+    if( tracker_emergency_active ) // the fresh fix run follows the emergency uplink
+    {
+        PRINTF( "\r\nEMERGENCY IS DOING, SKIP NEW ONE\r\n" );
+        return;
+    }
     event_state = event;
-    if( tracker_scan_status == 0 ) // Not tracking is doing
+    if( !app_scan_plan_is_busy( &tracker_scan_plan )) // Not tracking is doing
     {
         smtc_modem_status_mask_t modem_status;
         smtc_modem_get_status( 0, &modem_status );
@@ -1216,6 +1870,19 @@ void app_tracker_new_run( uint8_t event )
     }
 }
 
+void app_tracker_new_run( uint8_t event )
+{
+    if( event == TRACKER_STATE_BIT8_USER )
+    {
+        // An SOS press never waits for a run, the main loop takes it from here
+        tracker_emergency_press_ms = hal_rtc_get_time_ms( );
+        tracker_emergency_pending = true;
+        hal_sleep_exit( );
+        return;
+    }
+    app_tracker_run_request( event );
+}
+
 void app_radio_set_sleep( void )
 {
     lr11xx_system_sleep_cfg_t radio_sleep_cfg;
@@ -26,6 +26,16 @@ extern "C" {
  */
 #define LORAWAN_APP_PORT 5
 
+/*!
+ * @brief LoRaWAN port of the backfill uplinks, records kept in the fix log while they could not be sent
+ */
+#define LORAWAN_BACKFILL_PORT 6
+
+/*!
+ * @brief LoRaWAN port of the configuration batches, and of their acknowledgements
+ */
+#define LORAWAN_CONFIG_PORT 7
+
 /*!
  * @brief User application data buffer size
  */
@@ -41,6 +51,42 @@ extern "C" {
  */
 #define LORWAN_SEND_INTERVAL_MIN 15
 
+/*!
+ * @brief Longest time in ms from an SOS press to its emergency uplink request, a slower one is logged as an error
+ */
+#define TRACKER_EMERGENCY_LATENCY_MS 1000
+
+/*!
+ * @brief Interval in s of the application layer clock sync once joined, fixes and report slots use its GPS time
+ */
+#define TRACKER_TIME_SYNC_INTERVAL_S 86400
+
+/*!
+ * @brief If true, GPS records carry a track codec fix (see app_track_codec.h) instead of the
+ * absolute 8 byte position. The network server decoder must be set up accordingly. A delta fix
+ * only follows a fix that went out, acked or sent unconfirmed.
+ */
+#define TRACKER_GPS_TRACK_CODEC false
+
+/*!
+ * @brief If true, GPS records end with the 4 byte GPS time of the fix, 0 if the clock was not synced
+ * then, so a fix sent on the application port is timestamped like a backfilled one. The network server
+ * decoder must be set up accordingly.
+ */
+#define TRACKER_GPS_FIX_TIME false
+
+/*!
+ * @brief If true, a Wi-Fi scan matching a place the server already knows is sent as that place ID
+ * only (see app_wifi_place.h). The network server decoder must be set up accordingly.
+ */
+#define TRACKER_WIFI_PLACE_CACHE false
+
+/*!
+ * @brief Unused entry of the BLE company ID allowlist (configuration tags 0x10 to 0x13), 0xFFFF is
+ * reserved by the Bluetooth SIG. With every entry unused and no iBeacon UUID set, all beacons are allowed.
+ */
+#define TRACKER_BLE_ALLOW_NONE 0xFFFF
+
 /*!
  * @brief If true, then the system will not power down all peripherals when going to low power mode. This is necessary
  * to keep the LEDs active in low power mode.